@@ -0,0 +1,61 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace ctc {
+    namespace utils {
+        // One entry of compile_commands.json
+        struct CompileCommand {
+            std::filesystem::path directory;
+            std::filesystem::path file;
+            std::vector<std::string> arguments;  // from "arguments", or "command" split like a shell would
+        };
+        
+        // Read a compile_commands.json (as exported by CMake). Returns an empty list if it is missing or malformed.
+        std::vector<CompileCommand> read_compile_commands(const std::filesystem::path& path);
+        
+        // Split a command line at unquoted whitespace, removing quotes and backslash escapes
+        std::vector<std::string> split_command_line(const std::string& command);
+        
+        // The command that only preprocesses the file to stdout (-E, with line markers), without the
+        // output, dependency file and compile-only options. Empty for compilers without -E (MSVC cl).
+        std::vector<std::string> preprocess_arguments(const std::vector<std::string>& arguments);
+        
+        // A header as one translation unit saw it
+        struct IncludedHeader {
+            unsigned long long own_bytes = 0;    // preprocessed bytes of its own lines
+            unsigned long long total_bytes = 0;  // with everything first included through it
+            std::set<std::string> includes;      // headers it includes directly
+            std::set<std::string> included_by;   // files that include it directly (the TU itself included)
+        };
+        
+        // The include tree of one translation unit
+        struct TranslationUnitIncludes {
+            std::string file;
+            unsigned long long bytes = 0;                   // whole preprocessed output
+            std::map<std::string, IncludedHeader> headers;  // by path as the compiler reported it
+        };
+        
+        // Rebuild the include tree from the line markers of preprocessed output (# <line> "<file>" <flags>,
+        // as written by GCC and Clang). Lines of a file count towards that file and every file it was
+        // included through; the compiler's own "<built-in>" and "<command-line>" count towards the TU.
+        TranslationUnitIncludes parse_preprocessed_output(const std::string& file, const std::string& output);
+        
+        // What a header costs across all translation units
+        struct HeaderCost {
+            std::string header;
+            size_t translation_units = 0;        // that include it, directly or not
+            unsigned long long own_bytes = 0;    // summed over those translation units
+            unsigned long long total_bytes = 0;  // the same, with everything it pulls in
+            std::set<std::string> includes;      // fan-out: headers it includes directly
+            std::set<std::string> included_by;   // fan-in: files that include it directly
+        };
+        
+        // One entry per header, in no particular order
+        std::vector<HeaderCost> aggregate_header_costs(const std::vector<TranslationUnitIncludes>& units);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace ctc {
+    namespace utils {
+        // How an artifact reached the output directory
+        enum class PublishMethod {
+            unchanged,  // the published file already has the same content and was left alone
+            reflink,    // copy-on-write clone sharing the build output's blocks (FICLONE: btrfs, XFS, ...)
+            hardlink,   // second name for the build output's inode
+            copy        // full copy, when neither is possible (e.g. the output directory is on another filesystem)
+        };
+        
+        // "unchanged", "reflink", "hardlink" or "copy"
+        const char* publish_method_name(PublishMethod method);
+        
+        // True for a program a build produced: a regular file with the exec bit set that starts with
+        // an ELF executable header (ET_EXEC, or a PIE with an interpreter; shared libraries are
+        // rejected) or a Mach-O header. On Windows, a .exe starting with "MZ".
+        bool is_executable_artifact(const std::filesystem::path& path);
+        
+        struct PublishedArtifact {
+            std::filesystem::path source;
+            std::filesystem::path destination;
+            PublishMethod method = PublishMethod::unchanged;
+            bool succeeded = false;
+            std::string error;
+        };
+        
+        // Publish the executables found directly in from_dir to output_dir. Each one is cloned,
+        // hard-linked or (as a last resort) copied to a temporary file next to its destination and
+        // renamed over it, so a program started from output_dir never sees a partial file.
+        // manifest_path records the size, mtime and content hash of what was published: artifacts
+        // whose size and mtime are unchanged are not read, and artifacts the build rewrote with the
+        // same content are not published again (the destination keeps its mtime).
+        std::vector<PublishedArtifact> publish_executables(const std::filesystem::path& from_dir,
+                                                           const std::filesystem::path& output_dir,
+                                                           const std::filesystem::path& manifest_path);
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace ctc {
+    namespace utils {
+        // One benchmark of a result set written by the bench/ harness (ctc_bench.h)
+        struct BenchmarkResult {
+            std::string name;
+            double median_ns = 0;
+            std::vector<double> samples_ns;  // ns per iteration of each sample
+        };
+        
+        // Read a result set (.ctc/bench/<name>.json). Returns an empty list if the file is missing or malformed.
+        std::vector<BenchmarkResult> read_bench_results(const std::filesystem::path& path);
+        
+        // Two-sided Mann-Whitney U test (normal approximation with tie and continuity correction).
+        // Returns the p-value for "both sample sets come from the same distribution".
+        double mann_whitney_p_value(const std::vector<double>& a, const std::vector<double>& b);
+        
+        // Verdict of one benchmark against its baseline
+        struct BenchmarkComparison {
+            std::string name;
+            double baseline_ns = 0;      // medians; 0 when missing on that side
+            double current_ns = 0;
+            double change_percent = 0;   // (current - baseline) / baseline
+            double p_value = 1;
+            std::string verdict;         // "faster", "slower", "noise", "new" or "removed"
+            bool regression = false;     // slower by more than the threshold
+        };
+        
+        // Compare every benchmark of current with the same one in baseline. A difference only counts
+        // (faster/slower) when the test rejects "no difference" at alpha; it is a regression when it
+        // is slower by more than threshold_percent.
+        std::vector<BenchmarkComparison> compare_bench_results(const std::vector<BenchmarkResult>& baseline,
+                                                               const std::vector<BenchmarkResult>& current,
+                                                               double alpha, double threshold_percent);
+    }
+}
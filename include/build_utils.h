@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <filesystem>
+#include <vector>
+
+namespace ctc {
+    namespace utils {
+        // Number of parallel build jobs usable by this process.
+        // Honors CPU affinity and cgroup CPU quotas (containers) on Linux and
+        // falls back to std::thread::hardware_concurrency elsewhere.
+        // If detail is given, it receives a short description of how the value was chosen.
+        unsigned detect_job_count(std::string* detail = nullptr);
+        
+        // Parse a -j/--jobs value: a decimal integer from 1 to max_job_count. False (jobs unchanged) otherwise.
+        constexpr unsigned max_job_count = 4096;
+        bool parse_job_count(const std::string& value, unsigned& jobs);
+        
+        // Look up an executable on PATH. Returns true and stores its location in found if given.
+        bool find_program(const std::string& name, std::filesystem::path* found = nullptr);
+        
+        // Read a single entry (e.g. CMAKE_GENERATOR) from <build_dir>/CMakeCache.txt.
+        // Returns an empty string if the cache or the entry does not exist.
+        std::string read_cmake_cache_value(const std::filesystem::path& build_dir, const std::string& key);
+        
+        // Pick the generator for a build tree: the one already recorded in the tree's cache,
+        // otherwise the requested one, otherwise Ninja if it is on PATH. An empty result
+        // means "let CMake use its default generator".
+        std::string select_generator(const std::filesystem::path& build_dir, const std::string& requested);
+        
+        // Fingerprint of everything that affects the configure step of a build tree: CMakeLists.txt
+        // (and the ctc_sources.cmake it includes), the toolchain file, build mode, generator, the
+        // compiler (CC/CXX and the binary itself), compiler flags from the environment and any extra
+        // cmake arguments. When it matches the one stored in the tree, configure can be skipped.
+        std::string compute_configure_fingerprint(const std::filesystem::path& build_dir, const std::string& build_mode,
+                                                  const std::string& generator, const std::vector<std::string>& extra_args = {});
+        // Fingerprint of the project sources (all source roots, CMakeLists.txt and ctc_sources.cmake),
+        // used to key data that is only valid for one version of the code, such as PGO profiles
+        std::string compute_source_fingerprint();
+        
+        // Stored in <build_dir>/ctc_configure.fingerprint after a successful configure
+        std::string read_configure_fingerprint(const std::filesystem::path& build_dir);
+        bool write_configure_fingerprint(const std::filesystem::path& build_dir, const std::string& fingerprint);
+        
+        // A GNU make style jobserver: a FIFO holding one token per job slot beyond the one every client
+        // owns implicitly. Lets concurrent builds share a fixed number of cores.
+        struct Jobserver {
+            std::filesystem::path fifo;
+            int read_fd = -1;
+            int write_fd = -1;
+        };
+        
+        // Create the FIFO at fifo holding tokens tokens. Not available on Windows.
+        bool create_jobserver(Jobserver& jobserver, const std::filesystem::path& fifo, unsigned tokens);
+        void close_jobserver(Jobserver& jobserver);
+        
+        // How to prepare, configure and build one build tree (shared by 'run', 'pgo', ...)
+        struct BuildTreeOptions {
+            std::filesystem::path build_dir;
+            std::string build_mode = "Release";
+            std::string generator;                // requested (-G); empty: keep the tree's, else prefer Ninja
+            unsigned jobs = 1;
+            bool clean = false;                   // remove the tree first
+            bool force_configure = false;         // configure even if the fingerprint is unchanged
+            std::vector<std::string> cmake_args;  // extra configure arguments, e.g. -DCMAKE_CXX_FLAGS=...
+            std::string target;                   // build only this target; empty builds everything
+            std::filesystem::path output_dir = "bin";  // where the executable goes (CTC_BIN_DIR)
+            std::string log_prefix;               // prefix for every output line, e.g. "[Debug] " for concurrent builds
+            const Jobserver* jobserver = nullptr; // share job slots with other builds instead of using jobs
+            const std::atomic<bool>* cancel = nullptr; // set to stop a running configure or build (e.g. 'ctc watch')
+        };
+        
+        // Print a message of a build, line by line behind options.log_prefix (safe from concurrent builds)
+        void print_build_message(const BuildTreeOptions& options, const std::string& message, bool error = false);
+        
+        // Create the tree, removing it first for clean builds or when a different generator is requested
+        bool prepare_build_tree(const BuildTreeOptions& options);
+        // Run the configure step unless the configure fingerprint is unchanged; skipped tells which happened
+        bool configure_build_tree(const BuildTreeOptions& options, bool* skipped = nullptr);
+        // cmake --build with --config and --parallel, or as a client of options.jobserver for Makefile
+        // generators and Ninja 1.13+ (other generators fall back to --parallel jobs)
+        bool build_build_tree(const BuildTreeOptions& options);
+        
+        // Run a command (no shell) and capture its standard output; its stderr is discarded.
+        // Returns the command's exit status (127 if it could not be started). A timeout of 0 waits indefinitely.
+        int capture_command_output(const std::vector<std::string>& argv, std::string& output, double timeout_seconds = 0);
+        
+        // Hit/miss counters reported by a compiler cache (ccache or sccache)
+        struct CompilerCacheStats {
+            bool valid = false;
+            unsigned long long hits = 0;
+            unsigned long long misses = 0;
+        };
+        
+        // Query the statistics of the compiler cache at launcher; valid is false if they could not be read
+        CompilerCacheStats read_compiler_cache_stats(const std::filesystem::path& launcher);
+    }
+}
@@ -12,5 +12,13 @@ namespace ctc {
         int run_command(const std::vector<std::string>& args);
         int list_command(const std::vector<std::string>& args);
         int apply_command(const std::vector<std::string>& args);
+        int pch_command(const std::vector<std::string>& args);
+        int pgo_command(const std::vector<std::string>& args);
+        int bench_command(const std::vector<std::string>& args);
+        int profile_command(const std::vector<std::string>& args);
+        int stat_command(const std::vector<std::string>& args);
+        int watch_command(const std::vector<std::string>& args);
+        int serve_command(const std::vector<std::string>& args);
+        int analyze_command(const std::vector<std::string>& args);
     }
 }
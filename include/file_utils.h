@@ -3,12 +3,14 @@
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <unordered_set>
+#include "source_utils.h"
 
 namespace ctc {
     namespace utils {
         // Enhanced dependency entry structure
         struct DependencyEntry {
-            enum Type { PACKAGE, LIBRARY_PATH, LIBRARY_NAME, INCLUDE_PATH, TOOLCHAIN_FILE, PACKAGE_COMPONENT, LINK_OVERRIDE };
+            enum Type { PACKAGE, LIBRARY_PATH, LIBRARY_NAME, INCLUDE_PATH, TOOLCHAIN_FILE, PACKAGE_COMPONENT, LINK_OVERRIDE, COMPILER_LAUNCHER, UNITY_BUILD, UNITY_EXCLUDE, PCH_HEADER, LTO_MODE, APP_TARGETS };
             Type type;
             std::string value;
             
@@ -16,12 +18,29 @@ namespace ctc {
             static DependencyEntry from_string(const std::string& str);
         };
         
+        // A change to a persisted build setting in .libname (e.g. from 'ctc apply --unity')
+        struct SettingChange {
+            enum Action { SET, ADD, CLEAR };
+            Action action;          // SET replaces all entries of entry.type, ADD appends, CLEAR removes them
+            DependencyEntry entry;
+        };
+        
         // File and directory utilities
         bool create_directory_if_not_exists(const std::filesystem::path& path);
-        bool write_file(const std::filesystem::path& path, const std::string& content);
+        // All ctc writes go through write_file: the file is left untouched (mtime included) if it already
+        // has this content, otherwise it is replaced atomically via a temporary file and a rename.
+        // changed (if given) tells whether the file was rewritten.
+        bool write_file(const std::filesystem::path& path, const std::string& content, bool* changed = nullptr);
         std::string read_file(const std::filesystem::path& path);
         std::vector<std::string> read_lines(const std::filesystem::path& path);
         bool write_lines(const std::filesystem::path& path, const std::vector<std::string>& lines);
+        // Parse a whole decimal field of a cache file. False (value unchanged) if it is empty, has other
+        // characters or is out of range, so a damaged line can be skipped instead of throwing.
+        bool parse_integer(const std::string& text, long long& value);
+        bool parse_integer(const std::string& text, unsigned long long& value);
+        // Parse a numeric option value: whole decimal digits from min to max. False (value unchanged)
+        // otherwise, so the caller reports a bad value instead of std::stoul throwing on a huge one.
+        bool parse_integer(const std::string& text, unsigned long long min, unsigned long long max, unsigned long long& value);
         
         // Enhanced libname utilities
         std::vector<DependencyEntry> read_libname(const std::filesystem::path& path);
@@ -29,13 +48,80 @@ namespace ctc {
         bool add_dependency(const std::filesystem::path& libname_path, const DependencyEntry& entry);
         bool remove_dependency(const std::filesystem::path& libname_path, const DependencyEntry& entry);
         
+        // A batch of edits to .libname: the file is read once when the transaction opens, edited in
+        // memory against a hashed index of its entries, and written once, atomically, by commit().
+        // From open to destruction the project directory holds an advisory lock (flock), so
+        // concurrent ctc processes apply their batches one after the other. Not locked on Windows.
+        class LibnameTransaction {
+        public:
+            explicit LibnameTransaction(const std::filesystem::path& libname_path);
+            ~LibnameTransaction();
+            LibnameTransaction(const LibnameTransaction&) = delete;
+            LibnameTransaction& operator=(const LibnameTransaction&) = delete;
+            
+            // False if the lock could not be taken; the transaction must not be used then
+            bool locked() const { return locked_; }
+            // Return false when nothing changed (already present / not present)
+            bool add(const DependencyEntry& entry);
+            bool remove(const DependencyEntry& entry);
+            // Remove every entry of a type; returns the number removed
+            size_t clear(DependencyEntry::Type type);
+            bool contains(const DependencyEntry& entry) const { return index_.count(entry.to_string()) != 0; }
+            std::vector<DependencyEntry> entries() const;
+            // Write all edits with one atomic write (nothing is written if nothing changed)
+            bool commit();
+            
+        private:
+            std::filesystem::path path_;
+            std::vector<DependencyEntry> entries_;   // in file order; removed entries are dropped on commit
+            std::unordered_set<std::string> index_;  // to_string() of every live entry
+            bool changed_ = false;
+            bool locked_ = false;
+            int lock_fd_ = -1;
+        };
+        
+        // "package", "library path", ... for messages
+        std::string dependency_type_name(DependencyEntry::Type type);
+        
+        // Parse the operations of one 'ctc install'/'ctc uninstall' call, e.g.
+        // "Boost -c system -c filesystem -l pthread -I /opt/x -L /opt/lib". -c adds a component to the
+        // preceding package. Returns false with error set on invalid input.
+        bool parse_dependency_operations(const std::vector<std::string>& args, bool uninstall,
+                                         std::vector<DependencyEntry>& entries, std::string& error);
+        
+        // Build setting options shared by 'apply' and 'run' (--unity [N], --no-unity, --unity-exclude <file>,
+        // --lto [thin|full], --no-lto).
+        // Returns true if args[i] is such an option and advances i past its value; error is set on invalid input.
+        bool parse_setting_option(const std::vector<std::string>& args, size_t& i, std::vector<SettingChange>& changes, std::string& error);
+        bool apply_setting_changes(const std::filesystem::path& libname_path, const std::vector<SettingChange>& changes);
+        
         // CMakeLists.txt generation and modification
         std::string generate_cmake_content(const std::string& project_name, const std::vector<DependencyEntry>& dependencies);
-        bool update_cmake_file(const std::filesystem::path& cmake_path, const std::string& project_name, const std::vector<DependencyEntry>& dependencies);
+        // changed (if given) tells whether CMakeLists.txt was rewritten
+        bool update_cmake_file(const std::filesystem::path& cmake_path, const std::string& project_name, const std::vector<DependencyEntry>& dependencies, bool* changed = nullptr);
+        
+        // ctc_sources.cmake: explicit, sorted source lists and the lib/ targets, included by the managed section.
+        // With app_targets, also one source and library list per executable of the per-target layout.
+        std::string generate_sources_manifest(const SourceLayout& layout, bool app_targets = false);
+        // Regenerate the manifest from app/, lib/ and bench/ (and .libname next to it, for the app layout);
+        // the file is only written if its content changed
+        bool update_sources_manifest(const std::filesystem::path& manifest_path, bool* changed = nullptr);
+        // Whether the per-target layout is enabled in both .libname and CMakeLists.txt (no bin/<project name> then)
+        bool app_targets_enabled();
+        // Check that name is an executable of the per-target layout ('ctc run -t'): the layout is enabled in
+        // .libname and CMakeLists.txt, and app/ has a target of that name. Returns false with error set otherwise.
+        bool check_app_target(const std::string& name, std::string& error);
         
         // Template content generators
         std::string get_cmake_template();
         std::string get_gitignore_template();
         std::string get_readme_template();
+        std::string get_bench_header_template();
+        std::string get_bench_main_template();
+        std::string get_bench_example_template();
+        
+        // Create bench/ with the benchmark harness (ctc_bench.h), its main() and an example benchmark.
+        // Existing files are kept.
+        bool create_bench_skeleton();
     }
 }
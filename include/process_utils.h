@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ctc {
+    namespace utils {
+        // What happens to one output stream of a child process
+        enum class OutputMode {
+            forward,    // read through a pipe and copied to ctc's own stream as it arrives
+            capture,    // read through a pipe and kept in ProcessResult
+            discard,    // /dev/null
+            inherit     // the child writes to ctc's stream directly (keeps a terminal, e.g. for compiler colors)
+        };
+        
+        // Where the child's stdin comes from
+        enum class InputMode {
+            null_device,  // /dev/null: tools never stop to wait for input
+            inherit       // ctc's own stdin, for user programs; on a terminal the child runs in the foreground
+        };
+        
+        // One line of piped output
+        struct OutputLine {
+            double elapsed_seconds = 0;  // since the process was started
+            bool is_stderr = false;
+            std::string text;            // without the line ending
+        };
+        
+        struct ProcessOptions {
+            InputMode stdin_mode = InputMode::null_device;
+            OutputMode stdout_mode = OutputMode::forward;
+            OutputMode stderr_mode = OutputMode::forward;
+            // Called for every line of a piped (forward or capture) stream, from the calling thread
+            std::function<void(const OutputLine&)> on_line;
+            double timeout_seconds = 0;                      // 0: no limit
+            const std::atomic<bool>* cancel = nullptr;       // set (e.g. from another thread) to stop the process
+            std::vector<std::string> environment;            // "NAME=value" entries added to ctc's environment; "NAME" removes one
+            std::filesystem::path working_directory;         // empty: ctc's own
+        };
+        
+        struct ProcessResult {
+            bool started = false;
+            int exit_code = -1;          // when the process exited normally
+            int signal = 0;              // when it was killed by a signal
+            bool timed_out = false;
+            bool cancelled = false;
+            double elapsed_seconds = 0;
+            std::string output;          // captured stdout
+            std::string error_output;    // captured stderr
+            std::string error;           // why the process could not be started
+            
+            bool succeeded() const { return started && exit_code == 0; }
+            // Shell-style status: the exit code, or 128 + signal
+            int status() const;
+            // e.g. "exited with status 2", "killed by signal 11 (Segmentation fault)", "timed out after 30s"
+            std::string describe() const;
+        };
+        
+        // Run argv[0] (looked up on PATH) with the given arguments, without a shell, and wait for it.
+        // The child runs in its own process group so a timeout or cancellation can stop everything it
+        // started; Ctrl-C and termination signals received by ctc meanwhile are passed on to it. With
+        // an inherited terminal stdin that group is the terminal's foreground group while it runs, so
+        // the terminal sends Ctrl-C to it directly. Safe to call from several threads at once.
+        ProcessResult run_process(const std::vector<std::string>& argv, const ProcessOptions& options = {});
+        
+        // Last termination signal (SIGINT, SIGTERM or SIGHUP) ctc received while children were running and
+        // passed on to them, or 0. Lets long-running commands such as 'ctc watch' stop after a Ctrl-C
+        // that ended a child rather than ctc itself. Always 0 on Windows.
+        int forwarded_signal();
+        
+        // argv as a command line for messages, quoting arguments that contain spaces or quotes (on Windows,
+        // the way CommandLineToArgvW reads them back)
+        std::string format_command_line(const std::vector<std::string>& argv);
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ctc {
+    namespace utils {
+        // Call stacks collected by sample_process, folded as "root;caller;callee" -> sample count
+        // (the format used by flamegraph.pl, speedscope and inferno)
+        using FoldedStacks = std::map<std::string, unsigned long long>;
+
+        struct SamplingResult {
+            FoldedStacks stacks;
+            unsigned long long samples = 0;
+            unsigned long long lost = 0;     // samples dropped because the ring buffer was full
+            int exit_status = 0;             // of the profiled program
+        };
+
+        // Run argv (no shell) and sample its user-space call stacks frequency times per second of
+        // CPU time with perf_event_open, unwinding through frame pointers. Addresses are symbolized
+        // from the ELF symbol tables of the mapped files. Linux only; returns false with error set
+        // if sampling is unavailable (e.g. kernel.perf_event_paranoid or a seccomp filter).
+        bool sample_process(const std::vector<std::string>& argv, unsigned frequency, SamplingResult& result, std::string& error);
+
+        // Event counted by count_process
+        enum class Counter { task_clock, cycles, instructions, cache_misses, branch_misses, page_faults };
+        
+        // Name used in reports and result files, e.g. "cache-misses"
+        const char* counter_name(Counter counter);
+        
+        struct CounterReading {
+            Counter counter;
+            bool supported = false;          // false if the CPU, VM or kernel cannot count this event
+            double value = 0;                // scaled up if the event was multiplexed (task-clock in ns)
+            double running_fraction = 0;     // share of the run the event was actually counted
+        };
+        
+        struct CountingResult {
+            std::vector<CounterReading> readings;  // in the order requested
+            double wall_ms = 0;
+            int exit_status = 0;
+        };
+        
+        // Run argv (no shell) once and count user-space events over it and its child processes with
+        // perf_event_open. Events the machine cannot count are reported as unsupported rather than
+        // failing. quiet sends the program's stdout/stderr to /dev/null. Linux only.
+        bool count_process(const std::vector<std::string>& argv, const std::vector<Counter>& counters, bool quiet,
+                           CountingResult& result, std::string& error);
+        
+        // Standalone SVG flame graph (hover a frame for its name and share of the samples)
+        std::string render_flamegraph_svg(const FoldedStacks& stacks, const std::string& title);
+
+        // Folded stacks as text, one "stack count" line per entry
+        std::string format_folded_stacks(const FoldedStacks& stacks);
+    }
+}
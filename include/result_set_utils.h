@@ -0,0 +1,32 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ctc {
+    namespace utils {
+        // Saved result sets of 'ctc bench' (.ctc/bench/<name>.json) and 'ctc stat' (.ctc/stat/<name>.json)
+        
+        // Result set names become file names; "latest" is the last run itself
+        bool is_valid_result_set_name(const std::string& name);
+        
+        // Default name of a saved result set: the short hash of the current git commit; empty outside git
+        std::string current_commit_name();
+        
+        // Copy <results_dir>/latest.json to <results_dir>/<name>.json and report it
+        bool save_result_set(const std::filesystem::path& results_dir, const std::string& name);
+        
+        // One JSON object of a result set, with the members ctc reads back
+        struct ResultRecord {
+            std::map<std::string, std::string> strings;
+            std::map<std::string, double> numbers;
+            std::map<std::string, std::vector<double>> number_arrays;
+        };
+        
+        // Every object (at any depth) of the JSON file that has a string member key_member, in file order.
+        // Other member types are skipped. Returns an empty list if the file is missing or malformed.
+        std::vector<ResultRecord> read_result_records(const std::filesystem::path& path, const std::string& key_member);
+    }
+}
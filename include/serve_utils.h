@@ -0,0 +1,40 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace ctc {
+    namespace utils {
+        // One command a client hands to 'ctc serve'
+        struct ServeRequest {
+            std::string cwd;                       // project directory the command runs in
+            std::string command;                   // "run", "apply", "list" or "serve" (--status, --stop)
+            std::vector<std::string> args;
+            std::vector<std::string> environment;  // the client's "NAME=value" entries, replacing the daemon's own
+            unsigned umask = 022;
+        };
+        
+        // Unix domain socket of the daemon: $CTC_SERVE_SOCKET, else $XDG_RUNTIME_DIR/ctc/serve.sock,
+        // else /tmp/ctc-<uid>/serve.sock. Empty on Windows.
+        std::filesystem::path serve_socket_path();
+        
+#ifndef _WIN32
+        // A directory that is this user's alone: owned by them, not a symlink, no group/other access
+        bool is_private_directory(const std::filesystem::path& directory);
+        // Whether the process at the other end of a connected Unix socket runs as this user (SO_PEERCRED)
+        bool peer_is_this_user(int fd);
+#endif
+        
+        // Wire format of a request: a header with the payload size, then NUL-terminated fields
+        std::string encode_serve_request(const ServeRequest& request);
+        bool decode_serve_request(const std::string& payload, ServeRequest& request);
+        
+        // Hand 'ctc <command> <args>' to a running 'ctc serve', which runs it with this process's
+        // directory, environment, stdout and stderr; Ctrl-C is passed on. Returns false without doing
+        // anything when no daemon is listening, CTC_NO_SERVE is set, or the socket's directory or the
+        // daemon is not this user's, so the caller runs the command itself; otherwise status is the
+        // command's exit status.
+        bool forward_to_server(const std::string& command, const std::vector<std::string>& args, int& status);
+    }
+}
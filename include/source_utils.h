@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <filesystem>
+
+namespace ctc {
+    namespace utils {
+        // A single #include directive found in a source or header file
+        struct IncludeDirective {
+            std::string header;  // name as written between <> or ""
+            bool angled;         // true for #include <...>
+        };
+        
+        // Source and header extensions handled by the scanners
+        bool is_source_file(const std::filesystem::path& path);
+        bool is_header_file(const std::filesystem::path& path);
+        
+        // 64-bit FNV-1a hash, used to detect content changes cheaply
+        unsigned long long hash_content(const std::string& content);
+        
+        // Parse the #include directives of a file's content
+        std::vector<IncludeDirective> parse_includes(const std::string& content);
+        
+        // Top-level directories holding project sources (app/, lib/, include/, bench/). Every command
+        // that walks the project uses the same roots, so they all share the directory snapshot.
+        const std::vector<std::filesystem::path>& project_source_roots();
+        
+        // List every source/header file below roots (sorted generic paths relative to the current
+        // directory). Directory listings are cached in snapshot_path and only directories whose mtime
+        // changed are read again; rescanned_dirs receives their number if given.
+        std::vector<std::string> list_project_files(
+            const std::vector<std::filesystem::path>& roots,
+            const std::filesystem::path& snapshot_path,
+            size_t* rescanned_dirs = nullptr);
+        
+        // Collect the #include directives of files. Results are cached in cache_path: files whose
+        // mtime and size are unchanged are not read, and files whose content hash is unchanged are
+        // not re-parsed. If rescanned is given, it receives the number of files parsed again.
+        std::map<std::string, std::vector<IncludeDirective>> scan_includes(
+            const std::vector<std::string>& files,
+            const std::filesystem::path& cache_path,
+            size_t* rescanned = nullptr);
+        
+        // A library generated from lib/: one per top-level subdirectory, plus one (empty name)
+        // for the source files placed directly in lib/
+        struct LibraryTarget {
+            std::string name;                     // subdirectory of lib/, empty for lib/ itself
+            std::set<std::string> dependencies;   // names of the libraries whose headers it includes
+            std::vector<std::string> sources;     // sorted source files
+            std::string tag;                      // set when another directory's name gives the same target name
+            
+            // CMake target name relative to the project, e.g. "lib_net" (used as ${PROJECT_NAME}_lib_net);
+            // with a tag, "lib_foo_bar_<tag>"
+            std::string target_suffix() const;
+        };
+        
+        // An executable of the per-target layout ('ctc apply --app-targets'): app/<name>.cpp, or every
+        // source file below app/<name>/
+        struct AppTarget {
+            std::string name;                     // also the file name of the executable in bin/
+            std::vector<std::string> sources;     // sorted source files
+        };
+        
+        // Source files of a project as seen by the managed CMake section
+        struct SourceLayout {
+            std::vector<std::string> app_sources;   // sorted source files under app/
+            std::vector<AppTarget> app_targets;     // app_sources grouped into executables, sorted by name
+            std::vector<std::string> bench_sources; // sorted source files under bench/
+            std::vector<LibraryTarget> libraries;   // sorted by name
+        };
+        
+        // Walk the project source roots (using the caches in cache_dir) and group the sources.
+        // Library dependencies are inferred from #include relationships: a header belongs to a
+        // library if it lives in lib/<name>/ or include/<name>/, or if a source file with the same
+        // stem lives in lib/<name>/. Dependency cycles are broken (with a warning), since CMake
+        // only permits them between static libraries.
+        SourceLayout scan_source_layout(const std::filesystem::path& cache_dir);
+        
+        // The same, returning the warnings instead of printing them
+        SourceLayout scan_source_layout(const std::filesystem::path& cache_dir, std::string& warnings);
+        
+        // Make scan_source_layout(cache_dir) hand out layout (and print warnings) instead of walking the
+        // project again. 'ctc serve' scans each project once and passes the result to the commands it
+        // forks until something below a source root changes. An empty cache_dir forgets it.
+        void set_warm_source_layout(const std::filesystem::path& cache_dir, const SourceLayout& layout, const std::string& warnings);
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace ctc {
+    namespace utils {
+        // One timed interval. Times are wall-clock microseconds since the epoch, so intervals
+        // recorded by different processes (ctc, the compile wrapper, ninja) can be combined.
+        struct TimingEvent {
+            std::string name;       // phase name, source file or link output
+            std::string category;   // "phase", "compile" or "link"
+            std::string detail;     // e.g. the CMake target of a translation unit
+            std::string output;     // absolute path of the file a compile/link step produced
+            long long start_us = 0;
+            long long duration_us = 0;
+        };
+
+        // Aggregated cost of one template instantiation (Clang -ftime-trace)
+        struct TemplateCost {
+            std::string name;
+            long long total_us = 0;
+            size_t count = 0;
+        };
+
+        long long wall_clock_us();
+
+        // Internal command used as RULE_LAUNCH_COMPILE/RULE_LAUNCH_LINK while timing a build:
+        // args are <log> -- <command...>. Runs the command without a shell and appends its start,
+        // end and output file to the log. Returns the command's exit status.
+        int run_timed_command(const std::vector<std::string>& args);
+
+        // Write <build_dir>/ctc_timings.cmake, to be passed as CMAKE_PROJECT_INCLUDE. When enabled, it
+        // routes compile and link steps through `<ctc> __time-compile <log>` unless use_ninja_log is
+        // set, and enables -ftime-trace under Clang; otherwise it is empty, so the tree's cached
+        // arguments can stay the same. Returns the path of the file, or an empty path on failure.
+        std::filesystem::path write_timing_project_include(const std::filesystem::path& build_dir, bool enabled,
+                                                           bool use_ninja_log, bool* changed = nullptr);
+
+        // Path of the log written by run_timed_command for a build tree
+        std::filesystem::path timing_log_path(const std::filesystem::path& build_dir);
+
+        // The entries of <build_dir>/.ninja_log, as complete lines; taken before a build for read_step_timings
+        std::set<std::string> read_ninja_log_entries(const std::filesystem::path& build_dir);
+        
+        // Compile and link steps of the last build. Read from the wrapper log, or from the .ninja_log
+        // entries not in ninja_log_before (ninja times are relative to build_start_us).
+        std::vector<TimingEvent> read_step_timings(const std::filesystem::path& build_dir, bool use_ninja_log,
+                                                   const std::set<std::string>& ninja_log_before, long long build_start_us);
+
+        // Sum the InstantiateClass/InstantiateFunction events of the -ftime-trace files that belong
+        // to the given compile steps, most expensive first
+        std::vector<TemplateCost> collect_template_costs(const std::vector<TimingEvent>& steps);
+
+        // Print phase totals, the slowest steps and the most expensive templates
+        void print_timing_report(const std::vector<TimingEvent>& phases, const std::vector<TimingEvent>& steps,
+                                 const std::vector<TemplateCost>& templates, size_t top);
+
+        // Write all events as Chrome trace JSON (chrome://tracing, Perfetto)
+        bool write_chrome_trace(const std::filesystem::path& path, const std::vector<TimingEvent>& phases,
+                                const std::vector<TimingEvent>& steps);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ctc {
+    namespace utils {
+        // One change reported by FileWatcher
+        struct FileChange {
+            std::string path;           // generic path as watched, e.g. "lib/net/socket.cpp" or "./.libname"
+            bool is_directory = false;
+            bool structural = false;    // created, deleted or renamed, rather than rewritten in place
+            bool overflow = false;      // the kernel dropped events; anything may have changed
+        };
+        
+        // Watches directories for files being written, created, deleted or renamed (Linux inotify).
+        // Subdirectories of recursively watched directories are watched too, including ones created later.
+        class FileWatcher {
+        public:
+            FileWatcher();
+            ~FileWatcher();
+            FileWatcher(const FileWatcher&) = delete;
+            FileWatcher& operator=(const FileWatcher&) = delete;
+            
+            // False if inotify is unavailable (error() says why), e.g. on other platforms
+            bool valid() const { return fd_ >= 0; }
+            const std::string& error() const { return error_; }
+            // Descriptor that becomes readable when changes are pending, to wait on it together with others
+            int fd() const { return fd_; }
+            
+            // Start watching dir; a directory that does not exist is skipped
+            bool add_directory(const std::filesystem::path& dir, bool recursive);
+            
+            // Wait up to timeout_ms (-1: indefinitely) for changes and append them to changes.
+            // Returns false if reading the events failed.
+            bool wait(int timeout_ms, std::vector<FileChange>& changes);
+        
+        private:
+            struct WatchedDirectory {
+                std::filesystem::path path;
+                bool recursive = false;
+            };
+            
+            int fd_ = -1;
+            std::string error_;
+            std::map<int, WatchedDirectory> directories_;  // by watch descriptor
+        };
+    }
+}
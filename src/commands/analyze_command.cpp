@@ -0,0 +1,326 @@
+#include "commands.h"
+#include "file_utils.h"
+#include "build_utils.h"
+#include "analyze_utils.h"
+#include "process_utils.h"
+#include "source_utils.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace ctc {
+    namespace commands {
+        
+        namespace {
+            const std::filesystem::path results_path = ".ctc/analyze/includes.json";
+            
+            std::string json_escape(const std::string& text) {
+                std::string escaped;
+                for (char c : text) {
+                    if (c == '"' || c == '\\') {
+                        escaped += '\\';
+                        escaped += c;
+                    } else if (static_cast<unsigned char>(c) < 0x20) {
+                        escaped += ' ';
+                    } else {
+                        escaped += c;
+                    }
+                }
+                return escaped;
+            }
+            
+            std::string format_kb(unsigned long long bytes) {
+                std::ostringstream text;
+                text << std::fixed << std::setprecision(1) << static_cast<double>(bytes) / 1024;
+                return text.str();
+            }
+            
+            // Long paths keep their end, which names the header
+            std::string shorten(const std::string& path, size_t width) {
+                return path.size() <= width ? path : "..." + path.substr(path.size() - (width - 3));
+            }
+            
+            bool is_app_or_lib_file(const std::string& file, const std::string& root) {
+                return file.compare(0, root.size() + 5, root + "/app/") == 0 || file.compare(0, root.size() + 5, root + "/lib/") == 0;
+            }
+            
+            // A unity batch (CMake's Unity/unity_<n>_cxx.cxx); it counts if it batches sources of app/ or lib/
+            bool is_unity_batch(const std::string& file) {
+                return file.find("/Unity/unity_") != std::string::npos;
+            }
+            
+            // A header as reported by the analysis
+            struct HeaderRow {
+                utils::HeaderCost cost;
+                std::string name;        // relative to the project when inside it
+                bool in_project = false; // the project's own header, not a system one or one CMake generated
+                std::string note;
+            };
+        }
+        
+        int analyze_command(const std::vector<std::string>& args) {
+            if (args.empty() || args[0] != "includes") {
+                std::cerr << "Usage: ctc analyze includes [-m <mode>] [-j <jobs>] [-G <generator>] [--top <n>] [--sort bytes|tus|fanout] [--project]\n";
+                return 1;
+            }
+            std::string build_mode = "Release";
+            unsigned jobs = 0; // 0 = detect from usable cores
+            std::string requested_generator;
+            size_t top_count = 25;
+            std::string sort_key = "bytes";
+            bool project_only = false;
+            
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (args[i] == "-m" && i + 1 < args.size()) {
+                    build_mode = args[++i];
+                    if (build_mode != "Debug" && build_mode != "Release" && build_mode != "MinSizeRel" && build_mode != "RelWithDebInfo") {
+                        std::cerr << "Error: Invalid build mode '" << build_mode << "'. Valid modes are: Debug, Release, MinSizeRel, RelWithDebInfo\n";
+                        return 1;
+                    }
+                } else if ((args[i] == "-j" || args[i] == "--jobs") && i + 1 < args.size()) {
+                    if (!utils::parse_job_count(args[i + 1], jobs)) {
+                        std::cerr << "Error: Invalid job count '" << args[i + 1] << "'. Expected an integer from 1 to " << utils::max_job_count << "\n";
+                        return 1;
+                    }
+                    ++i;
+                } else if (args[i] == "--top" && i + 1 < args.size()) {
+                    unsigned long long value = 0;
+                    if (!utils::parse_integer(args[i + 1], 1, 1000000, value)) {
+                        std::cerr << "Error: Invalid value '" << args[i + 1] << "' for --top. Expected an integer from 1 to 1000000\n";
+                        return 1;
+                    }
+                    top_count = static_cast<size_t>(value);
+                    ++i;
+                } else if ((args[i] == "-G" || args[i] == "--generator") && i + 1 < args.size()) {
+                    requested_generator = args[++i];
+                } else if (args[i] == "--sort" && i + 1 < args.size()) {
+                    sort_key = args[++i];
+                    if (sort_key != "bytes" && sort_key != "tus" && sort_key != "fanout") {
+                        std::cerr << "Error: Invalid sort key '" << sort_key << "'. Valid keys are: bytes, tus, fanout\n";
+                        return 1;
+                    }
+                } else if (args[i] == "--project") {
+                    project_only = true;
+                } else {
+                    std::cerr << "Error: Unknown option '" << args[i] << "'\n";
+                    return 1;
+                }
+            }
+            
+            const std::filesystem::path cmake_path = "CMakeLists.txt";
+            const std::filesystem::path manifest_path = "ctc_sources.cmake";
+            if (!std::filesystem::exists(cmake_path)) {
+                std::cerr << "Error: CMakeLists.txt not found. Run 'ctc apply' or use 'ctc run -U' first.\n";
+                return 1;
+            }
+            
+            try {
+                // 1. compile_commands.json of the mode's build tree (configure exports it; no build needed)
+                if (std::filesystem::exists(manifest_path)) {
+                    bool manifest_changed = false;
+                    if (!utils::update_sources_manifest(manifest_path, &manifest_changed)) {
+                        std::cerr << "Failed to update " << manifest_path.generic_string() << "\n";
+                        return 1;
+                    }
+                }
+                if (jobs == 0) {
+                    jobs = utils::detect_job_count();
+                }
+                utils::BuildTreeOptions tree;
+                tree.build_dir = std::filesystem::path("build") / build_mode;
+                tree.build_mode = build_mode;
+                tree.generator = requested_generator;
+                tree.jobs = jobs;
+                if (!utils::prepare_build_tree(tree) || !utils::configure_build_tree(tree)) {
+                    return 1;
+                }
+                const std::filesystem::path database_path = tree.build_dir / "compile_commands.json";
+                if (!std::filesystem::exists(database_path)) {
+                    std::cerr << "Error: " << database_path.generic_string() << " was not written; the generator '"
+                              << utils::select_generator(tree.build_dir, "") << "' does not export compile commands (use Ninja or Makefiles)\n";
+                    return 1;
+                }
+                
+                const std::string root = std::filesystem::current_path().generic_string();
+                std::vector<utils::CompileCommand> commands;
+                for (auto& command : utils::read_compile_commands(database_path)) {
+                    const std::string file = command.file.generic_string();
+                    if (is_app_or_lib_file(file, root) || is_unity_batch(file)) {
+                        commands.push_back(std::move(command));
+                    }
+                }
+                if (commands.empty()) {
+                    std::cerr << "Error: No translation units under app/ or lib/ in " << database_path.generic_string() << "\n";
+                    return 1;
+                }
+                if (utils::preprocess_arguments(commands[0].arguments).empty()) {
+                    std::cerr << "Error: Include analysis needs GCC or Clang (preprocessor line markers); "
+                              << commands[0].arguments[0] << " is not supported\n";
+                    return 1;
+                }
+                
+                // 2. Preprocess every translation unit and rebuild its include tree from the line markers
+                std::cout << "Preprocessing " << commands.size() << " translation units (" << jobs << " parallel jobs)...\n" << std::flush;
+                std::vector<utils::TranslationUnitIncludes> units(commands.size());
+                std::vector<std::string> failures(commands.size());
+                std::atomic<size_t> next{0};
+                auto worker = [&]() {
+                    for (size_t i = next++; i < commands.size(); i = next++) {
+                        utils::ProcessOptions options;
+                        options.stdout_mode = utils::OutputMode::capture;
+                        options.stderr_mode = utils::OutputMode::capture;
+                        options.working_directory = commands[i].directory;
+                        const utils::ProcessResult result = utils::run_process(utils::preprocess_arguments(commands[i].arguments), options);
+                        if (!result.succeeded()) {
+                            failures[i] = result.started ? result.describe() + "\n" + result.error_output : result.error;
+                            continue;
+                        }
+                        units[i] = utils::parse_preprocessed_output(commands[i].file.generic_string(), result.output);
+                    }
+                };
+                std::vector<std::thread> threads;
+                for (unsigned t = 0; t < std::min<size_t>(jobs, commands.size()); ++t) {
+                    threads.emplace_back(worker);
+                }
+                for (auto& thread : threads) {
+                    thread.join();
+                }
+                
+                std::vector<utils::TranslationUnitIncludes> analyzed;
+                unsigned long long total_bytes = 0;
+                for (size_t i = 0; i < commands.size(); ++i) {
+                    if (!failures[i].empty()) {
+                        std::cerr << "Warning: Preprocessing " << commands[i].file.generic_string() << " failed: " << failures[i] << "\n";
+                        continue;
+                    }
+                    if (is_unity_batch(units[i].file) && std::none_of(units[i].headers.begin(), units[i].headers.end(), [&root](const auto& header) {
+                            return is_app_or_lib_file(header.first, root);
+                        })) {
+                        continue; // e.g. the batch of bench/
+                    }
+                    total_bytes += units[i].bytes;
+                    analyzed.push_back(std::move(units[i]));
+                }
+                if (analyzed.empty()) {
+                    std::cerr << "Error: No translation unit could be preprocessed\n";
+                    return 1;
+                }
+                
+                // 3. Per header: translation units, bytes, fan-out and fan-in
+                auto display_name = [&root](const std::string& path) {
+                    return path.compare(0, root.size() + 1, root + "/") == 0 ? path.substr(root.size() + 1) : path;
+                };
+                const std::string pch_header = ".ctc/pch.h";
+                std::vector<HeaderRow> rows;
+                size_t include_dir_headers = 0;
+                unsigned long long include_dir_bytes = 0;
+                for (auto& cost : utils::aggregate_header_costs(analyzed)) {
+                    HeaderRow row;
+                    row.name = display_name(cost.header);
+                    if (row.name.compare(0, 6, "build/") == 0) {
+                        continue; // CMake's wrappers around the PCH (cmake_pch.hxx) and other generated files
+                    }
+                    if (is_app_or_lib_file(cost.header, root) && utils::is_source_file(cost.header)) {
+                        continue; // a source file of a unity batch: part of the translation unit, not a header
+                    }
+                    row.in_project = row.name != cost.header;
+                    bool from_project = false;  // included directly by a project file
+                    bool in_pch = row.name == pch_header;
+                    for (const auto& includer : cost.included_by) {
+                        const std::string name = display_name(includer);
+                        in_pch = in_pch || name == pch_header;
+                        from_project = from_project || (name != includer && name.compare(0, 6, "build/") != 0);
+                    }
+                    // Headers worth precompiling, and project headers that cost mostly through what they include
+                    if (in_pch) {
+                        row.note = "in PCH";
+                    } else if (!row.in_project && from_project && cost.translation_units >= 2 && 2 * cost.translation_units >= analyzed.size()) {
+                        row.note = "PCH candidate";
+                    } else if (row.in_project && cost.translation_units >= 2 && cost.own_bytes * 10 < cost.total_bytes) {
+                        row.note = "heavy includes";
+                    }
+                    if (row.name.compare(0, 8, "include/") == 0) {
+                        ++include_dir_headers;
+                        include_dir_bytes += cost.total_bytes;
+                    }
+                    row.cost = std::move(cost);
+                    rows.push_back(std::move(row));
+                }
+                std::sort(rows.begin(), rows.end(), [&sort_key](const HeaderRow& a, const HeaderRow& b) {
+                    auto key = [&sort_key](const HeaderRow& row) {
+                        if (sort_key == "tus") return static_cast<unsigned long long>(row.cost.translation_units);
+                        if (sort_key == "fanout") return static_cast<unsigned long long>(row.cost.includes.size());
+                        return row.cost.total_bytes;
+                    };
+                    return key(a) != key(b) ? key(a) > key(b) : a.name < b.name;
+                });
+                
+                // 4. Report the top headers and keep everything in .ctc/analyze/includes.json
+                std::cout << "\nInclude graph of " << analyzed.size() << " translation units: " << rows.size() << " headers, "
+                          << format_kb(total_bytes) << " KB preprocessed\n\n";
+                const size_t name_width = 48;
+                std::cout << std::left << std::setw(static_cast<int>(name_width)) << "header" << std::right << std::setw(6) << "TUs"
+                          << std::setw(12) << "total KB" << std::setw(8) << "% all" << std::setw(10) << "own KB" << std::setw(9) << "fan-out"
+                          << std::setw(8) << "fan-in" << "  note\n";
+                size_t shown = 0;
+                for (const auto& row : rows) {
+                    if (shown == top_count) break;
+                    if (project_only && !row.in_project) continue;
+                    ++shown;
+                    std::cout << std::left << std::setw(static_cast<int>(name_width)) << shorten(row.name, name_width - 2) << std::right
+                              << std::setw(6) << row.cost.translation_units << std::setw(12) << format_kb(row.cost.total_bytes)
+                              << std::setw(8) << std::fixed << std::setprecision(1) << 100.0 * static_cast<double>(row.cost.total_bytes) / static_cast<double>(total_bytes)
+                              << std::setw(10) << format_kb(row.cost.own_bytes) << std::setw(9) << row.cost.includes.size()
+                              << std::setw(8) << row.cost.included_by.size() << (row.note.empty() ? "" : "  " + row.note) << "\n";
+                }
+                std::cout << "\nTUs: translation units including the header, directly or not. total KB: preprocessed bytes it adds to\n"
+                          << "them, with everything first included through it; own KB: its own lines. fan-out/fan-in: headers it\n"
+                          << "includes directly / files that include it directly.\n";
+                if (std::any_of(rows.begin(), rows.end(), [](const HeaderRow& row) { return row.note == "in PCH"; })) {
+                    std::cout << "Headers in the PCH are counted as text; with the PCH a target parses them once, not once per TU.\n";
+                }
+                if (include_dir_headers > 0) {
+                    std::cout << "Headers under include/: " << include_dir_headers << ", " << format_kb(include_dir_bytes) << " KB ("
+                              << std::fixed << std::setprecision(1) << 100.0 * static_cast<double>(include_dir_bytes) / static_cast<double>(total_bytes)
+                              << "% of all preprocessed bytes, nested headers counted with each includer)\n";
+                }
+                
+                std::ostringstream json;
+                json << "{\n  \"mode\": \"" << build_mode << "\",\n  \"translation_units\": [";
+                for (size_t i = 0; i < analyzed.size(); ++i) {
+                    json << (i ? "," : "") << "\n    {\"file\": \"" << json_escape(display_name(analyzed[i].file)) << "\", \"bytes\": " << analyzed[i].bytes << "}";
+                }
+                json << "\n  ],\n  \"headers\": [";
+                for (size_t i = 0; i < rows.size(); ++i) {
+                    const auto& cost = rows[i].cost;
+                    json << (i ? "," : "") << "\n    {\"header\": \"" << json_escape(rows[i].name) << "\", \"translation_units\": " << cost.translation_units
+                         << ", \"total_bytes\": " << cost.total_bytes << ", \"own_bytes\": " << cost.own_bytes << ", \"note\": \"" << rows[i].note << "\",\n"
+                         << "     \"includes\": [";
+                    size_t j = 0;
+                    for (const auto& header : cost.includes) {
+                        json << (j++ ? ", " : "") << "\"" << json_escape(display_name(header)) << "\"";
+                    }
+                    json << "],\n     \"included_by\": [";
+                    j = 0;
+                    for (const auto& includer : cost.included_by) {
+                        json << (j++ ? ", " : "") << "\"" << json_escape(display_name(includer)) << "\"";
+                    }
+                    json << "]}";
+                }
+                json << "\n  ]\n}\n";
+                if (utils::create_directory_if_not_exists(results_path.parent_path()) && utils::write_file(results_path, json.str())) {
+                    std::cout << "Full include graph written to " << results_path.generic_string() << "\n";
+                }
+                return 0;
+            
+            } catch (const std::exception& e) {
+                std::cerr << "Error analyzing includes: " << e.what() << "\n";
+                return 1;
+            }
+        }
+    }
+}
@@ -9,11 +9,18 @@ namespace ctc {
         int apply_command(const std::vector<std::string>& args) {
             std::string project_name = "my_project"; // Default name
             
-            // Parse arguments for -n flag
+            std::vector<utils::SettingChange> setting_changes; // --unity etc., persisted in .libname
+            
+            // Parse arguments for -n flag and build setting options
             for (size_t i = 0; i < args.size(); ++i) {
+                std::string error;
                 if (args[i] == "-n" && i + 1 < args.size()) {
-                    project_name = args[i + 1];
-                    break;
+                    project_name = args[++i];
+                } else if (utils::parse_setting_option(args, i, setting_changes, error)) {
+                    if (!error.empty()) {
+                        std::cerr << "Error: " << error << "\n";
+                        return 1;
+                    }
                 }
             }
             
@@ -29,6 +36,12 @@ namespace ctc {
                     return 1;
                 }
                 
+                // Record build setting changes before generating CMake from .libname
+                if (!setting_changes.empty() && !utils::apply_setting_changes(libname_path, setting_changes)) {
+                    std::cerr << "Failed to update .libname file\n";
+                    return 1;
+                }
+                
                 // Read dependencies from .libname
                 std::cout << "Reading dependencies from .libname...\n";
                 std::vector<utils::DependencyEntry> dependencies = utils::read_libname(libname_path);
@@ -43,18 +56,19 @@ namespace ctc {
                 
                 // Update CMakeLists.txt
                 std::cout << "Updating CMakeLists.txt with project name '" << project_name << "'...\n";
-                if (!utils::update_cmake_file(cmake_path, project_name, dependencies)) {
+                bool cmake_changed = false;
+                if (!utils::update_cmake_file(cmake_path, project_name, dependencies, &cmake_changed)) {
                     std::cerr << "Failed to update CMakeLists.txt\n";
                     return 1;
                 }
                 
-                std::cout << "Successfully updated CMakeLists.txt!\n";
+                std::cout << (cmake_changed ? "Successfully updated CMakeLists.txt!\n" : "CMakeLists.txt is already up to date (not rewritten).\n");
                 
                 if (!dependencies.empty()) {
                     std::cout << "\nApplied dependencies:\n";
                     
                     // Group and show dependencies
-                    std::vector<utils::DependencyEntry> packages, lib_paths, lib_names, inc_paths, toolchain_paths, pkg_components, link_overrides;
+                    std::vector<utils::DependencyEntry> packages, lib_paths, lib_names, inc_paths, toolchain_paths, pkg_components, link_overrides, launchers, unity_settings, pch_headers, lto_modes, app_targets;
                     
                     for (const auto& dep : dependencies) {
                         switch (dep.type) {
@@ -79,6 +93,22 @@ namespace ctc {
                             case utils::DependencyEntry::LINK_OVERRIDE:
                                 link_overrides.push_back(dep);
                                 break;
+                            case utils::DependencyEntry::COMPILER_LAUNCHER:
+                                launchers.push_back(dep);
+                                break;
+                            case utils::DependencyEntry::UNITY_BUILD:
+                            case utils::DependencyEntry::UNITY_EXCLUDE:
+                                unity_settings.push_back(dep);
+                                break;
+                            case utils::DependencyEntry::PCH_HEADER:
+                                pch_headers.push_back(dep);
+                                break;
+                            case utils::DependencyEntry::LTO_MODE:
+                                lto_modes.push_back(dep);
+                                break;
+                            case utils::DependencyEntry::APP_TARGETS:
+                                app_targets.push_back(dep);
+                                break;
                         }
                     }
                     
@@ -144,6 +174,40 @@ namespace ctc {
                         }
                         std::cout << "\n";
                     }
+                    
+                    if (!launchers.empty()) {
+                        std::cout << "  - Compiler cache: ";
+                        for (size_t i = 0; i < launchers.size(); ++i) {
+                            if (i > 0) std::cout << ", ";
+                            std::cout << launchers[i].value;
+                        }
+                        std::cout << "\n";
+                    }
+                    
+                    if (!unity_settings.empty()) {
+                        std::cout << "  - Unity build: ";
+                        for (size_t i = 0; i < unity_settings.size(); ++i) {
+                            if (i > 0) std::cout << ", ";
+                            if (unity_settings[i].type == utils::DependencyEntry::UNITY_BUILD) {
+                                std::cout << "batch size " << unity_settings[i].value;
+                            } else {
+                                std::cout << "excluding " << unity_settings[i].value;
+                            }
+                        }
+                        std::cout << "\n";
+                    }
+                    
+                    if (!pch_headers.empty()) {
+                        std::cout << "  - Precompiled header: " << pch_headers.front().value << "\n";
+                    }
+                    
+                    if (!lto_modes.empty()) {
+                        std::cout << "  - Link-time optimization: " << lto_modes.front().value << "\n";
+                    }
+                    
+                    if (!app_targets.empty()) {
+                        std::cout << "  - Executables: one per app/<name>.cpp or app/<name>/\n";
+                    }
                 }
                 
                 std::cout << "\nCMakeLists.txt is now ready. Use 'ctc run' to build your project.\n";
@@ -0,0 +1,234 @@
+#include "commands.h"
+#include "file_utils.h"
+#include "build_utils.h"
+#include "bench_utils.h"
+#include "result_set_utils.h"
+#include "process_utils.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <cstdlib>
+
+namespace ctc {
+    namespace commands {
+        
+        namespace {
+            const std::filesystem::path results_dir = ".ctc/bench";
+            
+            void list_result_sets() {
+                std::vector<std::string> names;
+                std::error_code ec;
+                for (const auto& entry : std::filesystem::directory_iterator(results_dir, ec)) {
+                    if (entry.path().extension() == ".json" && entry.path().stem() != "latest") {
+                        names.push_back(entry.path().stem().string());
+                    }
+                }
+                std::sort(names.begin(), names.end());
+                if (names.empty()) {
+                    std::cout << "No saved benchmark results. Use 'ctc bench --save [<name>]'.\n";
+                    return;
+                }
+                std::cout << "Saved benchmark results (" << results_dir.generic_string() << "):\n";
+                for (const auto& name : names) {
+                    std::cout << "  " << name << "\n";
+                }
+            }
+            
+            // Print the comparison table; returns the number of regressions
+            size_t print_comparison(const std::string& baseline_name, const std::vector<utils::BenchmarkComparison>& comparisons,
+                                    double alpha, double threshold) {
+                std::cout << "\nComparison with '" << baseline_name << "' (Mann-Whitney U, alpha " << alpha
+                          << ", regression threshold " << threshold << "%):\n";
+                std::cout << std::left << std::setw(40) << "benchmark" << std::right << std::setw(14) << "baseline ns" << std::setw(14)
+                          << "current ns" << std::setw(10) << "change" << std::setw(10) << "p-value" << "  verdict\n";
+                size_t regressions = 0;
+                for (const auto& c : comparisons) {
+                    std::cout << std::left << std::setw(40) << c.name << std::right << std::fixed << std::setprecision(2);
+                    std::cout << std::setw(14);
+                    if (c.baseline_ns > 0) std::cout << c.baseline_ns; else std::cout << "-";
+                    std::cout << std::setw(14);
+                    if (c.current_ns > 0) std::cout << c.current_ns; else std::cout << "-";
+                    if (c.verdict == "new" || c.verdict == "removed") {
+                        std::cout << std::setw(10) << "" << std::setw(10) << "";
+                    } else {
+                        std::ostringstream change;
+                        change << std::showpos << std::fixed << std::setprecision(1) << c.change_percent << "%";
+                        std::cout << std::setw(10) << change.str() << std::setw(10) << std::setprecision(4) << c.p_value;
+                    }
+                    std::cout << "  " << c.verdict << (c.regression ? " (REGRESSION)" : "") << "\n";
+                    if (c.regression) ++regressions;
+                }
+                return regressions;
+            }
+        }
+        
+        int bench_command(const std::vector<std::string>& args) {
+            unsigned jobs = 0; // 0 = detect from usable cores
+            std::string requested_generator;
+            std::vector<std::string> harness_args; // passed through to the benchmark executable
+            bool save = false;
+            std::string save_name;      // empty: current git commit
+            std::string compare_name;
+            double threshold = 5.0;     // percent slowdown that fails the comparison
+            const double alpha = 0.05;
+            
+            for (size_t i = 0; i < args.size(); ++i) {
+                if (args[i] == "--init") {
+                    // Add bench/ to an existing project
+                    if (!utils::create_bench_skeleton()) {
+                        return 1;
+                    }
+                } else if (args[i] == "--list") {
+                    list_result_sets();
+                    return 0;
+                } else if (args[i] == "--save") {
+                    save = true;
+                    if (i + 1 < args.size() && args[i + 1][0] != '-') {
+                        save_name = args[++i];
+                    }
+                } else if (args[i] == "--compare" && i + 1 < args.size()) {
+                    compare_name = args[++i];
+                } else if (args[i] == "--threshold" && i + 1 < args.size()) {
+                    char* end = nullptr;
+                    threshold = std::strtod(args[i + 1].c_str(), &end);
+                    if (end == args[i + 1].c_str() || *end != '\0' || threshold < 0) {
+                        std::cerr << "Error: Invalid threshold '" << args[i + 1] << "'. Expected a non-negative percentage\n";
+                        return 1;
+                    }
+                    ++i;
+                } else if ((args[i] == "-j" || args[i] == "--jobs") && i + 1 < args.size()) {
+                    if (!utils::parse_job_count(args[i + 1], jobs)) {
+                        std::cerr << "Error: Invalid job count '" << args[i + 1] << "'. Expected an integer from 1 to " << utils::max_job_count << "\n";
+                        return 1;
+                    }
+                    ++i;
+                } else if ((args[i] == "-G" || args[i] == "--generator") && i + 1 < args.size()) {
+                    requested_generator = args[++i];
+                } else if ((args[i] == "--filter" || args[i] == "--samples" || args[i] == "--warmup-ms" || args[i] == "--sample-ms") && i + 1 < args.size()) {
+                    harness_args.insert(harness_args.end(), {args[i], args[i + 1]});
+                    ++i;
+                } else {
+                    std::cerr << "Error: Unknown option '" << args[i] << "'\n";
+                    std::cerr << "Usage: ctc bench [--init] [-j <jobs>] [-G <generator>] [--filter <text>] [--samples <n>] [--warmup-ms <ms>] [--sample-ms <ms>]\n";
+                    std::cerr << "                 [--save [<name>]] [--compare <name>] [--threshold <percent>] [--list]\n";
+                    return 1;
+                }
+            }
+            
+            if (save && save_name.empty()) {
+                save_name = utils::current_commit_name();
+                if (save_name.empty()) {
+                    std::cerr << "Error: Not in a git repository; give --save a name\n";
+                    return 1;
+                }
+            }
+            if (save && !utils::is_valid_result_set_name(save_name)) {
+                std::cerr << "Error: Invalid result set name '" << save_name << "'\n";
+                return 1;
+            }
+            std::vector<utils::BenchmarkResult> baseline;
+            if (!compare_name.empty()) {
+                // The name becomes a path; check it before anything is read
+                if (!utils::is_valid_result_set_name(compare_name)) {
+                    std::cerr << "Error: Invalid result set name '" << compare_name << "'\n";
+                    return 1;
+                }
+                baseline = utils::read_bench_results(results_dir / (compare_name + ".json"));
+                if (baseline.empty()) {
+                    std::cerr << "Error: No saved benchmark results named '" << compare_name << "'\n";
+                    list_result_sets();
+                    return 1;
+                }
+            }
+            
+            if (!std::filesystem::exists("bench")) {
+                std::cerr << "Error: bench/ not found. Use 'ctc bench --init' (or 'ctc init -b' for a new project) to create it.\n";
+                return 1;
+            }
+            if (!std::filesystem::exists("CMakeLists.txt")) {
+                std::cerr << "Error: CMakeLists.txt not found. Run 'ctc apply' or use 'ctc run -U' first.\n";
+                return 1;
+            }
+            if (utils::read_file("CMakeLists.txt").find("CTC_BENCH_TARGET") == std::string::npos) {
+                std::cerr << "Error: CMakeLists.txt has no benchmark target. Run 'ctc apply' to regenerate the managed section.\n";
+                return 1;
+            }
+            if (jobs == 0) {
+                jobs = utils::detect_job_count();
+            }
+            
+            try {
+                // Pick up added or removed benchmark files
+                if (!utils::update_sources_manifest("ctc_sources.cmake")) {
+                    std::cerr << "Failed to update ctc_sources.cmake\n";
+                    return 1;
+                }
+                
+                // Benchmarks always use the Release tree shared with 'ctc run'
+                utils::BuildTreeOptions tree;
+                tree.build_dir = std::filesystem::path("build") / "Release";
+                tree.generator = requested_generator;
+                tree.jobs = jobs;
+                if (!utils::prepare_build_tree(tree) || !utils::configure_build_tree(tree)) {
+                    return 1;
+                }
+                tree.target = utils::read_cmake_cache_value(tree.build_dir, "CMAKE_PROJECT_NAME") + "_bench";
+                if (!utils::build_build_tree(tree)) {
+                    return 1;
+                }
+                
+                // Single-config generators put it in bench/, multi-config ones in bench/Release/
+                std::filesystem::path executable;
+                for (const auto& candidate : {tree.build_dir / "bench" / "ctc_bench", tree.build_dir / "bench" / "Release" / "ctc_bench",
+                                              tree.build_dir / "bench" / "ctc_bench.exe", tree.build_dir / "bench" / "Release" / "ctc_bench.exe"}) {
+                    if (std::filesystem::exists(candidate)) {
+                        executable = candidate;
+                        break;
+                    }
+                }
+                if (executable.empty()) {
+                    std::cerr << "Error: Benchmark executable not found in " << (tree.build_dir / "bench").generic_string()
+                              << ". Does bench/ contain any source files?\n";
+                    return 1;
+                }
+                
+                if (!utils::create_directory_if_not_exists(results_dir)) {
+                    std::cerr << "Failed to create " << results_dir.generic_string() << "\n";
+                    return 1;
+                }
+                const std::filesystem::path results = results_dir / "latest.json";
+                std::cout << "Running benchmarks...\n";
+                std::vector<std::string> command = {executable.string(), "--json", results.string()};
+                command.insert(command.end(), harness_args.begin(), harness_args.end());
+                const utils::ProcessResult run = utils::run_process(command);
+                if (!run.succeeded()) {
+                    std::cerr << "Benchmarks failed (" << run.describe() << ")\n";
+                    return 1;
+                }
+                std::cout << "Results written to " << results.generic_string() << "\n";
+                
+                // Compare before saving, so a run can be compared with and then replace a set of the same name
+                size_t regressions = 0;
+                if (!compare_name.empty()) {
+                    const auto current = utils::read_bench_results(results);
+                    regressions = print_comparison(compare_name, utils::compare_bench_results(baseline, current, alpha, threshold),
+                                                   alpha, threshold);
+                }
+                if (save && !utils::save_result_set(results_dir, save_name)) {
+                    return 1;
+                }
+                if (regressions > 0) {
+                    std::cerr << regressions << " benchmark(s) regressed by more than " << threshold << "%\n";
+                    return 1;
+                }
+                return 0;
+                
+            } catch (const std::exception& e) {
+                std::cerr << "Error during benchmark: " << e.what() << "\n";
+                return 1;
+            }
+        }
+    }
+}
@@ -8,12 +8,14 @@ namespace ctc {
         
         int init_command(const std::vector<std::string>& args) {
             bool create_readme = false;
+            bool create_bench = false;
             
-            // Check for -r flag
+            // Check for -r and -b flags
             for (const auto& arg : args) {
                 if (arg == "-r") {
                     create_readme = true;
-                    break;
+                } else if (arg == "-b") {
+                    create_bench = true;
                 }
             }
             
@@ -60,6 +62,11 @@ namespace ctc {
                     std::cout << "Created file: README.md\n";
                 }
                 
+                // Create bench/ with the benchmark harness if -b flag was used
+                if (create_bench && !utils::create_bench_skeleton()) {
+                    return 1;
+                }
+                
                 std::cout << "Project initialization complete!\n";
                 std::cout << "You can now add your source files to the app/ and lib/ directories.\n";
                 std::cout << "Use 'ctc run' to build your project.\n";
@@ -1,5 +1,6 @@
 #include "commands.h"
 #include "file_utils.h"
+#include "build_utils.h"
 #include <iostream>
 #include <filesystem>
 #include <algorithm>
@@ -8,12 +9,15 @@ namespace ctc {
     namespace commands {
         
         int install_command(const std::vector<std::string>& args) {
-            if (args.empty()) {
-                std::cerr << "Error: Argument required\n";
-                std::cerr << "Usage: ctc install <package-name>\n";
+            std::vector<utils::DependencyEntry> entries;
+            std::string error;
+            if (!utils::parse_dependency_operations(args, false, entries, error)) {
+                std::cerr << "Error: " << error << "\n";
+                std::cerr << "Usage: ctc install <package-name> [-c <component>]...\n";
                 std::cerr << "       ctc install -L <library-path>\n";
                 std::cerr << "       ctc install -l <library-name>\n";
                 std::cerr << "       ctc install -I <include-path>\n";
+                std::cerr << "       (several operations can be combined, e.g. ctc install Boost -c system -l pthread -I /opt/x)\n";
                 return 1;
             }
             
@@ -26,129 +30,42 @@ namespace ctc {
             }
             
             try {
-                utils::DependencyEntry entry;
+                // All edits go into one locked read-modify-write of .libname
+                utils::LibnameTransaction transaction(libname_path);
+                if (!transaction.locked()) {
+                    std::cerr << "Error: Could not lock .libname for editing\n";
+                    return 1;
+                }
                 
-                // Parse arguments
-                if (args[0] == "-L") {
-                    if (args.size() < 2) {
-                        std::cerr << "Error: Library path required after -L\n";
-                        return 1;
-                    }
-                    entry.type = utils::DependencyEntry::LIBRARY_PATH;
-                    entry.value = args[1];
-                } else if (args[0] == "-l") {
-                    if (args.size() < 2) {
-                        std::cerr << "Error: Library name required after -l\n";
-                        return 1;
-                    }
-                    entry.type = utils::DependencyEntry::LIBRARY_NAME;
-                    entry.value = args[1];
-                } else if (args[0] == "-I") {
-                    if (args.size() < 2) {
-                        std::cerr << "Error: Include path required after -I\n";
-                        return 1;
-                    }
-                    entry.type = utils::DependencyEntry::INCLUDE_PATH;
-                    entry.value = args[1];
-                } else if (args[0] == "-T") {
-                    if (args.size() < 2) {
-                        std::cerr << "Error: Toolchain file path required after -T\n";
-                        return 1;
-                    }
-                    entry.type = utils::DependencyEntry::TOOLCHAIN_FILE;
-                    entry.value = args[1];
-                } else if (args[0] == "-A") {
-                    // Link override mapping: <pkg> or <pkg>:<component>=<customTarget>
-                    if (args.size() < 2) {
-                        std::cerr << "Error: Mapping required after -A. Example: -A glfw3=glfw or -A Qt6:Gui=Qt6::Gui\n";
-                        return 1;
-                    }
-                    entry.type = utils::DependencyEntry::LINK_OVERRIDE;
-                    entry.value = args[1];
-                } else {
-                    // Default: package or package with components
-                    std::string package_name = args[0];
-                    std::vector<std::string> components;
-                    
-                    // If provided as pkg:component, split and seed component list
-                    auto sep = package_name.find(':');
-                    if (sep != std::string::npos) {
-                        std::string pkg = package_name.substr(0, sep);
-                        std::string comp = package_name.substr(sep + 1);
-                        package_name = pkg;
-                        if (!comp.empty()) components.push_back(comp);
-                    }
-                    
-                    // Parse additional components via -c flags (repeatable)
-                    for (size_t i = 1; i < args.size(); ++i) {
-                        if (args[i] == "-c" && i + 1 < args.size()) {
-                            components.push_back(args[i + 1]);
-                            ++i;
+                for (const auto& entry : entries) {
+                    if (entry.type == utils::DependencyEntry::COMPILER_LAUNCHER &&
+                        (entry.value == "auto" || entry.value == "ccache" || entry.value == "sccache")) {
+                        const bool found = entry.value == "auto"
+                            ? (utils::find_program("ccache") || utils::find_program("sccache"))
+                            : utils::find_program(entry.value);
+                        if (!found) {
+                            std::cerr << "Warning: compiler cache '" << entry.value << "' not found on PATH; builds will run without it until it is installed\n";
                         }
                     }
                     
-                    if (!components.empty()) {
-                        // Add each component entry
-                        for (const auto& comp : components) {
-                            utils::DependencyEntry comp_entry;
-                            comp_entry.type = utils::DependencyEntry::PACKAGE_COMPONENT;
-                            comp_entry.value = package_name + ":" + comp;
-                            if (!utils::add_dependency(libname_path, comp_entry)) {
-                                std::cerr << "Failed to update .libname file\n";
-                                return 1;
-                            }
-                            std::cout << "Successfully added package component '" << comp_entry.value << "' to .libname\n";
-                        }
+                    const std::string type_name = utils::dependency_type_name(entry.type);
+                    // Only one launcher is used; a new one replaces the one set before
+                    if (entry.type == utils::DependencyEntry::COMPILER_LAUNCHER && !transaction.contains(entry)) {
+                        transaction.clear(utils::DependencyEntry::COMPILER_LAUNCHER);
+                    }
+                    if (transaction.add(entry)) {
+                        std::cout << "Successfully added " << type_name << " '" << entry.value << "' to .libname\n";
                     } else {
-                        // Add plain package entry
-                        utils::DependencyEntry pkg_entry;
-                        pkg_entry.type = utils::DependencyEntry::PACKAGE;
-                        pkg_entry.value = package_name;
-                        if (!utils::add_dependency(libname_path, pkg_entry)) {
-                            std::cerr << "Failed to update .libname file\n";
-                            return 1;
-                        }
-                        std::cout << "Successfully added package '" << pkg_entry.value << "' to .libname\n";
+                        std::cout << "The " << type_name << " '" << entry.value << "' is already in .libname\n";
                     }
-                    
-                    std::cout << "Note: Use 'ctc run' to automatically update your CMakeLists.txt.\n";
-                    return 0;
                 }
                 
-                // Add the dependency (non-package flags path)
-                if (!utils::add_dependency(libname_path, entry)) {
+                if (!transaction.commit()) {
                     std::cerr << "Failed to update .libname file\n";
                     return 1;
                 }
                 
-                std::string type_name;
-                switch (entry.type) {
-                    case utils::DependencyEntry::PACKAGE:
-                        type_name = "package";
-                        break;
-                    case utils::DependencyEntry::LIBRARY_PATH:
-                        type_name = "library path";
-                        break;
-                    case utils::DependencyEntry::LIBRARY_NAME:
-                        type_name = "library";
-                        break;
-                    case utils::DependencyEntry::INCLUDE_PATH:
-                        type_name = "include path";
-                        break;
-                    case utils::DependencyEntry::PACKAGE_COMPONENT:
-                        type_name = "package component";
-                        break;
-                    case utils::DependencyEntry::TOOLCHAIN_FILE:
-                        type_name = "toolchain file";
-                        break;
-                    case utils::DependencyEntry::LINK_OVERRIDE:
-                        type_name = "link override";
-                        break;
-                }
-                
-                std::cout << "Successfully added " << type_name << " '" << entry.value << "' to .libname\n";
                 std::cout << "Note: Use 'ctc run' to automatically update your CMakeLists.txt.\n";
-                
                 return 0;
                 
             } catch (const std::exception& e) {
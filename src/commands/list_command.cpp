@@ -30,7 +30,7 @@ namespace ctc {
                 std::cout << std::string(50, '=') << "\n";
                 
                 // Group dependencies by type for better display
-                std::vector<utils::DependencyEntry> packages, lib_paths, lib_names, inc_paths, toolchain_paths, pkg_components, link_overrides;
+                std::vector<utils::DependencyEntry> packages, lib_paths, lib_names, inc_paths, toolchain_paths, pkg_components, link_overrides, launchers, unity_settings, pch_headers, lto_modes, app_targets;
                 
                 for (const auto& dep : dependencies) {
                     switch (dep.type) {
@@ -55,6 +55,22 @@ namespace ctc {
                         case utils::DependencyEntry::LINK_OVERRIDE:
                             link_overrides.push_back(dep);
                             break;
+                        case utils::DependencyEntry::COMPILER_LAUNCHER:
+                            launchers.push_back(dep);
+                            break;
+                        case utils::DependencyEntry::UNITY_BUILD:
+                        case utils::DependencyEntry::UNITY_EXCLUDE:
+                            unity_settings.push_back(dep);
+                            break;
+                        case utils::DependencyEntry::PCH_HEADER:
+                            pch_headers.push_back(dep);
+                            break;
+                        case utils::DependencyEntry::LTO_MODE:
+                            lto_modes.push_back(dep);
+                            break;
+                        case utils::DependencyEntry::APP_TARGETS:
+                            app_targets.push_back(dep);
+                            break;
                     }
                 }
                 
@@ -114,6 +130,48 @@ namespace ctc {
                     }
                 }
                 
+                // Display compiler launcher
+                if (!launchers.empty()) {
+                    std::cout << "\n[COMPILER CACHE] CMAKE_<LANG>_COMPILER_LAUNCHER (-C):\n";
+                    for (const auto& launcher : launchers) {
+                        std::cout << "  * " << launcher.value << "\n";
+                    }
+                }
+                
+                // Display unity build settings
+                if (!unity_settings.empty()) {
+                    std::cout << "\n[UNITY BUILD] (--unity, --unity-exclude):\n";
+                    for (const auto& setting : unity_settings) {
+                        if (setting.type == utils::DependencyEntry::UNITY_BUILD) {
+                            std::cout << "  * batch size " << setting.value << "\n";
+                        } else {
+                            std::cout << "  * excluded: " << setting.value << "\n";
+                        }
+                    }
+                }
+                
+                // Display precompiled header
+                if (!pch_headers.empty()) {
+                    std::cout << "\n[PRECOMPILED HEADER] (ctc pch):\n";
+                    for (const auto& pch : pch_headers) {
+                        std::cout << "  * " << pch.value << "\n";
+                    }
+                }
+                
+                // Display link-time optimization
+                if (!lto_modes.empty()) {
+                    std::cout << "\n[LTO] Link-time optimization (--lto):\n";
+                    for (const auto& lto : lto_modes) {
+                        std::cout << "  * " << lto.value << "\n";
+                    }
+                }
+                
+                // Display the executable layout
+                if (!app_targets.empty()) {
+                    std::cout << "\n[APP TARGETS] One executable per app/<name>.cpp or app/<name>/ (--app-targets):\n";
+                    std::cout << "  * " << app_targets.front().value << "\n";
+                }
+                
                 std::cout << "\n" << std::string(50, '=') << "\n";
                 std::cout << "Total: " << dependencies.size() << " entries\n";
                 std::cout << "\nUse 'ctc run' to automatically apply these dependencies to your CMakeLists.txt\n";
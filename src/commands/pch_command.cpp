@@ -0,0 +1,136 @@
+#include "commands.h"
+#include "file_utils.h"
+#include "source_utils.h"
+#include <iostream>
+#include <filesystem>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace ctc {
+    namespace commands {
+        
+        int pch_command(const std::vector<std::string>& args) {
+            size_t top_count = 20; // Maximum number of headers placed in the PCH
+            size_t min_count = 2;  // Headers used by fewer files are not worth precompiling
+            bool disable = false;
+            
+            for (size_t i = 0; i < args.size(); ++i) {
+                if ((args[i] == "--top" || args[i] == "--min") && i + 1 < args.size()) {
+                    unsigned long long value = 0;
+                    if (!utils::parse_integer(args[i + 1], 0, 1000000, value)) {
+                        std::cerr << "Error: Invalid value '" << args[i + 1] << "' for " << args[i] << ". Expected an integer from 0 to 1000000\n";
+                        return 1;
+                    }
+                    (args[i] == "--top" ? top_count : min_count) = static_cast<size_t>(value);
+                    ++i;
+                } else if (args[i] == "--off") {
+                    disable = true;
+                }
+            }
+            
+            const std::filesystem::path libname_path = ".libname";
+            const std::filesystem::path pch_path = ".ctc/pch.h";
+            const std::filesystem::path cache_path = ".ctc/include_cache";
+            
+            if (!std::filesystem::exists(libname_path)) {
+                std::cerr << "Error: .libname file not found. Run 'ctc init' first.\n";
+                return 1;
+            }
+            
+            try {
+                if (disable) {
+                    if (!utils::apply_setting_changes(libname_path, {{utils::SettingChange::CLEAR, {utils::DependencyEntry::PCH_HEADER, ""}}})) {
+                        std::cerr << "Failed to update .libname file\n";
+                        return 1;
+                    }
+                    std::error_code ec;
+                    std::filesystem::remove(pch_path, ec);
+                    std::cout << "Precompiled header disabled.\n";
+                    std::cout << "Note: Use 'ctc apply' or 'ctc run -U' to update your CMakeLists.txt.\n";
+                    return 0;
+                }
+                
+                // 1. Scan the project (only new or changed files are parsed again)
+                size_t rescanned = 0;
+                const auto files = utils::list_project_files(utils::project_source_roots(), ".ctc/dir_snapshot");
+                auto includes = utils::scan_includes(files, cache_path, &rescanned);
+                std::cout << "Scanned " << includes.size() << " files (" << rescanned << " parsed, "
+                          << (includes.size() - rescanned) << " unchanged)\n";
+                
+                // 2. Count how many files include each system/third-party header.
+                // Angled includes that resolve to the project's own headers are skipped.
+                std::map<std::string, size_t> usage;
+                for (const auto& kv : includes) {
+                    std::set<std::string> seen;
+                    for (const auto& inc : kv.second) {
+                        if (!inc.angled || !seen.insert(inc.header).second) continue;
+                        std::error_code ec;
+                        if (std::filesystem::exists(std::filesystem::path("include") / inc.header, ec) ||
+                            std::filesystem::exists(std::filesystem::path("lib") / inc.header, ec)) {
+                            continue;
+                        }
+                        ++usage[inc.header];
+                    }
+                }
+                
+                std::vector<std::pair<std::string, size_t>> ranked;
+                for (const auto& kv : usage) {
+                    if (kv.second >= min_count) ranked.push_back(kv);
+                }
+                std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+                    return a.second != b.second ? a.second > b.second : a.first < b.first;
+                });
+                if (ranked.size() > top_count) {
+                    ranked.resize(top_count);
+                }
+                
+                if (ranked.empty()) {
+                    std::cout << "No system or third-party header is included by at least " << min_count << " files; no PCH generated.\n";
+                    // A PCH from an earlier run would otherwise stay in use with headers that no longer qualify
+                    bool had_pch = false;
+                    for (const auto& entry : utils::read_libname(libname_path)) {
+                        had_pch = had_pch || entry.type == utils::DependencyEntry::PCH_HEADER;
+                    }
+                    if (had_pch) {
+                        if (!utils::apply_setting_changes(libname_path, {{utils::SettingChange::CLEAR, {utils::DependencyEntry::PCH_HEADER, ""}}})) {
+                            std::cerr << "Failed to update .libname file\n";
+                            return 1;
+                        }
+                        std::error_code ec;
+                        std::filesystem::remove(pch_path, ec);
+                        std::cout << "The previous precompiled header was disabled.\n";
+                        std::cout << "Note: Use 'ctc apply' or 'ctc run -U' to update your CMakeLists.txt.\n";
+                    }
+                    return 0;
+                }
+                
+                // 3. Write the PCH header and record it in .libname
+                std::string content = "// Generated by 'ctc pch' - do not edit; run 'ctc pch' again to refresh.\n#pragma once\n\n";
+                for (const auto& kv : ranked) {
+                    content += "#include <" + kv.first + ">\n";
+                }
+                if (!utils::create_directory_if_not_exists(pch_path.parent_path()) || !utils::write_file(pch_path, content)) {
+                    std::cerr << "Failed to write " << pch_path.generic_string() << "\n";
+                    return 1;
+                }
+                if (!utils::apply_setting_changes(libname_path, {{utils::SettingChange::SET, {utils::DependencyEntry::PCH_HEADER, pch_path.generic_string()}}})) {
+                    std::cerr << "Failed to update .libname file\n";
+                    return 1;
+                }
+                
+                std::cout << "Precompiled header " << pch_path.generic_string() << " (" << ranked.size() << " headers):\n";
+                for (const auto& kv : ranked) {
+                    std::cout << "  " << std::setw(5) << kv.second << "  <" << kv.first << ">\n";
+                }
+                std::cout << "Note: Use 'ctc apply' or 'ctc run -U' to update your CMakeLists.txt.\n";
+                return 0;
+                
+            } catch (const std::exception& e) {
+                std::cerr << "Error generating precompiled header: " << e.what() << "\n";
+                return 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,219 @@
+#include "commands.h"
+#include "file_utils.h"
+#include "build_utils.h"
+#include "process_utils.h"
+#include <iostream>
+#include <filesystem>
+
+namespace ctc {
+    namespace commands {
+        
+        namespace {
+            // Compiler-specific profile flags. GCC names .gcda files after the object path, so both
+            // builds strip their own build directory with -fprofile-prefix-path to make the names match.
+            std::string instrument_flags(bool clang, const std::filesystem::path& profile_dir, const std::filesystem::path& build_dir) {
+                std::string flags = "-fprofile-generate=" + profile_dir.generic_string();
+                if (!clang) {
+                    flags += " -fprofile-update=prefer-atomic -fprofile-prefix-path=" + build_dir.generic_string();
+                }
+                return flags;
+            }
+            
+            std::string use_flags(bool clang, const std::filesystem::path& profile_dir, const std::filesystem::path& build_dir) {
+                if (clang) {
+                    return "-fprofile-use=" + (profile_dir / "merged.profdata").generic_string();
+                }
+                return "-fprofile-use=" + profile_dir.generic_string() + " -fprofile-prefix-path=" + build_dir.generic_string() +
+                       " -fprofile-partial-training -Wno-missing-profile";
+            }
+            
+            std::vector<std::string> flag_args(const std::string& flags) {
+                return {"-DCMAKE_C_FLAGS=" + flags, "-DCMAKE_CXX_FLAGS=" + flags,
+                        "-DCMAKE_EXE_LINKER_FLAGS=" + flags, "-DCMAKE_SHARED_LINKER_FLAGS=" + flags};
+            }
+            
+            // The training command as given, with bin/<file> (or ./bin/<file>) arguments pointing into bin_dir
+            std::vector<std::string> redirect_to_bin_dir(const std::vector<std::string>& command, const std::filesystem::path& bin_dir) {
+                std::vector<std::string> redirected;
+                for (const auto& arg : command) {
+                    const size_t prefix = arg.compare(0, 4, "bin/") == 0 ? 4 : arg.compare(0, 6, "./bin/") == 0 ? 6 : 0;
+                    redirected.push_back(prefix == 0 || arg.size() == prefix ? arg : (bin_dir / arg.substr(prefix)).string());
+                }
+                return redirected;
+            }
+            
+            bool has_files_with_extension(const std::filesystem::path& dir, const std::string& extension) {
+                std::error_code ec;
+                for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+                    if (entry.path().extension() == extension) return true;
+                }
+                return false;
+            }
+        }
+        
+        int pgo_command(const std::vector<std::string>& args) {
+            unsigned jobs = 0; // 0 = detect from usable cores
+            std::string requested_generator;
+            bool retrain = false;
+            std::vector<std::string> training_command;
+            
+            for (size_t i = 0; i < args.size(); ++i) {
+                if (args[i] == "--") {
+                    // Everything after -- is the training command
+                    training_command.assign(args.begin() + static_cast<long>(i) + 1, args.end());
+                    break;
+                } else if ((args[i] == "-j" || args[i] == "--jobs") && i + 1 < args.size()) {
+                    if (!utils::parse_job_count(args[i + 1], jobs)) {
+                        std::cerr << "Error: Invalid job count '" << args[i + 1] << "'. Expected an integer from 1 to " << utils::max_job_count << "\n";
+                        return 1;
+                    }
+                    ++i;
+                } else if ((args[i] == "-G" || args[i] == "--generator") && i + 1 < args.size()) {
+                    requested_generator = args[++i];
+                } else if (args[i] == "--retrain") {
+                    retrain = true;
+                } else {
+                    std::cerr << "Error: Unknown option '" << args[i] << "'\n";
+                    std::cerr << "Usage: ctc pgo [-j <jobs>] [-G <generator>] [--retrain] -- <training command>\n";
+                    return 1;
+                }
+            }
+            
+            if (training_command.empty()) {
+                std::cerr << "Error: Training command required\n";
+                std::cerr << "Usage: ctc pgo [-j <jobs>] [-G <generator>] [--retrain] -- <training command>\n";
+                std::cerr << "Example: ctc pgo -- ./bin/my_project --benchmark input.txt\n";
+                return 1;
+            }
+            if (!std::filesystem::exists("CMakeLists.txt")) {
+                std::cerr << "Error: CMakeLists.txt not found. Run 'ctc apply' or use 'ctc run -U' first.\n";
+                return 1;
+            }
+            if (jobs == 0) {
+                jobs = utils::detect_job_count();
+            }
+            
+            try {
+                // Profiles are keyed by the source fingerprint; profiles of other versions are stale
+                if (std::filesystem::exists("ctc_sources.cmake") && !utils::update_sources_manifest("ctc_sources.cmake")) {
+                    std::cerr << "Failed to update ctc_sources.cmake\n";
+                    return 1;
+                }
+                const std::string fingerprint = utils::compute_source_fingerprint();
+                const std::filesystem::path pgo_root = std::filesystem::absolute(".ctc/pgo");
+                const std::filesystem::path profile_dir = pgo_root / fingerprint;
+                const std::filesystem::path marker = profile_dir / "ctc_profile.ok";
+                std::error_code ec;
+                for (const auto& entry : std::filesystem::directory_iterator(pgo_root, ec)) {
+                    if (entry.path().filename() != fingerprint) {
+                        std::cout << "Removing stale profile " << entry.path().filename().string() << " (sources changed)\n";
+                        std::filesystem::remove_all(entry.path(), ec);
+                    }
+                }
+                
+                // The instrumented executable stays inside its tree, so bin/ never holds a binary that writes
+                // profiles wherever it is run
+                utils::BuildTreeOptions instrumented;
+                instrumented.build_dir = std::filesystem::absolute("build/pgo-instrument");
+                instrumented.output_dir = instrumented.build_dir / "bin";
+                instrumented.generator = requested_generator;
+                instrumented.jobs = jobs;
+                utils::BuildTreeOptions optimized = instrumented;
+                optimized.build_dir = std::filesystem::absolute("build/pgo-use");
+                optimized.output_dir = "bin";
+                
+                // The compiler decides the profile format; configure once to find out if it is not cached yet
+                if (!utils::prepare_build_tree(instrumented)) {
+                    return 1;
+                }
+                if (utils::read_cmake_cache_value(instrumented.build_dir, "CMAKE_CXX_COMPILER").empty() &&
+                    !utils::configure_build_tree(instrumented)) {
+                    return 1;
+                }
+                const std::string compiler = utils::read_cmake_cache_value(instrumented.build_dir, "CMAKE_CXX_COMPILER");
+                std::string version;
+                if (compiler.empty() || utils::capture_command_output({compiler, "--version"}, version) != 0) {
+                    std::cerr << "Error: Could not identify the C++ compiler of " << instrumented.build_dir.generic_string() << "\n";
+                    return 1;
+                }
+                const bool clang = version.find("clang") != std::string::npos;
+                if (!clang && version.find("Free Software Foundation") == std::string::npos) {
+                    std::cerr << "Error: PGO is supported with GCC and Clang only (compiler: " << compiler << ")\n";
+                    return 1;
+                }
+                const std::string compiler_id = clang ? "Clang" : "GNU";
+                
+                if (!retrain && utils::read_file(marker) == compiler_id + "\n") {
+                    std::cout << "[1/3] Reusing profile " << fingerprint << " (sources unchanged; use --retrain to train again)\n";
+                } else {
+                    // 1. Instrumented build
+                    std::cout << "[1/3] Building instrumented binary...\n";
+                    std::filesystem::remove_all(profile_dir, ec);
+                    if (!utils::create_directory_if_not_exists(profile_dir)) {
+                        std::cerr << "Failed to create " << profile_dir.generic_string() << "\n";
+                        return 1;
+                    }
+                    instrumented.cmake_args = flag_args(instrument_flags(clang, profile_dir, instrumented.build_dir));
+                    if (!utils::configure_build_tree(instrumented) || !utils::build_build_tree(instrumented)) {
+                        return 1;
+                    }
+                    
+                    // 2. Training run, against the instrumented executables: bin/ in its arguments is redirected, and
+                    // CTC_PGO_BIN_DIR names their directory for scripts. CMakeLists.txt files generated before
+                    // CTC_BIN_DIR existed always build into bin/.
+                    const std::filesystem::path bin_dir = utils::read_file("CMakeLists.txt").find("CTC_BIN_DIR") != std::string::npos
+                                                              ? instrumented.output_dir : std::filesystem::absolute("bin");
+                    const std::vector<std::string> command = redirect_to_bin_dir(training_command, bin_dir);
+                    utils::ProcessOptions training_options;
+                    training_options.stdin_mode = utils::InputMode::inherit;
+                    training_options.environment = {"CTC_PGO_BIN_DIR=" + bin_dir.string()};
+                    std::cout << "[2/3] Running training command: " << utils::format_command_line(command) << "\n";
+                    const utils::ProcessResult training = utils::run_process(command, training_options);
+                    if (!training.succeeded()) {
+                        std::cerr << "Training command failed (" << training.describe() << ")\n";
+                        return 1;
+                    }
+                    
+                    // Clang writes raw profiles that must be merged; GCC accumulates .gcda files in place
+                    if (clang) {
+                        std::filesystem::path profdata;
+                        if (!utils::find_program("llvm-profdata", &profdata)) {
+                            std::cerr << "Error: llvm-profdata not found on PATH\n";
+                            return 1;
+                        }
+                        std::vector<std::string> merge_command = {profdata.string(), "merge", "-output=" + (profile_dir / "merged.profdata").string()};
+                        for (const auto& entry : std::filesystem::directory_iterator(profile_dir)) {
+                            if (entry.path().extension() == ".profraw") {
+                                merge_command.push_back(entry.path().string());
+                            }
+                        }
+                        std::cout << "Merging profiles with llvm-profdata...\n";
+                        if (!has_files_with_extension(profile_dir, ".profraw") || !utils::run_process(merge_command).succeeded()) {
+                            std::cerr << "Error: No usable profile data was produced by the training command\n";
+                            return 1;
+                        }
+                    } else if (!has_files_with_extension(profile_dir, ".gcda")) {
+                        std::cerr << "Error: No profile data (.gcda) was produced by the training command\n";
+                        return 1;
+                    }
+                    utils::write_file(marker, compiler_id + "\n");
+                }
+                
+                // 3. Optimized build with the profile, written to bin/
+                std::cout << "[3/3] Building profile-optimized binary...\n";
+                optimized.cmake_args = flag_args(use_flags(clang, profile_dir, optimized.build_dir));
+                if (!utils::prepare_build_tree(optimized) || !utils::configure_build_tree(optimized) || !utils::build_build_tree(optimized)) {
+                    return 1;
+                }
+                
+                std::cout << "PGO build completed successfully!\n";
+                std::cout << "Profile-optimized executable(s) are now available in the bin/ directory.\n";
+                return 0;
+                
+            } catch (const std::exception& e) {
+                std::cerr << "Error during PGO build: " << e.what() << "\n";
+                return 1;
+            }
+        }
+    }
+}
@@ -0,0 +1,167 @@
+#include "commands.h"
+#include "file_utils.h"
+#include "build_utils.h"
+#include "profile_utils.h"
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+
+namespace ctc {
+    namespace commands {
+        
+        int profile_command(const std::vector<std::string>& args) {
+            unsigned jobs = 0; // 0 = detect from usable cores
+            std::string requested_generator;
+            unsigned frequency = 999; // samples per second of CPU time; odd to avoid lockstep with timers
+            std::string app_target; // executable of the per-target layout (-t); empty: the project's executable
+            std::vector<std::string> program_args;
+            
+            for (size_t i = 0; i < args.size(); ++i) {
+                if (args[i] == "--") {
+                    program_args.assign(args.begin() + static_cast<long>(i) + 1, args.end());
+                    break;
+                } else if ((args[i] == "-j" || args[i] == "--jobs") && i + 1 < args.size()) {
+                    if (!utils::parse_job_count(args[i + 1], jobs)) {
+                        std::cerr << "Error: Invalid job count '" << args[i + 1] << "'. Expected an integer from 1 to " << utils::max_job_count << "\n";
+                        return 1;
+                    }
+                    ++i;
+                } else if ((args[i] == "-G" || args[i] == "--generator") && i + 1 < args.size()) {
+                    requested_generator = args[++i];
+                } else if ((args[i] == "-t" || args[i] == "--target") && i + 1 < args.size()) {
+                    app_target = args[++i];
+                } else if ((args[i] == "-F" || args[i] == "--frequency") && i + 1 < args.size()) {
+                    unsigned long long value = 0;
+                    if (!utils::parse_integer(args[i + 1], 1, 1000000, value)) {
+                        std::cerr << "Error: Invalid sampling frequency '" << args[i + 1] << "'. Expected an integer from 1 to 1000000 (Hz)\n";
+                        return 1;
+                    }
+                    frequency = static_cast<unsigned>(value);
+                    ++i;
+                } else {
+                    std::cerr << "Error: Unknown option '" << args[i] << "'\n";
+                    std::cerr << "Usage: ctc profile [-j <jobs>] [-G <generator>] [-F <hz>] [-t <target>] [-- <program arguments>]\n";
+                    return 1;
+                }
+            }
+            
+            if (!std::filesystem::exists("CMakeLists.txt")) {
+                std::cerr << "Error: CMakeLists.txt not found. Run 'ctc apply' or use 'ctc run -U' first.\n";
+                return 1;
+            }
+            // With the per-target layout there is no bin/<project name>; -t picks the executable
+            std::string target_error;
+            if (app_target.empty() && utils::app_targets_enabled()) {
+                std::cerr << "Error: This project builds one executable per app/ target; choose one with -t <target>\n";
+                return 1;
+            }
+            if (!app_target.empty() && !utils::check_app_target(app_target, target_error)) {
+                std::cerr << "Error: " << target_error << "\n";
+                return 1;
+            }
+            if (jobs == 0) {
+                jobs = utils::detect_job_count();
+            }
+            
+            try {
+                if (std::filesystem::exists("ctc_sources.cmake") && !utils::update_sources_manifest("ctc_sources.cmake")) {
+                    std::cerr << "Failed to update ctc_sources.cmake\n";
+                    return 1;
+                }
+                
+                // 1. Profiling build in its own tree: optimized, with debug info and frame pointers so the
+                // kernel can unwind user stacks. The executable stays inside the tree, so the one in bin/ is
+                // still the Release build of 'ctc run'.
+                utils::BuildTreeOptions tree;
+                tree.build_dir = std::filesystem::path("build") / "profile";
+                tree.output_dir = tree.build_dir / "bin";
+                tree.build_mode = "RelWithDebInfo"; // -O2 -g
+                tree.generator = requested_generator;
+                tree.jobs = jobs;
+                // Leaf functions may drop the frame pointer even with -fno-omit-frame-pointer, which hides
+                // their caller; x86 and AArch64 compilers can be told to keep it
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+                const std::string frame_flags = "-fno-omit-frame-pointer -mno-omit-leaf-frame-pointer";
+#else
+                const std::string frame_flags = "-fno-omit-frame-pointer";
+#endif
+                tree.cmake_args = {"-DCMAKE_C_FLAGS=" + frame_flags, "-DCMAKE_CXX_FLAGS=" + frame_flags};
+                if (!utils::prepare_build_tree(tree) || !utils::configure_build_tree(tree)) {
+                    return 1;
+                }
+                const std::string project_name = utils::read_cmake_cache_value(tree.build_dir, "CMAKE_PROJECT_NAME");
+                if (!app_target.empty()) {
+                    tree.target = project_name + "_app_" + app_target;
+                }
+                if (!utils::build_build_tree(tree)) {
+                    return 1;
+                }
+                // CMakeLists.txt files generated before CTC_BIN_DIR existed always build into bin/
+                const std::string executable_name = app_target.empty() ? project_name : app_target;
+                std::filesystem::path executable = tree.output_dir / executable_name;
+                if (!std::filesystem::exists(executable)) {
+                    executable = std::filesystem::path("bin") / executable_name;
+                }
+                if (executable_name.empty() || !std::filesystem::exists(executable)) {
+                    std::cerr << "Error: Executable " << (tree.output_dir / executable_name).generic_string() << " not found\n";
+                    return 1;
+                }
+                
+                // 2. Run and sample it
+                std::vector<std::string> command = {std::filesystem::absolute(executable).string()};
+                command.insert(command.end(), program_args.begin(), program_args.end());
+                std::cout << "Profiling " << executable.generic_string() << " at " << frequency << " Hz...\n" << std::flush;
+                utils::SamplingResult result;
+                std::string error;
+                if (!utils::sample_process(command, frequency, result, error)) {
+                    std::cerr << "Error: Cannot sample the program: " << error << "\n";
+                    return 1;
+                }
+                if (result.exit_status != 0) {
+                    std::cout << "Note: the program exited with status " << result.exit_status << "\n";
+                }
+                std::cout << "Collected " << result.samples << " samples";
+                if (result.lost > 0) std::cout << " (" << result.lost << " lost)";
+                std::cout << "\n";
+                if (result.samples == 0) {
+                    std::cerr << "No samples were taken; the program ran too briefly. Give it more work or raise -F.\n";
+                    return 1;
+                }
+                
+                // 3. Folded stacks and flame graph
+                if (!utils::create_directory_if_not_exists(".ctc/profile")) {
+                    std::cerr << "Failed to create .ctc/profile\n";
+                    return 1;
+                }
+                const std::filesystem::path folded_path = std::filesystem::path(".ctc/profile") / (executable_name + ".folded");
+                const std::filesystem::path svg_path = std::filesystem::path(".ctc/profile") / (executable_name + ".svg");
+                if (!utils::write_file(folded_path, utils::format_folded_stacks(result.stacks)) ||
+                    !utils::write_file(svg_path, utils::render_flamegraph_svg(result.stacks, executable_name + " (" + std::to_string(result.samples) + " samples)"))) {
+                    std::cerr << "Failed to write the profile\n";
+                    return 1;
+                }
+                
+                // Functions with the most samples of their own (leaf frames)
+                std::map<std::string, unsigned long long> self;
+                for (const auto& entry : result.stacks) {
+                    self[entry.first.substr(entry.first.rfind(';') + 1)] += entry.second;
+                }
+                std::vector<std::pair<std::string, unsigned long long>> hottest(self.begin(), self.end());
+                std::sort(hottest.begin(), hottest.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+                std::cout << "\nHottest functions (self time):\n";
+                for (size_t i = 0; i < hottest.size() && i < 10; ++i) {
+                    std::cout << std::setw(7) << std::fixed << std::setprecision(1) << 100.0 * static_cast<double>(hottest[i].second) / static_cast<double>(result.samples)
+                              << "%  " << hottest[i].first << "\n";
+                }
+                std::cout << "\nFolded stacks: " << folded_path.generic_string() << "\n";
+                std::cout << "Flame graph:   " << svg_path.generic_string() << "\n";
+                return 0;
+                
+            } catch (const std::exception& e) {
+                std::cerr << "Error during profiling: " << e.what() << "\n";
+                return 1;
+            }
+        }
+    }
+}
@@ -1,45 +1,240 @@
 #include "commands.h"
 #include "file_utils.h"
+#include "build_utils.h"
+#include "artifact_utils.h"
+#include "timing_utils.h"
 #include <iostream>
 #include <filesystem>
 #include <cstdlib>
 #include <sstream>
+#include <algorithm>
+#include <thread>
 
 namespace ctc {
     namespace commands {
         
+        namespace {
+            // One build mode of a run: its build tree and what happened while building it
+            struct ModeBuild {
+                utils::BuildTreeOptions tree;
+                bool timings = false;
+                bool report_cache = false;  // the run builds a single mode, so the cache counters are its own
+                std::string app_target;     // executable of the per-target layout to build (-t); empty builds all
+                std::vector<utils::TimingEvent> phases;
+                std::vector<utils::TimingEvent> steps;
+                bool succeeded = false;
+            };
+            
+            // Compiler cache a configured tree uses, if any
+            std::filesystem::path compiler_cache_launcher(const std::filesystem::path& build_dir) {
+                const std::filesystem::path launcher = utils::read_cmake_cache_value(build_dir, "CTC_COMPILER_LAUNCHER");
+                if (launcher.empty() || launcher.filename() == "CTC_COMPILER_LAUNCHER-NOTFOUND") {
+                    return {};
+                }
+                return launcher;
+            }
+            
+            void print_cache_stats(const std::filesystem::path& launcher, const utils::CompilerCacheStats& before) {
+                utils::CompilerCacheStats after = utils::read_compiler_cache_stats(launcher);
+                if (!before.valid || !after.valid) {
+                    return;
+                }
+                unsigned long long hits = after.hits - before.hits;
+                unsigned long long misses = after.misses - before.misses;
+                std::cout << "Compiler cache (" << launcher.filename().string() << "): " << hits << " hits, " << misses << " misses";
+                if (hits + misses > 0) {
+                    std::cout << " (" << (100 * hits / (hits + misses)) << "% hit rate)";
+                }
+                std::cout << "\n";
+            }
+            
+            // Steps 4-7 for one mode: prepare the tree, configure, build and publish the executables
+            void build_mode(ModeBuild& build, bool several_modes) {
+                utils::BuildTreeOptions& tree = build.tree;
+                const std::filesystem::path& build_dir = tree.build_dir;
+                const std::string phase_suffix = several_modes ? " (" + tree.build_mode + ")" : "";
+                long long phase_start = utils::wall_clock_us();
+                auto end_phase = [&](const std::string& name) {
+                    const long long now = utils::wall_clock_us();
+                    utils::TimingEvent phase;
+                    phase.name = name + phase_suffix;
+                    phase.category = "phase";
+                    phase.start_us = phase_start;
+                    phase.duration_us = now - phase_start;
+                    build.phases.push_back(phase);
+                    phase_start = now;
+                };
+                
+                // 4. Prepare the per-mode build tree (kept between runs for incremental builds)
+                if (!utils::prepare_build_tree(tree)) {
+                    return;
+                }
+                
+                // --timings hooks into the tree through CMAKE_PROJECT_INCLUDE: Ninja already logs every
+                // step, other generators run compile and link steps through `ctc __time-compile`.
+                // Once a tree has been timed the include stays and is emptied instead, so turning
+                // timings on or off costs exactly one configure.
+                const bool use_ninja_log = utils::select_generator(build_dir, tree.generator) == "Ninja";
+                const std::filesystem::path timing_include = std::filesystem::absolute(build_dir / "ctc_timings.cmake");
+                if (build.timings || utils::read_cmake_cache_value(build_dir, "CMAKE_PROJECT_INCLUDE") == timing_include.generic_string()) {
+                    bool include_changed = false;
+                    if (utils::write_timing_project_include(build_dir, build.timings, use_ninja_log, &include_changed).empty()) {
+                        utils::print_build_message(tree, "Failed to write " + timing_include.generic_string(), true);
+                        return;
+                    }
+                    tree.cmake_args.push_back("-DCMAKE_PROJECT_INCLUDE=" + timing_include.generic_string());
+                    tree.force_configure = tree.force_configure || include_changed;
+                }
+                
+                // 5. Configure (skipped when the configure inputs are unchanged)
+                if (!utils::configure_build_tree(tree)) {
+                    return;
+                }
+                end_phase("configure");
+                
+                // -t: build that executable and the libraries it links, nothing else
+                if (!build.app_target.empty()) {
+                    tree.target = utils::read_cmake_cache_value(build_dir, "CMAKE_PROJECT_NAME") + "_app_" + build.app_target;
+                }
+                
+                // Snapshot compiler cache counters so the build's own hits/misses can be reported
+                const std::filesystem::path launcher = build.report_cache ? compiler_cache_launcher(build_dir) : std::filesystem::path();
+                utils::CompilerCacheStats cache_before;
+                if (!launcher.empty()) {
+                    cache_before = utils::read_compiler_cache_stats(launcher);
+                }
+                
+                std::error_code ec;
+                std::set<std::string> ninja_log_before;
+                if (build.timings) {
+                    std::filesystem::remove(utils::timing_log_path(build_dir), ec);
+                    if (use_ninja_log) ninja_log_before = utils::read_ninja_log_entries(build_dir);
+                }
+                const long long build_start = utils::wall_clock_us();
+                
+                // 6. Execute the build (cmake --build for cross-platform compatibility)
+                if (!utils::build_build_tree(tree)) {
+                    return;
+                }
+                end_phase("build");
+                
+                // 7. Publish the executables to the output directory if they are not already there
+                // (the CMakeLists.txt template builds them straight into CTC_BIN_DIR)
+                const std::filesystem::path& bin_dir = tree.output_dir;
+                const std::filesystem::path artifact_dir = std::filesystem::exists(build_dir / "bin") ? build_dir / "bin" : build_dir;
+                for (const auto& artifact : utils::publish_executables(artifact_dir, bin_dir, build_dir / "ctc_published.txt")) {
+                    const std::string name = "\"" + artifact.source.filename().string() + "\"";
+                    if (!artifact.succeeded) {
+                        utils::print_build_message(tree, "Warning: could not publish " + name + " to " + bin_dir.generic_string() + "/: " + artifact.error, true);
+                    } else if (artifact.method == utils::PublishMethod::unchanged) {
+                        utils::print_build_message(tree, name + " in " + bin_dir.generic_string() + "/ is up to date");
+                    } else {
+                        utils::print_build_message(tree, "Published " + name + " to " + bin_dir.generic_string() + "/ (" + utils::publish_method_name(artifact.method) + ")");
+                    }
+                }
+                
+                end_phase("publish");
+                
+                if (cache_before.valid) {
+                    print_cache_stats(launcher, cache_before);
+                }
+                if (build.timings) {
+                    build.steps = utils::read_step_timings(build_dir, use_ninja_log, ninja_log_before, build_start);
+                    for (auto& step : build.steps) {
+                        if (several_modes) step.detail += (step.detail.empty() ? "" : ", ") + tree.build_mode;
+                    }
+                }
+                utils::print_build_message(tree, "Build tree kept at " + build_dir.generic_string() + " for incremental rebuilds (use --clean to start fresh).");
+                build.succeeded = true;
+            }
+        }
+        
         int run_command(const std::vector<std::string>& args) {
             std::string project_name = "my_project"; // Default name
-            std::string build_mode = "Release"; // Default to Release mode
-            bool keep_build_directory = false; // Default to cleanup after build
+            std::vector<std::string> build_modes = {"Release"}; // Default to Release mode
+            bool clean_build = false; // Default: reuse the existing build tree
+            bool force_configure = false; // Default: skip configure when its inputs are unchanged
             bool update_cmake = false; // Default: do not update CMakeLists.txt
+            unsigned jobs = 0; // 0 = detect from usable cores
+            std::string requested_generator; // Empty: keep the tree's generator or prefer Ninja
+            std::vector<utils::SettingChange> setting_changes; // --unity etc., persisted in .libname
+            bool timings = false; // Default: no timing report
+            std::string app_target; // Default: build every executable
             
             // Parse arguments for -n and -m flags
             for (size_t i = 0; i < args.size(); ++i) {
-                if (args[i] == "-n" && i + 1 < args.size()) {
+                std::string error;
+                if (utils::parse_setting_option(args, i, setting_changes, error)) {
+                    if (!error.empty()) {
+                        std::cerr << "Error: " << error << "\n";
+                        return 1;
+                    }
+                    // Settings only take effect through the managed CMake section
+                    update_cmake = true;
+                } else if (args[i] == "-n" && i + 1 < args.size()) {
                     project_name = args[i + 1];
                 } else if (args[i] == "-m" && i + 1 < args.size()) {
-                    std::string mode = args[i + 1];
-                    // Validate build mode
-                    if (mode == "Debug" || mode == "Release" || mode == "MinSizeRel" || mode == "RelWithDebInfo") {
-                        build_mode = mode;
-                    } else {
-                        std::cerr << "Error: Invalid build mode '" << mode << "'. Valid modes are: Debug, Release, MinSizeRel, RelWithDebInfo\n";
+                    // One mode, or several separated by commas (built concurrently)
+                    build_modes.clear();
+                    std::istringstream modes(args[i + 1]);
+                    std::string mode;
+                    while (std::getline(modes, mode, ',')) {
+                        // Validate build mode
+                        if (mode != "Debug" && mode != "Release" && mode != "MinSizeRel" && mode != "RelWithDebInfo") {
+                            std::cerr << "Error: Invalid build mode '" << mode << "'. Valid modes are: Debug, Release, MinSizeRel, RelWithDebInfo\n";
+                            return 1;
+                        }
+                        if (std::find(build_modes.begin(), build_modes.end(), mode) == build_modes.end()) {
+                            build_modes.push_back(mode);
+                        }
+                    }
+                    if (build_modes.empty()) {
+                        std::cerr << "Error: No build mode given to -m\n";
                         return 1;
                     }
                 } else if (args[i] == "-k" || args[i] == "--keep-build") {
-                    keep_build_directory = true;
+                    // Build trees are always kept now; accepted for compatibility
+                } else if (args[i] == "--clean") {
+                    clean_build = true;
+                } else if (args[i] == "--reconfigure") {
+                    force_configure = true;
+                } else if ((args[i] == "-j" || args[i] == "--jobs") && i + 1 < args.size()) {
+                    if (!utils::parse_job_count(args[i + 1], jobs)) {
+                        std::cerr << "Error: Invalid job count '" << args[i + 1] << "'. Expected an integer from 1 to " << utils::max_job_count << "\n";
+                        return 1;
+                    }
+                } else if ((args[i] == "-G" || args[i] == "--generator") && i + 1 < args.size()) {
+                    requested_generator = args[i + 1];
                 } else if (args[i] == "-U" || args[i] == "--update-cmake") {
                     update_cmake = true;
+                } else if (args[i] == "--timings") {
+                    timings = true;
+                } else if ((args[i] == "-t" || args[i] == "--target") && i + 1 < args.size()) {
+                    app_target = args[i + 1];
                 }
             }
-            const std::filesystem::path current_dir = std::filesystem::current_path();
-            const std::filesystem::path build_dir = "build";
+            const bool several_modes = build_modes.size() > 1;
             const std::filesystem::path bin_dir = "bin";
             const std::filesystem::path libname_path = ".libname";
             const std::filesystem::path cmake_path = "CMakeLists.txt";
+            const std::filesystem::path manifest_path = "ctc_sources.cmake";
+            
+            std::string mode_list;
+            for (const auto& mode : build_modes) {
+                mode_list += (mode_list.empty() ? "" : ", ") + mode;
+            }
+            std::cout << "Starting build process in " << mode_list << " mode" << (several_modes ? "s" : "") << "...\n";
+            if (jobs == 0) {
+                std::string detail;
+                jobs = utils::detect_job_count(&detail);
+                std::cout << "Using " << jobs << " parallel jobs (detected from " << detail << ")\n";
+            } else {
+                std::cout << "Using " << jobs << " parallel jobs (-j)\n";
+            }
             
-            std::cout << "Starting build process in " << build_mode << " mode...\n";
+            // Wall time of each phase, reported with --timings
+            std::vector<utils::TimingEvent> phases;
+            const long long update_start = utils::wall_clock_us();
             
             try {
                 // 1. Optionally update CMakeLists.txt from .libname
@@ -48,14 +243,19 @@ namespace ctc {
                         std::cerr << "Error: .libname file not found. Run 'ctc init' first.\n";
                         return 1;
                     }
+                    if (!setting_changes.empty() && !utils::apply_setting_changes(libname_path, setting_changes)) {
+                        std::cerr << "Failed to update .libname file\n";
+                        return 1;
+                    }
                     std::cout << "Reading dependencies from .libname...\n";
                     std::vector<utils::DependencyEntry> dependencies = utils::read_libname(libname_path);
                     std::cout << "Updating CMakeLists.txt with project name '" << project_name << "' and dependencies...\n";
-                    if (!utils::update_cmake_file(cmake_path, project_name, dependencies)) {
+                    bool cmake_changed = false;
+                    if (!utils::update_cmake_file(cmake_path, project_name, dependencies, &cmake_changed)) {
                         std::cerr << "Failed to update CMakeLists.txt\n";
                         return 1;
                     }
-                    std::cout << "CMakeLists.txt updated successfully.\n";
+                    std::cout << (cmake_changed ? "CMakeLists.txt updated successfully.\n" : "CMakeLists.txt is already up to date.\n");
                 } else {
                     if (!std::filesystem::exists(cmake_path)) {
                         std::cerr << "Error: CMakeLists.txt not found. Run 'ctc apply' or use 'ctc run -U' first.\n";
@@ -63,117 +263,135 @@ namespace ctc {
                     }
                 }
                 
-                // 3. Create bin directory if it doesn't exist
-                if (!utils::create_directory_if_not_exists(bin_dir)) {
-                    std::cerr << "Failed to create bin directory\n";
-                    return 1;
-                }
-                
-                // 4. Create build directory
-                std::error_code ec;
-                if (std::filesystem::exists(build_dir, ec)) {
-                    std::cout << "Removing existing build directory...\n";
-                    std::filesystem::remove_all(build_dir, ec);
-                    if (ec) {
-                        std::cerr << "Warning: Failed to remove existing build directory: " << ec.message() << "\n";
+                // 2. Refresh the explicit source lists of ctc-managed projects; the manifest is only
+                // rewritten (and CMake only reconfigures) when files were added, removed or re-grouped
+                if (!update_cmake && std::filesystem::exists(manifest_path)) {
+                    bool manifest_changed = false;
+                    if (!utils::update_sources_manifest(manifest_path, &manifest_changed)) {
+                        std::cerr << "Failed to update " << manifest_path.generic_string() << "\n";
+                        return 1;
+                    }
+                    if (manifest_changed) {
+                        std::cout << "Source list changed; updated " << manifest_path.generic_string() << "\n";
                     }
                 }
                 
-                if (!utils::create_directory_if_not_exists(build_dir)) {
-                    std::cerr << "Failed to create build directory\n";
+                // -t needs the per-target layout, and a target of that name
+                std::string target_error;
+                if (!app_target.empty() && !utils::check_app_target(app_target, target_error)) {
+                    std::cerr << "Error: " << target_error << "\n";
                     return 1;
                 }
-                std::cout << "Created build directory\n";
                 
-                // 5. Move to build directory
-                std::filesystem::current_path(build_dir, ec);
-                if (ec) {
-                    std::cerr << "Failed to change to build directory: " << ec.message() << "\n";
+                // 3. Create the output directories: bin/, or bin/<mode> for each of several modes
+                if (several_modes && utils::read_file(cmake_path).find("CTC_BIN_DIR") == std::string::npos) {
+                    std::cerr << "Error: CMakeLists.txt predates per-mode output directories. Run 'ctc apply' or add -U to regenerate it.\n";
                     return 1;
                 }
-                std::cout << "Changed to build directory\n";
-                
-                // 6. Execute cmake with build mode (CMAKE_TOOLCHAIN_FILE is embedded in CMakeLists if specified)
-                std::cout << "Running cmake with build mode " << build_mode << "...\n";
-                std::string cmake_command = "cmake -DCMAKE_BUILD_TYPE=" + build_mode + " ..";
-                int cmake_result = std::system(cmake_command.c_str());
-                if (cmake_result != 0) {
-                    std::cerr << "CMake configuration failed\n";
-                    std::filesystem::current_path(current_dir);
-                    return 1;
+                std::vector<ModeBuild> builds(build_modes.size());
+                for (size_t i = 0; i < build_modes.size(); ++i) {
+                    utils::BuildTreeOptions& tree = builds[i].tree;
+                    tree.build_dir = std::filesystem::path("build") / build_modes[i];
+                    tree.build_mode = build_modes[i];
+                    tree.generator = requested_generator;
+                    tree.jobs = jobs;
+                    tree.clean = clean_build;
+                    tree.force_configure = force_configure;
+                    tree.output_dir = several_modes ? bin_dir / build_modes[i] : bin_dir;
+                    tree.log_prefix = several_modes ? "[" + build_modes[i] + "] " : "";
+                    builds[i].timings = timings;
+                    builds[i].report_cache = !several_modes;
+                    builds[i].app_target = app_target;
+                    if (!utils::create_directory_if_not_exists(tree.output_dir)) {
+                        std::cerr << "Failed to create " << tree.output_dir.generic_string() << " directory\n";
+                        return 1;
+                    }
                 }
+                phases.push_back({"update", "phase", "", "", update_start, utils::wall_clock_us() - update_start});
                 
-                // 7. Execute make (or cmake --build for cross-platform compatibility)
-                std::cout << "Building project in " << build_mode << " mode...\n";
-                std::string build_command = "cmake --build . --config " + build_mode;
-                int build_result = std::system(build_command.c_str());
-                if (build_result != 0) {
-                    std::cerr << "Build failed\n";
-                    std::filesystem::current_path(current_dir);
-                    return 1;
+                if (!several_modes) {
+                    build_mode(builds[0], false);
+                } else {
+                    // Configure and build every mode at once. The modes share the job count through a
+                    // jobserver; builds whose tool cannot join one get an equal share of the jobs instead.
+                    utils::Jobserver jobserver;
+                    const unsigned share = std::max(1u, jobs / static_cast<unsigned>(builds.size()));
+                    const unsigned tokens = jobs > builds.size() ? jobs - static_cast<unsigned>(builds.size()) : 0;
+                    if (utils::create_directory_if_not_exists("build") && utils::create_jobserver(jobserver, "build/.ctc-jobserver", tokens)) {
+                        std::cout << "Sharing " << jobs << " jobs between the modes through a jobserver\n";
+                    } else {
+                        std::cout << "Building each mode with " << share << " jobs\n";
+                    }
+                    
+                    // With several trees there is no single "before" for the cache counters; use the trees'
+                    // launcher from earlier runs and report one total
+                    std::filesystem::path launcher;
+                    for (const auto& build : builds) {
+                        if (launcher.empty()) launcher = compiler_cache_launcher(build.tree.build_dir);
+                    }
+                    const utils::CompilerCacheStats cache_before = launcher.empty() ? utils::CompilerCacheStats() : utils::read_compiler_cache_stats(launcher);
+                    
+                    std::vector<std::thread> threads;
+                    for (auto& build : builds) {
+                        build.tree.jobs = share;
+                        build.tree.jobserver = jobserver.read_fd >= 0 ? &jobserver : nullptr;
+                        threads.emplace_back([&build]() {
+                            try {
+                                build_mode(build, true);
+                            } catch (const std::exception& e) {
+                                utils::print_build_message(build.tree, std::string("Error during build: ") + e.what(), true);
+                            }
+                        });
+                    }
+                    for (auto& thread : threads) {
+                        thread.join();
+                    }
+                    utils::close_jobserver(jobserver);
+                    if (cache_before.valid) {
+                        print_cache_stats(launcher, cache_before);
+                    }
                 }
                 
-                // 8. Move back to original directory
-                std::filesystem::current_path(current_dir, ec);
-                if (ec) {
-                    std::cerr << "Warning: Failed to return to original directory: " << ec.message() << "\n";
+                std::vector<utils::TimingEvent> steps;
+                std::vector<std::string> failed;
+                for (const auto& build : builds) {
+                    phases.insert(phases.end(), build.phases.begin(), build.phases.end());
+                    steps.insert(steps.end(), build.steps.begin(), build.steps.end());
+                    if (!build.succeeded) failed.push_back(build.tree.build_mode);
                 }
-                
-                // 9. Copy executable to bin directory if it's not already there
-                // The CMakeLists.txt template should handle this, but let's check
-                if (std::filesystem::exists("build/bin")) {
-                    std::cout << "Copying executables to bin directory...\n";
-                    for (const auto& entry : std::filesystem::directory_iterator("build/bin")) {
-                        if (entry.is_regular_file()) {
-                            std::filesystem::path dest = bin_dir / entry.path().filename();
-                            std::filesystem::copy_file(entry.path(), dest, 
-                                std::filesystem::copy_options::overwrite_existing, ec);
-                            if (!ec) {
-                                std::cout << "Copied " << entry.path().filename() << " to bin/\n";
-                            }
-                        }
-                    }
-                } else {
-                    // Look for executables in the build directory
-                    for (const auto& entry : std::filesystem::directory_iterator("build")) {
-                        if (entry.is_regular_file()) {
-                            auto path = entry.path();
-                            // Check if it's an executable (no extension on Unix, .exe on Windows)
-                            if (!path.has_extension() || path.extension() == ".exe") {
-                                std::filesystem::path dest = bin_dir / path.filename();
-                                std::filesystem::copy_file(path, dest, 
-                                    std::filesystem::copy_options::overwrite_existing, ec);
-                                if (!ec) {
-                                    std::cout << "Copied " << path.filename() << " to bin/\n";
-                                }
-                            }
-                        }
+                if (!failed.empty()) {
+                    if (several_modes) {
+                        std::cerr << "Build failed for:";
+                        for (const auto& mode : failed) std::cerr << " " << mode;
+                        std::cerr << "\n";
                     }
+                    return 1;
                 }
                 
-                // 10. Optionally delete build directory
-                if (!keep_build_directory) {
-                    std::cout << "Cleaning up build directory...\n";
-                    std::filesystem::remove_all(build_dir, ec);
-                    if (ec) {
-                        std::cerr << "Warning: Failed to remove build directory: " << ec.message() << "\n";
-                    } else {
-                        std::cout << "Build directory cleaned up\n";
+                if (timings) {
+                    utils::print_timing_report(phases, steps, utils::collect_template_costs(steps), 15);
+                    const std::filesystem::path trace_path = ".ctc/timings.json";
+                    if (utils::create_directory_if_not_exists(".ctc") && utils::write_chrome_trace(trace_path, phases, steps)) {
+                        std::cout << "Chrome trace written to " << trace_path.generic_string() << " (open in chrome://tracing or ui.perfetto.dev)\n\n";
                     }
-                } else {
-                    std::cout << "Keeping build directory as requested (-k/--keep-build).\n";
                 }
                 
                 std::cout << "Build completed successfully!\n";
-                std::cout << "Executable(s) are now available in the bin/ directory.\n";
+                if (several_modes) {
+                    std::cout << "Executable(s) are now available in";
+                    for (size_t i = 0; i < builds.size(); ++i) {
+                        std::cout << (i ? ", " : " ") << builds[i].tree.output_dir.generic_string() << "/";
+                    }
+                    std::cout << ".\n";
+                } else if (!app_target.empty()) {
+                    std::cout << "Executable " << (bin_dir / app_target).generic_string() << " is now available.\n";
+                } else {
+                    std::cout << "Executable(s) are now available in the bin/ directory.\n";
+                }
                 
                 return 0;
                 
             } catch (const std::exception& e) {
-                // Ensure we return to original directory in case of exception
-                std::error_code ec;
-                std::filesystem::current_path(current_dir, ec);
-                
                 std::cerr << "Error during build: " << e.what() << "\n";
                 return 1;
             }
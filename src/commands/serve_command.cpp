@@ -0,0 +1,690 @@
+#include "commands.h"
+#include "process_utils.h"
+#include "serve_utils.h"
+#include "source_utils.h"
+#include "watch_utils.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+
+#ifdef __linux__
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace ctc {
+    namespace commands {
+        
+        namespace {
+            using Clock = std::chrono::steady_clock;
+
+#ifdef __linux__
+            volatile sig_atomic_t stop_requested = 0;
+            
+            void on_stop_signal(int signal_number) {
+                stop_requested = signal_number;
+            }
+            
+            // Only there so SIGCHLD interrupts ppoll
+            void on_child_exit(int) {}
+            
+            // A project the daemon has seen a request for
+            struct Project {
+                std::filesystem::path root;
+                unsigned long long generation = 0;  // bumped by every change that may affect what a command does
+                int busy = 0;                       // run/apply requests in progress
+                // run/apply requests (by key) that succeeded at the current generation, with their command line;
+                // repeating one is a no-op and is answered without running it
+                std::map<std::string, std::string> up_to_date;
+                unsigned long long requests = 0;
+                unsigned long long answered = 0;    // without running anything
+                // Source layout (lib/ graph, app targets, #include scan) scanned here and handed to the forked
+                // commands; dropped by any change below a source root
+                std::unique_ptr<utils::SourceLayout> layout;
+                std::string layout_warnings;
+                unsigned long long layout_scans = 0;
+            };
+            
+            // A request running in a forked copy of the daemon
+            struct RunningRequest {
+                pid_t pid = -1;
+                int connection = -1;                // -1 once the client is gone
+                Project* project = nullptr;
+                std::string key;                    // empty: never answered from memory
+                std::string command_line;
+                bool mutating = false;              // run/apply, which write into the project
+                unsigned long long generation = 0;  // of the project when the request started
+                Clock::time_point start;
+            };
+            
+            bool write_all(int fd, const char* data, size_t size) {
+                while (size > 0) {
+                    const ssize_t written = write(fd, data, size);
+                    if (written < 0) {
+                        if (errno == EINTR) continue;
+                        return false;
+                    }
+                    data += written;
+                    size -= static_cast<size_t>(written);
+                }
+                return true;
+            }
+            
+            void write_text(int fd, const std::string& text) {
+                write_all(fd, text.data(), text.size());
+            }
+            
+            void send_status(int connection, int status) {
+                const int32_t value = status;
+                write_all(connection, reinterpret_cast<const char*>(&value), sizeof(value));
+            }
+            
+            std::string elapsed_text(Clock::time_point start) {
+                const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                std::ostringstream text;
+                text << std::fixed << std::setprecision(1);
+                if (ms < 1000) {
+                    text << ms << " ms";
+                } else {
+                    text << ms / 1000 << " s";
+                }
+                return text.str();
+            }
+            
+            // Read one request and the client's stdout/stderr descriptors from a new connection
+            bool receive_request(int connection, utils::ServeRequest& request, int fds[2]) {
+                struct timeval timeout = {2, 0};
+                setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                
+                std::string data;
+                char buffer[64 * 1024];
+                alignas(struct cmsghdr) char control[CMSG_SPACE(2 * sizeof(int))];
+                struct iovec iov = {buffer, sizeof(buffer)};
+                struct msghdr header;
+                std::memset(&header, 0, sizeof(header));
+                header.msg_iov = &iov;
+                header.msg_iovlen = 1;
+                header.msg_control = control;
+                header.msg_controllen = sizeof(control);
+                ssize_t got = recvmsg(connection, &header, MSG_CMSG_CLOEXEC);
+                if (got <= 0) {
+                    return false;
+                }
+                for (struct cmsghdr* part = CMSG_FIRSTHDR(&header); part; part = CMSG_NXTHDR(&header, part)) {
+                    if (part->cmsg_level == SOL_SOCKET && part->cmsg_type == SCM_RIGHTS && part->cmsg_len == CMSG_LEN(2 * sizeof(int))) {
+                        std::memcpy(fds, CMSG_DATA(part), 2 * sizeof(int));
+                    }
+                }
+                data.append(buffer, static_cast<size_t>(got));
+                
+                const size_t header_size = 8;
+                uint32_t size = 0;
+                while (true) {
+                    if (data.size() >= header_size) {
+                        if (data.compare(0, 4, "CTC1") != 0) return false;
+                        std::memcpy(&size, data.data() + 4, sizeof(size));
+                        if (size > 16 * 1024 * 1024) return false;
+                        if (data.size() >= header_size + size) break;
+                    }
+                    got = read(connection, buffer, sizeof(buffer));
+                    if (got < 0 && errno == EINTR) continue;
+                    if (got <= 0) return false;
+                    data.append(buffer, static_cast<size_t>(got));
+                }
+                return fds[0] >= 0 && fds[1] >= 0 && utils::decode_serve_request(data.substr(header_size, size), request);
+            }
+            
+            // Key of a request that may be answered from memory: the same command, arguments and environment
+            std::string request_key(const utils::ServeRequest& request) {
+                std::vector<std::string> environment = request.environment;
+                std::sort(environment.begin(), environment.end());
+                std::string key = request.command;
+                for (const auto& arg : request.args) {
+                    key += '\0' + arg;
+                }
+                std::string joined;
+                for (const auto& entry : environment) {
+                    joined += entry + '\0';
+                }
+                return key + '\0' + std::to_string(utils::hash_content(joined)) + '\0' + std::to_string(request.umask);
+            }
+            
+            // Only apply is answered from memory: its inputs are .libname, CMakeLists.txt and the source roots, all
+            // watched here. A build also depends on files the daemon cannot see (sources added to targets by hand,
+            // headers on external -I paths, the toolchain, the compiler), so run always runs; its configure step is
+            // still skipped by the configure fingerprint and a no-op cmake --build is cheap.
+            bool is_repeatable(const utils::ServeRequest& request) {
+                return request.command == "apply";
+            }
+            
+            void watch_project(utils::FileWatcher& watcher, const Project& project) {
+                // The project directory itself (not recursive) for .libname, CMakeLists.txt and new directories
+                watcher.add_directory(project.root, false);
+                for (const auto& root : utils::project_source_roots()) {
+                    watcher.add_directory(project.root / root, true);
+                }
+            }
+            
+            // Whether a change (relative to the project) may change what scan_source_layout finds
+            bool affects_layout(const std::string& relative, const utils::FileChange& change) {
+                const std::string top = relative.substr(0, relative.find('/'));
+                const auto& roots = utils::project_source_roots();
+                if (std::find(roots.begin(), roots.end(), std::filesystem::path(top)) == roots.end()) {
+                    return false; // .ctc/, .git/, ...
+                }
+                return change.is_directory || utils::is_source_file(relative) || utils::is_header_file(relative);
+            }
+            
+            // Whether a change (relative to the project) may make a repeated apply do something.
+            // While a run or apply is running, what it writes itself does not count.
+            bool affects_project(const Project& project, const std::string& relative, const utils::FileChange& change) {
+                const bool at_top = relative.find('/') == std::string::npos;
+                if (at_top && !change.is_directory) {
+                    if (relative == ".libname") {
+                        return true;
+                    }
+                    if (relative == "CMakeLists.txt" || relative == "ctc_sources.cmake") {
+                        return project.busy == 0;
+                    }
+                    return false;
+                }
+                return affects_layout(relative, change);
+            }
+            
+            // Scan the layout of a ctc project in the daemon, where it outlives the request
+            void warm_layout(Project& project) {
+                std::error_code ec;
+                if (project.layout || !std::filesystem::exists(project.root / ".libname", ec)) {
+                    return;
+                }
+                // The scan works on paths relative to the project, like the commands
+                const std::filesystem::path previous = std::filesystem::current_path(ec);
+                std::filesystem::current_path(project.root, ec);
+                if (ec) {
+                    return;
+                }
+                project.layout = std::make_unique<utils::SourceLayout>(utils::scan_source_layout(".ctc", project.layout_warnings));
+                ++project.layout_scans;
+                std::filesystem::current_path(previous.empty() ? std::filesystem::path("/") : previous, ec);
+            }
+            
+            int run_forwarded_command(const utils::ServeRequest& request) {
+                if (request.command == "run") return run_command(request.args);
+                if (request.command == "apply") return apply_command(request.args);
+                if (request.command == "list") return list_command(request.args);
+                std::cerr << "Error: ctc serve does not handle '" << request.command << "'\n";
+                return 1;
+            }
+            
+            // In the forked copy: become the client's process as far as the command can tell, then run it
+            void run_in_child(const utils::ServeRequest& request, const int fds[2], const Project& project) {
+                for (int signal_number : {SIGINT, SIGTERM, SIGHUP, SIGCHLD, SIGPIPE}) {
+                    std::signal(signal_number, SIG_DFL);
+                }
+                sigset_t none;
+                sigemptyset(&none);
+                sigprocmask(SIG_SETMASK, &none, nullptr);
+                
+                const int null_fd = open("/dev/null", O_RDONLY);
+                if (null_fd >= 0) {
+                    dup2(null_fd, STDIN_FILENO);
+                    close(null_fd);
+                }
+                dup2(fds[0], STDOUT_FILENO);
+                dup2(fds[1], STDERR_FILENO);
+                close(fds[0]);
+                close(fds[1]);
+                
+                int status = 1;
+                clearenv();
+                for (const auto& entry : request.environment) {
+                    const size_t eq = entry.find('=');
+                    if (eq != std::string::npos && eq > 0) {
+                        setenv(entry.substr(0, eq).c_str(), entry.substr(eq + 1).c_str(), 1);
+                    }
+                }
+                umask(static_cast<mode_t>(request.umask));
+                if (chdir(request.cwd.c_str()) != 0) {
+                    std::cerr << "Error: ctc serve cannot enter " << request.cwd << ": " << std::strerror(errno) << "\n";
+                } else {
+                    if (project.layout) {
+                        utils::set_warm_source_layout(project.root / ".ctc", *project.layout, project.layout_warnings);
+                    }
+                    try {
+                        status = run_forwarded_command(request);
+                    } catch (const std::exception& e) {
+                        std::cerr << "Error: " << e.what() << "\n";
+                        status = 1;
+                    }
+                }
+                std::cout.flush();
+                std::cerr.flush();
+                std::fflush(nullptr);
+                _exit(status);
+            }
+            
+            class Server {
+            public:
+                Server(int listen_fd, std::filesystem::path socket_path)
+                    : listen_fd_(listen_fd), socket_path_(std::move(socket_path)), started_(Clock::now()) {}
+                
+                int run();
+            
+            private:
+                void accept_request();
+                void handle_request(int connection, const utils::ServeRequest& request, const int fds[2]);
+                void handle_changes();
+                void finish(RunningRequest& request, int status);
+                std::string status_text() const;
+                Project& project_for(const std::filesystem::path& root);
+                
+                int listen_fd_;
+                std::filesystem::path socket_path_;
+                Clock::time_point started_;
+                utils::FileWatcher watcher_;
+                std::map<std::string, std::unique_ptr<Project>> projects_;  // by root
+                std::vector<RunningRequest> running_;
+                bool stopping_ = false;
+            };
+            
+            Project& Server::project_for(const std::filesystem::path& root) {
+                auto& project = projects_[root.string()];
+                if (!project) {
+                    project = std::make_unique<Project>();
+                    project->root = root;
+                    watch_project(watcher_, *project);
+                    std::cout << "[serve] Watching " << root.string() << "\n" << std::flush;
+                }
+                return *project;
+            }
+            
+            std::string Server::status_text() const {
+                const auto uptime = std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - started_).count();
+                std::string text = "ctc serve (pid " + std::to_string(getpid()) + ") on " + socket_path_.string() +
+                                   ", up " + std::to_string(uptime) + "s, " + std::to_string(projects_.size()) + " project(s)\n";
+                for (const auto& entry : projects_) {
+                    const Project& project = *entry.second;
+                    const auto running = std::count_if(running_.begin(), running_.end(), [&project](const RunningRequest& request) {
+                        return request.project == &project;
+                    });
+                    text += "  " + project.root.string() + ": " + std::to_string(project.requests) + " request(s), " +
+                            std::to_string(project.answered) + " answered from memory, " + std::to_string(running) + " running, " +
+                            "source layout scanned " + std::to_string(project.layout_scans) + " time(s)" +
+                            (project.layout ? " (warm)\n" : "\n");
+                    for (const auto& up_to_date : project.up_to_date) {
+                        text += "    up to date: " + up_to_date.second + "\n";
+                    }
+                }
+                return text;
+            }
+            
+            void Server::accept_request() {
+                const int connection = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+                if (connection < 0) {
+                    return;
+                }
+                // Only the user who started the daemon may use it
+                if (!utils::peer_is_this_user(connection)) {
+                    close(connection);
+                    return;
+                }
+                utils::ServeRequest request;
+                int fds[2] = {-1, -1};
+                if (!receive_request(connection, request, fds)) {
+                    for (int fd : fds) {
+                        if (fd >= 0) close(fd);
+                    }
+                    close(connection);
+                    return;
+                }
+                handle_request(connection, request, fds);
+            }
+            
+            void Server::handle_request(int connection, const utils::ServeRequest& request, const int fds[2]) {
+                const Clock::time_point start = Clock::now();
+                std::vector<std::string> argv = {"ctc", request.command};
+                argv.insert(argv.end(), request.args.begin(), request.args.end());
+                const std::string command_line = utils::format_command_line(argv);
+                auto reply = [&](const std::string& text, int status) {
+                    write_text(status == 0 ? fds[0] : fds[1], text);
+                    close(fds[0]);
+                    close(fds[1]);
+                    send_status(connection, status);
+                    close(connection);
+                };
+                
+                // Requests about the daemon itself
+                if (request.command == "serve") {
+                    if (request.args.size() == 1 && request.args[0] == "--status") {
+                        reply(status_text(), 0);
+                    } else if (request.args.size() == 1 && request.args[0] == "--stop") {
+                        reply("Stopping ctc serve (pid " + std::to_string(getpid()) + ")\n", 0);
+                        stopping_ = true;
+                    } else {
+                        reply("Error: ctc serve is already running on " + socket_path_.string() + "\n", 1);
+                    }
+                    return;
+                }
+                if (request.command != "run" && request.command != "apply" && request.command != "list") {
+                    reply("Error: ctc serve does not handle '" + request.command + "'\n", 1);
+                    return;
+                }
+                
+                std::error_code ec;
+                const std::filesystem::path root = std::filesystem::canonical(request.cwd, ec);
+                if (ec) {
+                    reply("Error: ctc serve cannot use " + request.cwd + ": " + ec.message() + "\n", 1);
+                    return;
+                }
+                Project& project = project_for(root);
+                ++project.requests;
+                // Changes made before the request was sent are already queued; take them in first
+                handle_changes();
+                
+                // A repeat of a request that succeeded with nothing changed since would do nothing
+                const std::string key = is_repeatable(request) ? request_key(request) : "";
+                if (!key.empty() && project.up_to_date.count(key)) {
+                    ++project.answered;
+                    reply("Nothing changed since the last successful '" + command_line + "'; CMakeLists.txt is up to date (ctc serve).\n", 0);
+                    std::cout << "[serve] " << root.string() << ": " << command_line << ": up to date (" << elapsed_text(start) << ")\n" << std::flush;
+                    return;
+                }
+                
+                RunningRequest running;
+                running.connection = connection;
+                running.project = &project;
+                running.key = key;
+                running.command_line = command_line;
+                running.mutating = request.command != "list";
+                running.generation = project.generation;
+                running.start = start;
+                if (running.mutating) {
+                    // Whatever it changes may affect the other requests remembered as no-ops
+                    project.up_to_date.clear();
+                    ++project.busy;
+                }
+                
+                std::cout.flush();
+                std::cerr.flush();
+                if (running.mutating) {
+                    warm_layout(project);
+                }
+                running.pid = fork();
+                if (running.pid == 0) {
+                    close(listen_fd_);
+                    close(connection);
+                    run_in_child(request, fds, project);
+                }
+                close(fds[0]);
+                close(fds[1]);
+                if (running.pid < 0) {
+                    if (running.mutating) --project.busy;
+                    const std::string error = std::strerror(errno);
+                    std::cerr << "[serve] fork failed: " << error << "\n";
+                    send_status(connection, 1);
+                    close(connection);
+                    return;
+                }
+                running_.push_back(running);
+            }
+            
+            void Server::handle_changes() {
+                std::vector<utils::FileChange> changes;
+                if (!watcher_.wait(0, changes)) {
+                    return;
+                }
+                for (const auto& change : changes) {
+                    if (change.overflow) {
+                        // Events were lost: nothing is known to be up to date any more
+                        for (auto& entry : projects_) {
+                            ++entry.second->generation;
+                            entry.second->up_to_date.clear();
+                            entry.second->layout.reset();
+                        }
+                        continue;
+                    }
+                    // The innermost project the path belongs to
+                    Project* project = nullptr;
+                    for (auto& entry : projects_) {
+                        const std::string& root = entry.first;
+                        if (change.path.size() > root.size() && change.path.compare(0, root.size(), root) == 0 && change.path[root.size()] == '/' &&
+                            (!project || root.size() > project->root.string().size())) {
+                            project = entry.second.get();
+                        }
+                    }
+                    if (!project) {
+                        continue;
+                    }
+                    const std::string relative = change.path.substr(project->root.string().size() + 1);
+                    
+                    // Source roots created after the project was first seen
+                    if (change.is_directory && change.structural && relative.find('/') == std::string::npos) {
+                        watch_project(watcher_, *project);
+                    }
+                    if (affects_project(*project, relative, change)) {
+                        ++project->generation;
+                        project->up_to_date.clear();
+                    }
+                    if (affects_layout(relative, change)) {
+                        project->layout.reset();
+                    }
+                }
+            }
+            
+            void Server::finish(RunningRequest& request, int status) {
+                Project& project = *request.project;
+                if (request.mutating) {
+                    --project.busy;
+                }
+                // Only a success with no outside change meanwhile makes a repeat a no-op
+                if (status == 0 && !request.key.empty() && request.generation == project.generation) {
+                    project.up_to_date[request.key] = request.command_line;
+                }
+                if (request.connection >= 0) {
+                    send_status(request.connection, status);
+                    close(request.connection);
+                }
+                std::cout << "[serve] " << project.root.string() << ": " << request.command_line << ": exit " << status
+                          << " (" << elapsed_text(request.start) << ")\n" << std::flush;
+            }
+            
+            int Server::run() {
+                if (!watcher_.valid()) {
+                    std::cerr << "Error: " << watcher_.error() << "\n";
+                    return 1;
+                }
+                
+                // Signals are only delivered while waiting in ppoll, so none can slip in between checks
+                sigset_t blocked;
+                sigemptyset(&blocked);
+                for (int signal_number : {SIGINT, SIGTERM, SIGHUP, SIGCHLD}) {
+                    sigaddset(&blocked, signal_number);
+                }
+                sigset_t unblocked;
+                sigprocmask(SIG_BLOCK, &blocked, &unblocked);
+                for (int signal_number : {SIGINT, SIGTERM, SIGHUP, SIGCHLD}) {
+                    struct sigaction action;
+                    std::memset(&action, 0, sizeof(action));
+                    action.sa_handler = signal_number == SIGCHLD ? on_child_exit : on_stop_signal;
+                    sigemptyset(&action.sa_mask);
+                    sigaction(signal_number, &action, nullptr);
+                }
+                std::signal(SIGPIPE, SIG_IGN);
+                
+                std::vector<struct pollfd> fds;
+                while (!stop_requested && !stopping_) {
+                    fds.clear();
+                    fds.push_back({listen_fd_, POLLIN, 0});
+                    fds.push_back({watcher_.fd(), POLLIN, 0});
+                    for (const auto& request : running_) {
+                        fds.push_back({request.connection, POLLIN, 0}); // negative (client gone) entries are skipped
+                    }
+                    const int ready = ppoll(fds.data(), fds.size(), nullptr, &unblocked);
+                    if (ready < 0 && errno != EINTR) {
+                        std::cerr << "[serve] ppoll failed: " << std::strerror(errno) << "\n";
+                        break;
+                    }
+                    
+                    // Finished commands; their own file changes are read before their results are judged
+                    std::vector<std::pair<pid_t, int>> finished;
+                    int wait_status = 0;
+                    pid_t pid;
+                    while ((pid = waitpid(-1, &wait_status, WNOHANG)) > 0) {
+                        finished.push_back({pid, WIFEXITED(wait_status) ? WEXITSTATUS(wait_status)
+                                                 : WIFSIGNALED(wait_status) ? 128 + WTERMSIG(wait_status) : 1});
+                    }
+                    if (!finished.empty() || (ready > 0 && (fds[1].revents & POLLIN))) {
+                        handle_changes();
+                    }
+                    for (const auto& result : finished) {
+                        auto request = std::find_if(running_.begin(), running_.end(), [&result](const RunningRequest& r) { return r.pid == result.first; });
+                        if (request != running_.end()) {
+                            finish(*request, result.second);
+                            running_.erase(request);
+                        }
+                    }
+                    if (ready <= 0) {
+                        continue;
+                    }
+                    
+                    // Clients pass Ctrl-C on as one byte per signal; a client that went away hangs its command up
+                    for (size_t i = 2; i < fds.size(); ++i) {
+                        if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                        auto request = std::find_if(running_.begin(), running_.end(), [&](const RunningRequest& r) { return r.connection == fds[i].fd; });
+                        if (request == running_.end()) continue;
+                        unsigned char signals[16];
+                        const ssize_t got = read(request->connection, signals, sizeof(signals));
+                        if (got <= 0) {
+                            kill(request->pid, SIGHUP);
+                            close(request->connection);
+                            request->connection = -1;
+                            continue;
+                        }
+                        for (ssize_t j = 0; j < got; ++j) {
+                            if (signals[j] == SIGINT || signals[j] == SIGTERM || signals[j] == SIGHUP) {
+                                kill(request->pid, signals[j]);
+                            }
+                        }
+                    }
+                    if (fds[0].revents & POLLIN) {
+                        accept_request();
+                    }
+                }
+                
+                // Stop what is still running and tell its clients
+                for (auto& request : running_) {
+                    kill(request.pid, SIGTERM);
+                }
+                for (auto& request : running_) {
+                    int wait_status = 0;
+                    waitpid(request.pid, &wait_status, 0);
+                    finish(request, WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : 128 + SIGTERM);
+                }
+                running_.clear();
+                return stop_requested ? 128 + stop_requested : 0;
+            }
+            
+            bool connect_socket(const std::filesystem::path& socket_path) {
+                struct sockaddr_un address;
+                std::memset(&address, 0, sizeof(address));
+                address.sun_family = AF_UNIX;
+                std::strcpy(address.sun_path, socket_path.c_str());
+                const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (fd < 0) {
+                    return false;
+                }
+                const bool connected = connect(fd, reinterpret_cast<const struct sockaddr*>(&address), sizeof(address)) == 0;
+                close(fd);
+                return connected;
+            }
+#endif
+        }
+        
+        int serve_command(const std::vector<std::string>& args) {
+#ifndef __linux__
+            (void)args;
+            std::cerr << "Error: ctc serve needs Linux (Unix domain sockets and inotify)\n";
+            return 1;
+#else
+            const std::filesystem::path socket_path = utils::serve_socket_path();
+            
+            // --status and --stop talk to the running daemon
+            if (args.size() == 1 && (args[0] == "--status" || args[0] == "--stop")) {
+                int status = 1;
+                if (utils::forward_to_server("serve", args, status)) {
+                    return status;
+                }
+                std::cerr << "ctc serve is not running (no daemon on " << socket_path.string() << ")\n";
+                return 1;
+            }
+            if (!args.empty()) {
+                std::cerr << "Error: Unknown option '" << args[0] << "'\n";
+                std::cerr << "Usage: ctc serve [--status | --stop]\n";
+                return 1;
+            }
+            
+            struct sockaddr_un address;
+            if (socket_path.native().size() >= sizeof(address.sun_path)) {
+                std::cerr << "Error: Socket path " << socket_path.string() << " is too long\n";
+                return 1;
+            }
+            if (connect_socket(socket_path)) {
+                std::cerr << "Error: ctc serve is already running on " << socket_path.string() << "\n";
+                return 1;
+            }
+            
+            // The socket's directory must be the user's alone; clients refuse the daemon otherwise
+            const std::filesystem::path socket_dir = socket_path.parent_path();
+            if (!std::getenv("CTC_SERVE_SOCKET") || !*std::getenv("CTC_SERVE_SOCKET")) {
+                mkdir(socket_dir.c_str(), 0700);
+            }
+            if (!utils::is_private_directory(socket_dir)) {
+                std::cerr << "Error: " << (socket_dir.empty() ? std::filesystem::path(".") : socket_dir).string()
+                          << " must be a directory owned by you that only you can access\n";
+                return 1;
+            }
+            
+            const int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (listen_fd < 0) {
+                std::cerr << "Error: Cannot create a socket: " << std::strerror(errno) << "\n";
+                return 1;
+            }
+            std::memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            std::strcpy(address.sun_path, socket_path.c_str());
+            unlink(socket_path.c_str()); // left behind by a daemon that did not shut down cleanly
+            const mode_t previous_umask = umask(077);
+            const bool bound = bind(listen_fd, reinterpret_cast<const struct sockaddr*>(&address), sizeof(address)) == 0;
+            umask(previous_umask);
+            if (!bound || listen(listen_fd, 64) != 0) {
+                std::cerr << "Error: Cannot listen on " << socket_path.string() << ": " << std::strerror(errno) << "\n";
+                close(listen_fd);
+                return 1;
+            }
+            
+            std::cout << "ctc serve listening on " << socket_path.string() << " (pid " << getpid() << ")\n";
+            std::cout << "'ctc run', 'ctc apply' and 'ctc list' now go through it. Stop with Ctrl-C or 'ctc serve --stop'.\n" << std::flush;
+            Server server(listen_fd, socket_path);
+            const int status = server.run();
+            unlink(socket_path.c_str());
+            close(listen_fd);
+            std::cout << "[serve] Stopped.\n";
+            return status;
+#endif
+        }
+    }
+}
@@ -0,0 +1,331 @@
+#include "commands.h"
+#include "file_utils.h"
+#include "build_utils.h"
+#include "profile_utils.h"
+#include "result_set_utils.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace ctc {
+    namespace commands {
+        
+        namespace {
+            const std::filesystem::path results_dir = ".ctc/stat";
+            
+            // All runs of one counter
+            struct CounterSeries {
+                std::string name;
+                std::vector<double> values;
+                
+                double mean() const {
+                    double sum = 0;
+                    for (double v : values) sum += v;
+                    return values.empty() ? 0 : sum / static_cast<double>(values.size());
+                }
+                
+                double stddev() const {
+                    if (values.size() < 2) return 0;
+                    const double m = mean();
+                    double sum = 0;
+                    for (double v : values) sum += (v - m) * (v - m);
+                    return std::sqrt(sum / static_cast<double>(values.size() - 1));
+                }
+            };
+            
+            // One counter per line: {"counter": "...", "mean": <n>, "stddev": <n>, "values": [<n>, ...]}
+            std::string format_series(const std::vector<CounterSeries>& series) {
+                std::ostringstream out;
+                out << std::setprecision(15) << "[\n";
+                for (size_t i = 0; i < series.size(); ++i) {
+                    out << "{\"counter\": \"" << series[i].name << "\", \"mean\": " << series[i].mean()
+                        << ", \"stddev\": " << series[i].stddev() << ", \"values\": [";
+                    for (size_t j = 0; j < series[i].values.size(); ++j) {
+                        out << (j ? ", " : "") << series[i].values[j];
+                    }
+                    out << "]}" << (i + 1 < series.size() ? "," : "") << "\n";
+                }
+                out << "]\n";
+                return out.str();
+            }
+            
+            std::vector<CounterSeries> read_series(const std::filesystem::path& path) {
+                std::vector<CounterSeries> series;
+                for (auto& record : utils::read_result_records(path, "counter")) {
+                    series.push_back({record.strings["counter"], std::move(record.number_arrays["values"])});
+                }
+                return series;
+            }
+            
+            const CounterSeries* find_series(const std::vector<CounterSeries>& series, const std::string& name) {
+                for (const auto& entry : series) {
+                    if (entry.name == name) return &entry;
+                }
+                return nullptr;
+            }
+            
+            // "1,234,567"
+            std::string group_digits(double value) {
+                std::string digits = std::to_string(static_cast<unsigned long long>(std::llround(value)));
+                for (size_t i = digits.size(); i > 3; i -= 3) {
+                    digits.insert(i - 3, ",");
+                }
+                return digits;
+            }
+            
+            std::string format_fixed(double value, int precision) {
+                std::ostringstream out;
+                out << std::fixed << std::setprecision(precision) << value;
+                return out.str();
+            }
+            
+            std::string format_relative_stddev(const CounterSeries& series) {
+                std::ostringstream out;
+                const double mean = series.mean();
+                out << "+- " << std::fixed << std::setprecision(2) << (mean > 0 ? 100.0 * series.stddev() / mean : 0.0) << "%";
+                return out.str();
+            }
+        }
+        
+        int stat_command(const std::vector<std::string>& args) {
+            unsigned jobs = 0; // 0 = detect from usable cores
+            std::string requested_generator;
+            unsigned runs = 5;
+            bool instructions_only = false;
+            bool quiet = false;
+            bool save = false;
+            std::string save_name;      // empty: current git commit
+            std::string compare_name;
+            std::string app_target;     // executable of the per-target layout (-t); empty: bin/<project name>
+            double threshold = 2.0;     // percent more instructions that fails the comparison
+            std::vector<std::string> program_args;
+            
+            for (size_t i = 0; i < args.size(); ++i) {
+                if (args[i] == "--") {
+                    program_args.assign(args.begin() + static_cast<long>(i) + 1, args.end());
+                    break;
+                } else if ((args[i] == "-j" || args[i] == "--jobs") && i + 1 < args.size()) {
+                    if (!utils::parse_job_count(args[i + 1], jobs)) {
+                        std::cerr << "Error: Invalid job count '" << args[i + 1] << "'. Expected an integer from 1 to " << utils::max_job_count << "\n";
+                        return 1;
+                    }
+                    ++i;
+                } else if ((args[i] == "-G" || args[i] == "--generator") && i + 1 < args.size()) {
+                    requested_generator = args[++i];
+                } else if ((args[i] == "-t" || args[i] == "--target") && i + 1 < args.size()) {
+                    app_target = args[++i];
+                } else if ((args[i] == "-r" || args[i] == "--runs") && i + 1 < args.size()) {
+                    unsigned long long value = 0;
+                    if (!utils::parse_integer(args[i + 1], 1, 1000000, value)) {
+                        std::cerr << "Error: Invalid run count '" << args[i + 1] << "'. Expected an integer from 1 to 1000000\n";
+                        return 1;
+                    }
+                    runs = static_cast<unsigned>(value);
+                    ++i;
+                } else if (args[i] == "--instructions") {
+                    instructions_only = true;
+                } else if (args[i] == "-q" || args[i] == "--quiet") {
+                    quiet = true;
+                } else if (args[i] == "--save") {
+                    save = true;
+                    if (i + 1 < args.size() && args[i + 1] != "--" && args[i + 1][0] != '-') {
+                        save_name = args[++i];
+                    }
+                } else if (args[i] == "--compare" && i + 1 < args.size()) {
+                    compare_name = args[++i];
+                } else if (args[i] == "--threshold" && i + 1 < args.size()) {
+                    char* end = nullptr;
+                    threshold = std::strtod(args[i + 1].c_str(), &end);
+                    if (end == args[i + 1].c_str() || *end != '\0' || threshold < 0) {
+                        std::cerr << "Error: Invalid threshold '" << args[i + 1] << "'. Expected a non-negative percentage\n";
+                        return 1;
+                    }
+                    ++i;
+                } else {
+                    std::cerr << "Error: Unknown option '" << args[i] << "'\n";
+                    std::cerr << "Usage: ctc stat [-r <runs>] [--instructions] [-q] [-j <jobs>] [-G <generator>] [-t <target>]\n";
+                    std::cerr << "                [--save [<name>]] [--compare <name>] [--threshold <percent>] [-- <program arguments>]\n";
+                    return 1;
+                }
+            }
+            
+            if (!std::filesystem::exists("CMakeLists.txt")) {
+                std::cerr << "Error: CMakeLists.txt not found. Run 'ctc apply' or use 'ctc run -U' first.\n";
+                return 1;
+            }
+            // With the per-target layout there is no bin/<project name>; -t picks the executable
+            std::string target_error;
+            if (app_target.empty() && utils::app_targets_enabled()) {
+                std::cerr << "Error: This project builds one executable per app/ target; choose one with -t <target>\n";
+                return 1;
+            }
+            if (!app_target.empty() && !utils::check_app_target(app_target, target_error)) {
+                std::cerr << "Error: " << target_error << "\n";
+                return 1;
+            }
+            if (save && save_name.empty()) {
+                save_name = utils::current_commit_name();
+                if (save_name.empty()) {
+                    std::cerr << "Error: Not in a git repository; give --save a name\n";
+                    return 1;
+                }
+            }
+            if (save && !utils::is_valid_result_set_name(save_name)) {
+                std::cerr << "Error: Invalid result set name '" << save_name << "'\n";
+                return 1;
+            }
+            std::vector<CounterSeries> baseline;
+            if (!compare_name.empty()) {
+                // The name becomes a path; check it before anything is read
+                if (!utils::is_valid_result_set_name(compare_name)) {
+                    std::cerr << "Error: Invalid result set name '" << compare_name << "'\n";
+                    return 1;
+                }
+                baseline = read_series(results_dir / (compare_name + ".json"));
+                if (find_series(baseline, "instructions") == nullptr) {
+                    std::cerr << "Error: No saved counter results named '" << compare_name << "'\n";
+                    return 1;
+                }
+            }
+            if (jobs == 0) {
+                jobs = utils::detect_job_count();
+            }
+            
+            try {
+                if (std::filesystem::exists("ctc_sources.cmake") && !utils::update_sources_manifest("ctc_sources.cmake")) {
+                    std::cerr << "Failed to update ctc_sources.cmake\n";
+                    return 1;
+                }
+                
+                // 1. The same Release build as 'ctc run'
+                utils::BuildTreeOptions tree;
+                tree.build_dir = std::filesystem::path("build") / "Release";
+                tree.generator = requested_generator;
+                tree.jobs = jobs;
+                if (!utils::prepare_build_tree(tree) || !utils::configure_build_tree(tree)) {
+                    return 1;
+                }
+                const std::string project_name = utils::read_cmake_cache_value(tree.build_dir, "CMAKE_PROJECT_NAME");
+                if (!app_target.empty()) {
+                    tree.target = project_name + "_app_" + app_target;
+                }
+                if (!utils::build_build_tree(tree)) {
+                    return 1;
+                }
+                const std::string executable_name = app_target.empty() ? project_name : app_target;
+                const std::filesystem::path executable = std::filesystem::path("bin") / executable_name;
+                if (executable_name.empty() || !std::filesystem::exists(executable)) {
+                    std::cerr << "Error: Executable " << executable.generic_string() << " not found\n";
+                    return 1;
+                }
+                
+                // 2. Count. The instruction count alone needs a single hardware counter, so it is never
+                // multiplexed and barely changes from run to run
+                std::vector<utils::Counter> counters;
+                if (instructions_only) {
+                    counters = {utils::Counter::instructions};
+                } else {
+                    counters = {utils::Counter::task_clock, utils::Counter::cycles, utils::Counter::instructions,
+                                utils::Counter::cache_misses, utils::Counter::branch_misses, utils::Counter::page_faults};
+                }
+                std::vector<std::string> command = {std::filesystem::absolute(executable).string()};
+                command.insert(command.end(), program_args.begin(), program_args.end());
+                std::cout << "Counting " << executable.generic_string() << " over " << runs << " run" << (runs == 1 ? "" : "s") << "...\n" << std::flush;
+                
+                std::vector<CounterSeries> series;
+                std::vector<bool> supported(counters.size(), true);
+                std::vector<bool> multiplexed(counters.size(), false);
+                CounterSeries wall{"wall-ms", {}};
+                for (unsigned run = 0; run < runs; ++run) {
+                    utils::CountingResult result;
+                    std::string error;
+                    if (!utils::count_process(command, counters, quiet, result, error)) {
+                        std::cerr << "Error: Cannot count events: " << error << "\n";
+                        return 1;
+                    }
+                    if (result.exit_status != 0) {
+                        std::cerr << "Error: The program exited with status " << result.exit_status << " (run " << run + 1 << ")\n";
+                        return 1;
+                    }
+                    for (size_t i = 0; i < counters.size(); ++i) {
+                        supported[i] = supported[i] && result.readings[i].supported;
+                        multiplexed[i] = multiplexed[i] || (result.readings[i].supported && result.readings[i].running_fraction < 0.999);
+                        if (run == 0) series.push_back({utils::counter_name(counters[i]), {}});
+                        series[i].values.push_back(result.readings[i].value);
+                    }
+                    wall.values.push_back(result.wall_ms);
+                }
+                if (instructions_only && !supported[0]) {
+                    std::cerr << "Error: This machine cannot count instructions (no hardware counters are exposed,"
+                                 " which is common in VMs and containers)\n";
+                    return 1;
+                }
+                
+                // 3. Report, perf-stat style
+                std::vector<CounterSeries> counted;
+                std::cout << "\n";
+                for (size_t i = 0; i < series.size(); ++i) {
+                    std::cout << std::right << std::setw(20);
+                    if (!supported[i]) {
+                        std::cout << "<not supported>" << "  " << series[i].name << "\n";
+                        continue;
+                    }
+                    counted.push_back(series[i]);
+                    if (counters[i] == utils::Counter::task_clock) {
+                        std::cout << format_fixed(series[i].mean() / 1e6, 2) << "  " << std::left << std::setw(16) << "task-clock (ms)";
+                    } else {
+                        std::cout << group_digits(series[i].mean()) << "  " << std::left << std::setw(16) << series[i].name;
+                    }
+                    std::cout << std::right << std::setw(12) << format_relative_stddev(series[i]);
+                    if (counters[i] == utils::Counter::instructions && i > 0 && counters[i - 1] == utils::Counter::cycles &&
+                        supported[i - 1] && series[i - 1].mean() > 0) {
+                        std::cout << "    # " << format_fixed(series[i].mean() / series[i - 1].mean(), 2) << " insn per cycle";
+                    }
+                    if (multiplexed[i]) std::cout << "    (multiplexed)";
+                    std::cout << "\n";
+                }
+                std::cout << std::right << std::setw(20) << format_fixed(wall.mean(), 2) << "  " << std::left << std::setw(16) << "wall-clock (ms)" << std::right << std::setw(12) << format_relative_stddev(wall) << "\n";
+                counted.push_back(wall);
+                
+                if (!utils::create_directory_if_not_exists(results_dir.string())) {
+                    std::cerr << "Failed to create " << results_dir.generic_string() << "\n";
+                    return 1;
+                }
+                const std::filesystem::path results = results_dir / "latest.json";
+                if (!utils::write_file(results, format_series(counted))) {
+                    std::cerr << "Failed to write " << results.generic_string() << "\n";
+                    return 1;
+                }
+                std::cout << "\nResults: " << results.generic_string() << "\n";
+                
+                // 4. Gate on the instruction count, which unlike time is stable on a shared machine
+                bool regressed = false;
+                if (!compare_name.empty()) {
+                    const CounterSeries* before = find_series(baseline, "instructions");
+                    const CounterSeries* after = find_series(counted, "instructions");
+                    if (after == nullptr) {
+                        std::cerr << "Error: Instructions were not counted, so there is nothing to compare\n";
+                        return 1;
+                    }
+                    const double change = before->mean() > 0 ? 100.0 * (after->mean() - before->mean()) / before->mean() : 0;
+                    regressed = change > threshold;
+                    std::cout << "\nInstructions vs '" << compare_name << "': " << group_digits(before->mean()) << " -> "
+                              << group_digits(after->mean()) << " (" << (change >= 0 ? "+" : "") << format_fixed(change, 2)
+                              << "%, threshold " << threshold << "%)" << (regressed ? "  REGRESSION" : "") << "\n";
+                }
+                if (save && !utils::save_result_set(results_dir, save_name)) {
+                    return 1;
+                }
+                return regressed ? 1 : 0;
+            
+            } catch (const std::exception& e) {
+                std::cerr << "Error during counting: " << e.what() << "\n";
+                return 1;
+            }
+        }
+    }
+}
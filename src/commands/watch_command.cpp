@@ -0,0 +1,315 @@
+#include "commands.h"
+#include "file_utils.h"
+#include "build_utils.h"
+#include "artifact_utils.h"
+#include "process_utils.h"
+#include "source_utils.h"
+#include "watch_utils.h"
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <thread>
+
+namespace ctc {
+    namespace commands {
+        
+        namespace {
+            // What a batch of changes requires, from cheapest to most expensive; each includes the ones before
+            enum class Action { none, build, reconfigure, regenerate };
+            
+            using Clock = std::chrono::steady_clock;
+            
+            // Project name of the managed section, so regenerating it keeps the name chosen with -n
+            std::string current_project_name(const std::filesystem::path& cmake_path) {
+                const std::string content = utils::read_file(cmake_path);
+                const size_t start = content.find("\nproject(");
+                if (start == std::string::npos) {
+                    return "my_project";
+                }
+                const size_t name_start = start + 9;
+                const size_t name_end = content.find_first_of(" \t\n)", name_start);
+                return name_end == std::string::npos ? "my_project" : content.substr(name_start, name_end - name_start);
+            }
+            
+            // Action a change requires. .libname and CMakeLists.txt only count when their content changed,
+            // which also filters out ctc's own rewrites of CMakeLists.txt.
+            Action classify_change(const utils::FileChange& change, std::map<std::string, unsigned long long>& hashes) {
+                if (change.overflow) {
+                    return Action::reconfigure;
+                }
+                std::string path = change.path;
+                if (path.compare(0, 2, "./") == 0) {
+                    path = path.substr(2);
+                }
+                if (path == ".libname" || path == "CMakeLists.txt") {
+                    const unsigned long long hash = utils::hash_content(utils::read_file(path));
+                    if (hashes[path] == hash) {
+                        return Action::none;
+                    }
+                    hashes[path] = hash;
+                    return path == ".libname" ? Action::regenerate : Action::reconfigure;
+                }
+                
+                const std::string root = path.substr(0, path.find('/'));
+                const auto& roots = utils::project_source_roots();
+                if (std::find(roots.begin(), roots.end(), std::filesystem::path(root)) == roots.end()) {
+                    return Action::none; // build/, bin/, .ctc/, editor files next to the sources, ...
+                }
+                if (change.is_directory) {
+                    return Action::reconfigure;
+                }
+                if (!utils::is_source_file(path) && !utils::is_header_file(path)) {
+                    return Action::none;
+                }
+                // Files appearing or disappearing change the source set
+                return change.structural ? Action::reconfigure : Action::build;
+            }
+            
+            // Configure (if needed), build and publish, on the watch's worker thread
+            struct WatchBuild {
+                utils::BuildTreeOptions tree;
+                std::string app_target;
+                std::atomic<bool> cancel{false};
+                std::atomic<bool> running{false};
+                bool succeeded = false;
+            };
+            
+            void build_once(WatchBuild& build) {
+                utils::BuildTreeOptions& tree = build.tree;
+                build.succeeded = false;
+                if (!utils::prepare_build_tree(tree) || !utils::configure_build_tree(tree)) {
+                    return;
+                }
+                if (!build.app_target.empty()) {
+                    tree.target = utils::read_cmake_cache_value(tree.build_dir, "CMAKE_PROJECT_NAME") + "_app_" + build.app_target;
+                }
+                if (!utils::build_build_tree(tree)) {
+                    return;
+                }
+                const std::filesystem::path artifact_dir = std::filesystem::exists(tree.build_dir / "bin") ? tree.build_dir / "bin" : tree.build_dir;
+                for (const auto& artifact : utils::publish_executables(artifact_dir, tree.output_dir, tree.build_dir / "ctc_published.txt")) {
+                    if (!artifact.succeeded) {
+                        std::cerr << "Warning: could not publish \"" << artifact.source.filename().string() << "\": " << artifact.error << "\n";
+                    } else if (artifact.method != utils::PublishMethod::unchanged) {
+                        std::cout << "Published \"" << artifact.source.filename().string() << "\" to " << tree.output_dir.generic_string() << "/\n";
+                    }
+                }
+                build.succeeded = true;
+            }
+        }
+        
+        int watch_command(const std::vector<std::string>& args) {
+            std::string build_mode = "Release";
+            unsigned jobs = 0; // 0 = detect from usable cores
+            std::string requested_generator;
+            std::string app_target;
+            unsigned debounce_ms = 200;
+            
+            for (size_t i = 0; i < args.size(); ++i) {
+                if (args[i] == "-m" && i + 1 < args.size()) {
+                    build_mode = args[++i];
+                    if (build_mode != "Debug" && build_mode != "Release" && build_mode != "MinSizeRel" && build_mode != "RelWithDebInfo") {
+                        std::cerr << "Error: Invalid build mode '" << build_mode << "'. Valid modes are: Debug, Release, MinSizeRel, RelWithDebInfo\n";
+                        return 1;
+                    }
+                } else if ((args[i] == "-j" || args[i] == "--jobs") && i + 1 < args.size()) {
+                    if (!utils::parse_job_count(args[i + 1], jobs)) {
+                        std::cerr << "Error: Invalid job count '" << args[i + 1] << "'. Expected an integer from 1 to " << utils::max_job_count << "\n";
+                        return 1;
+                    }
+                    ++i;
+                } else if ((args[i] == "-G" || args[i] == "--generator") && i + 1 < args.size()) {
+                    requested_generator = args[++i];
+                } else if ((args[i] == "-t" || args[i] == "--target") && i + 1 < args.size()) {
+                    app_target = args[++i];
+                } else if (args[i] == "--debounce" && i + 1 < args.size()) {
+                    unsigned long long value = 0;
+                    if (!utils::parse_integer(args[i + 1], 0, 3600000, value)) {
+                        std::cerr << "Error: Invalid debounce time '" << args[i + 1] << "'. Expected milliseconds, at most 3600000\n";
+                        return 1;
+                    }
+                    debounce_ms = static_cast<unsigned>(value);
+                    ++i;
+                } else {
+                    std::cerr << "Error: Unknown option '" << args[i] << "'\n";
+                    std::cerr << "Usage: ctc watch [-m <mode>] [-j <jobs>] [-G <generator>] [-t <target>] [--debounce <ms>]\n";
+                    return 1;
+                }
+            }
+            
+            const std::filesystem::path libname_path = ".libname";
+            const std::filesystem::path cmake_path = "CMakeLists.txt";
+            const std::filesystem::path manifest_path = "ctc_sources.cmake";
+            if (!std::filesystem::exists(cmake_path)) {
+                std::cerr << "Error: CMakeLists.txt not found. Run 'ctc apply' or use 'ctc run -U' first.\n";
+                return 1;
+            }
+            std::string error;
+            if (!app_target.empty() && !utils::check_app_target(app_target, error)) {
+                std::cerr << "Error: " << error << "\n";
+                return 1;
+            }
+            
+            utils::FileWatcher watcher;
+            if (!watcher.valid()) {
+                std::cerr << "Error: " << watcher.error() << "\n";
+                return 1;
+            }
+            // The project directory itself (not recursive) for .libname, CMakeLists.txt and new source roots
+            watcher.add_directory(".", false);
+            for (const auto& root : utils::project_source_roots()) {
+                watcher.add_directory(root, true);
+            }
+            
+            if (jobs == 0) {
+                jobs = utils::detect_job_count();
+            }
+            WatchBuild build;
+            build.tree.build_dir = std::filesystem::path("build") / build_mode;
+            build.tree.build_mode = build_mode;
+            build.tree.generator = requested_generator;
+            build.tree.jobs = jobs;
+            build.tree.cancel = &build.cancel;
+            build.app_target = app_target;
+            if (!utils::create_directory_if_not_exists(build.tree.output_dir)) {
+                std::cerr << "Failed to create " << build.tree.output_dir.generic_string() << " directory\n";
+                return 1;
+            }
+            
+            std::map<std::string, unsigned long long> hashes;
+            for (const auto& path : {libname_path, cmake_path}) {
+                hashes[path.generic_string()] = utils::hash_content(utils::read_file(path));
+            }
+            
+            std::cout << "Watching app/, lib/, include/, bench/, .libname and CMakeLists.txt (" << build_mode << " mode, "
+                      << jobs << " jobs). Press Ctrl-C to stop.\n";
+            
+            // Start with a build, so the first edit only has to rebuild what it touched
+            Action pending = Action::build;
+            std::string reason = "initial build";
+            Clock::time_point last_change = Clock::now() - std::chrono::milliseconds(debounce_ms);
+            Clock::time_point build_start;
+            std::thread worker;
+            std::vector<utils::FileChange> changes;
+            
+            while (true) {
+                // Sleep until the debounce period of pending changes ends, polling while a build runs
+                int timeout_ms = -1;
+                if (pending != Action::none) {
+                    const auto quiet_for = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - last_change).count();
+                    timeout_ms = static_cast<int>(std::max<long long>(0, debounce_ms - quiet_for));
+                }
+                if (worker.joinable()) {
+                    timeout_ms = timeout_ms < 0 ? 100 : std::min(timeout_ms, 100);
+                }
+                changes.clear();
+                if (!watcher.wait(timeout_ms, changes)) {
+                    std::cerr << "Error: Watching for changes failed\n";
+                    break;
+                }
+                
+                for (const auto& change : changes) {
+                    // A source root created after the watch started
+                    if (change.is_directory && change.structural && change.path.compare(0, 2, "./") == 0) {
+                        const std::filesystem::path dir = change.path.substr(2);
+                        const auto& roots = utils::project_source_roots();
+                        if (std::find(roots.begin(), roots.end(), dir) != roots.end()) {
+                            watcher.add_directory(dir, true);
+                        }
+                    }
+                    const Action action = classify_change(change, hashes);
+                    if (action == Action::none) {
+                        continue;
+                    }
+                    if (pending == Action::none) {
+                        reason = change.overflow ? "many changes" : change.path.compare(0, 2, "./") == 0 ? change.path.substr(2) : change.path;
+                    }
+                    pending = std::max(pending, action);
+                    last_change = Clock::now();
+                    // New edits make the running build stale: stop it and start over once they settle
+                    if (build.running && !build.cancel) {
+                        build.cancel = true;
+                        std::cout << "\n[watch] " << reason << " changed; cancelling the running build...\n" << std::flush;
+                    }
+                }
+                
+                // Report a finished build
+                if (worker.joinable() && !build.running) {
+                    worker.join();
+                    if (utils::forwarded_signal() != 0) {
+                        std::cout << "\n[watch] Interrupted; stopping.\n";
+                        return 128 + utils::forwarded_signal();
+                    }
+                    if (!build.cancel) {
+                        const double seconds = std::chrono::duration<double>(Clock::now() - build_start).count();
+                        std::cout << "[watch] " << (build.succeeded ? "Build succeeded" : "Build failed") << " in "
+                                  << std::fixed << std::setprecision(1) << seconds << "s. Waiting for changes...\n" << std::flush;
+                    }
+                }
+                
+                // Start the next build once the changes have settled
+                if (pending == Action::none || worker.joinable() ||
+                    Clock::now() - last_change < std::chrono::milliseconds(debounce_ms)) {
+                    continue;
+                }
+                const Action action = pending;
+                pending = Action::none;
+                std::cout << "\n[watch] " << reason << ": "
+                          << (action == Action::regenerate ? "regenerating CMakeLists.txt" : action == Action::reconfigure ? "updating the source list" : "building")
+                          << "\n" << std::flush;
+                
+                // Files ctc itself writes are updated here, before the build starts, so the events they cause
+                // are already accounted for and cannot cancel the build
+                build.tree.force_configure = false;
+                if (action == Action::regenerate) {
+                    bool cmake_changed = false;
+                    if (!utils::update_cmake_file(cmake_path, current_project_name(cmake_path), utils::read_libname(libname_path), &cmake_changed)) {
+                        std::cerr << "Failed to update CMakeLists.txt\n";
+                        continue;
+                    }
+                    if (cmake_changed) {
+                        std::cout << "CMakeLists.txt updated from .libname\n";
+                    }
+                    hashes[cmake_path.generic_string()] = utils::hash_content(utils::read_file(cmake_path));
+                } else if (std::filesystem::exists(manifest_path)) {
+                    // Include edits can regroup the lib/ targets too, so the manifest is refreshed for every
+                    // change; it is only rewritten (and CMake only reconfigures) when it actually differs
+                    bool manifest_changed = false;
+                    if (!utils::update_sources_manifest(manifest_path, &manifest_changed)) {
+                        std::cerr << "Failed to update " << manifest_path.generic_string() << "\n";
+                        continue;
+                    }
+                    if (manifest_changed) {
+                        std::cout << "Source list changed; updated " << manifest_path.generic_string() << "\n";
+                    }
+                } else if (action == Action::reconfigure) {
+                    // No explicit source lists (e.g. file(GLOB) in CMakeLists.txt): only configure picks up new files
+                    build.tree.force_configure = true;
+                }
+                
+                build.cancel = false;
+                build.running = true;
+                build_start = Clock::now();
+                worker = std::thread([&build]() {
+                    try {
+                        build_once(build);
+                    } catch (const std::exception& e) {
+                        std::cerr << "Error during build: " << e.what() << "\n";
+                        build.succeeded = false;
+                    }
+                    build.running = false;
+                });
+            }
+            
+            if (worker.joinable()) {
+                build.cancel = true;
+                worker.join();
+            }
+            return 1;
+        }
+    }
+}
@@ -2,12 +2,15 @@
 #include <vector>
 #include <string>
 #include "commands.h"
+#include "timing_utils.h"
+#include "serve_utils.h"
 
 void print_help() {
     std::cout << "CTC - CMake Template Creator\n\n";
     std::cout << "Usage: ctc <command> [options]\n\n";
     std::cout << "Commands:\n";
-    std::cout << "  init [-r]                    Create new project structure (use -r to include README.md)\n\n";
+    std::cout << "  init [-r] [-b]               Create new project structure (use -r to include README.md,\n";
+    std::cout << "                               -b to add bench/ with the benchmark harness)\n\n";
     std::cout << "  install <package>            Add package to .libname file\n";
     std::cout << "  install <pkg>:<component>    Add package component (used as pkg::component)\n";
     std::cout << "  install <pkg> -c <comp> [-c <comp> ...]  Add one or more components for a package\n";
@@ -15,7 +18,10 @@ void print_help() {
     std::cout << "  install -l <library-name>    Add library to link\n";
     std::cout << "  install -I <include-path>    Add include directory\n";
     std::cout << "  install -T <toolchain-file>  Set CMAKE_TOOLCHAIN_FILE path\n";
-    std::cout << "  install -A <map>             Add link override mapping (<pkg>[::<component>]=<custom>)\n\n";
+    std::cout << "  install -A <map>             Add link override mapping (<pkg>[::<component>]=<custom>)\n";
+    std::cout << "  install -C [<launcher>]      Enable compiler cache (auto, ccache, sccache; default: auto), replacing the one set\n";
+    std::cout << "                               A launcher path must contain a '/'; other words are packages\n";
+    std::cout << "  install <op> <op> ...        Apply several of the above in one locked update of .libname\n\n";
     std::cout << "  uninstall <package>          Remove package from .libname file\n";
     std::cout << "  uninstall <pkg>:<component>  Remove package component\n";
     std::cout << "  uninstall <pkg> -c <comp> [-c <comp> ...] Remove one or more components for a package\n";
@@ -23,15 +29,83 @@ void print_help() {
     std::cout << "  uninstall -l <library-name>  Remove library to link\n";
     std::cout << "  uninstall -I <include-path>  Remove include directory\n";
     std::cout << "  uninstall -T <toolchain-file> Remove CMAKE_TOOLCHAIN_FILE path\n";
-    std::cout << "  uninstall -A <map>            Remove link override mapping\n\n";
+    std::cout << "  uninstall -A <map>            Remove link override mapping\n";
+    std::cout << "  uninstall -C [<launcher>]     Disable compiler cache (any that is set, without <launcher>)\n";
+    std::cout << "  uninstall --unity-exclude <file> Remove a file from the unity build opt-out list\n";
+    std::cout << "  uninstall <op> <op> ...       Remove several of the above in one locked update of .libname\n\n";
     std::cout << "  apply [-n <name>]            Update CMakeLists.txt with dependencies (no build)\n";
-    std::cout << "                               Use -n to specify project name (default: my_project)\n\n";
-    std::cout << "  run [-n <name>] [-m <mode>] [-k|--keep-build] [-U]  Build project using CMake\n";
+    std::cout << "                               Use -n to specify project name (default: my_project)\n";
+    std::cout << "                               Build settings (saved in .libname, also accepted by run):\n";
+    std::cout << "                                 --unity [<batch>]        Enable unity build (default batch size: 8)\n";
+    std::cout << "                                 --no-unity               Disable unity build\n";
+    std::cout << "                                 --unity-exclude <file>   Keep a source file out of unity batches\n";
+    std::cout << "                                 --lto [thin|full]        Enable link-time optimization (default: thin)\n";
+    std::cout << "                                 --no-lto                 Disable link-time optimization\n";
+    std::cout << "                                 --app-targets            One executable per app/<name>.cpp or app/<name>/\n";
+    std::cout << "                                                          (<name>: letters, digits and _.+-), each linking all of lib/\n";
+    std::cout << "                                 --no-app-targets         One executable from all of app/ (default)\n\n";
+    std::cout << "  run [-n <name>] [-m <mode>] [-j <jobs>] [-G <generator>] [--clean] [--reconfigure] [-U] [--timings] [-t <target>]  Build project using CMake\n";
     std::cout << "                               Use -n to specify project name (default: my_project)\n";
     std::cout << "                               Use -m to specify build mode (default: Release)\n";
-    std::cout << "                               Use -k/--keep-build to keep the build directory after build\n";
+    std::cout << "                               Use -m Debug,Release to build several modes concurrently into bin/<mode>/\n";
+    std::cout << "                               Build trees are kept per mode in build/<mode> and reused\n";
+    std::cout << "                               Use --clean to remove the build tree and start fresh\n";
+    std::cout << "                               Use -j/--jobs to override the parallel job count (default: usable cores)\n";
+    std::cout << "                               Use -G/--generator to choose the CMake generator (default: Ninja if found)\n";
+    std::cout << "                               Configure is skipped when its inputs are unchanged; --reconfigure forces it\n";
     std::cout << "                               Use -U/--update-cmake to update CMakeLists.txt before build\n";
+    std::cout << "                               Build settings such as --unity or --lto imply -U\n";
+    std::cout << "                               Use --timings for per-phase and per-file build times (table and\n";
+    std::cout << "                               Chrome trace in .ctc/timings.json; templates too under Clang)\n";
+    std::cout << "                               Use -t/--target to build only bin/<target> and the libraries it uses\n";
+    std::cout << "                               (needs --app-targets)\n";
     std::cout << "                               Valid modes: Debug, Release, MinSizeRel, RelWithDebInfo\n\n";
+    std::cout << "  watch [-m <mode>] [-j <jobs>] [-G <generator>] [-t <target>] [--debounce <ms>]\n";
+    std::cout << "                               Rebuild whenever app/, lib/, include/, bench/, .libname or CMakeLists.txt\n";
+    std::cout << "                               change (Linux inotify). Saves are batched for --debounce ms (default: 200);\n";
+    std::cout << "                               a build still running when new edits arrive is cancelled and restarted\n\n";
+    std::cout << "  serve [--status | --stop]    Keep a local daemon running (Linux) that 'ctc run', 'ctc apply' and 'ctc list'\n";
+    std::cout << "                               hand their work to: it watches the projects it has seen and answers a repeated\n";
+    std::cout << "                               apply with nothing changed in milliseconds (run always builds).\n";
+    std::cout << "                               Set CTC_NO_SERVE=1 to bypass it\n\n";
+    std::cout << "  bench [--init] [-j <jobs>] [-G <generator>] [--filter <text>] [--samples <n>]\n";
+    std::cout << "        [--warmup-ms <ms>] [--sample-ms <ms>]\n";
+    std::cout << "                               Build bench/ in Release mode and run the benchmarks\n";
+    std::cout << "                               Reports median/p99 ns per operation; results go to .ctc/bench/latest.json\n";
+    std::cout << "                               Use --init to add bench/ to an existing project\n";
+    std::cout << "        [--save [<name>]] [--compare <name>] [--threshold <percent>] [--list]\n";
+    std::cout << "                               Use --save to keep the results as a named set (default: git commit)\n";
+    std::cout << "                               Use --compare to test against a saved set (Mann-Whitney U); exits\n";
+    std::cout << "                               non-zero if a benchmark is slower by more than --threshold (default: 5%)\n\n";
+    std::cout << "  profile [-j <jobs>] [-G <generator>] [-F <hz>] [-t <target>] [-- <program arguments>]\n";
+    std::cout << "                               Build with -O2 -g -fno-omit-frame-pointer (build/profile), run the\n";
+    std::cout << "                               executable and sample its call stacks (Linux perf_event_open, no perf needed)\n";
+    std::cout << "                               Writes folded stacks and an SVG flame graph to .ctc/profile/\n";
+    std::cout << "                               With --app-targets, -t picks the executable to profile (required)\n\n";
+    std::cout << "  stat [-r <runs>] [--instructions] [-q] [-j <jobs>] [-G <generator>] [-t <target>] [-- <program arguments>]\n";
+    std::cout << "        [--save [<name>]] [--compare <name>] [--threshold <percent>]\n";
+    std::cout << "                               Build in Release mode, run the executable -r times (default: 5) and read\n";
+    std::cout << "                               cycles, instructions, IPC, cache/branch misses and page faults (mean +- stddev)\n";
+    std::cout << "                               Use --instructions to count instructions only, a near noise-free CI signal\n";
+    std::cout << "                               Use -q to discard the program's output; results go to .ctc/stat/latest.json\n";
+    std::cout << "                               --compare exits non-zero if instructions grew by more than --threshold (default: 2%)\n";
+    std::cout << "                               With --app-targets, -t picks the executable to count (required)\n\n";
+    std::cout << "  pgo [-j <jobs>] [-G <generator>] [--retrain] -- <training command>\n";
+    std::cout << "                               Profile-guided optimization: instrumented build, training run,\n";
+    std::cout << "                               profile merge and optimized rebuild into bin/\n";
+    std::cout << "                               The instrumented build stays in build/pgo-instrument/bin; bin/ in the\n";
+    std::cout << "                               training command is redirected there ($CTC_PGO_BIN_DIR names it)\n";
+    std::cout << "                               Profiles are kept in .ctc/pgo/ and reused while sources are unchanged\n\n";
+    std::cout << "  analyze includes [-m <mode>] [-j <jobs>] [-G <generator>] [--top <n>] [--sort bytes|tus|fanout] [--project]\n";
+    std::cout << "                               Preprocess every translation unit of app/ and lib/ (compile_commands.json of\n";
+    std::cout << "                               build/<mode>) and rank headers by the TUs that include them, the preprocessed\n";
+    std::cout << "                               bytes they add and their fan-out; flags PCH candidates and headers that cost\n";
+    std::cout << "                               mostly through their own includes. Full graph in .ctc/analyze/includes.json\n\n";
+    std::cout << "  pch [--top <n>] [--min <n>] [--off]  Generate a precompiled header from include usage\n";
+    std::cout << "                               Collects the most used system/third-party headers into .ctc/pch.h\n";
+    std::cout << "                               Use --top for the maximum number of headers (default: 20)\n";
+    std::cout << "                               Use --min for the minimum number of including files (default: 2)\n";
+    std::cout << "                               Use --off to stop using the precompiled header\n\n";
     std::cout << "  list                         Show all dependencies in .libname file\n\n";
     std::cout << "  help                         Show this help message\n\n";
     std::cout << "Note: Use 'ctc apply' to update CMakeLists.txt, or 'ctc run' to update and build.\n";
@@ -52,6 +126,14 @@ int main(int argc, char* argv[]) {
     }
 
     try {
+        // A running 'ctc serve' takes these over; without one they run here as usual
+        if (command == "run" || command == "apply" || command == "list") {
+            int status = 0;
+            if (ctc::utils::forward_to_server(command, args, status)) {
+                return status;
+            }
+        }
+        
         if (command == "init") {
             return ctc::commands::init_command(args);
         } else if (command == "install") {
@@ -62,6 +144,25 @@ int main(int argc, char* argv[]) {
             return ctc::commands::apply_command(args);
         } else if (command == "run") {
             return ctc::commands::run_command(args);
+        } else if (command == "bench") {
+            return ctc::commands::bench_command(args);
+        } else if (command == "profile") {
+            return ctc::commands::profile_command(args);
+        } else if (command == "stat") {
+            return ctc::commands::stat_command(args);
+        } else if (command == "watch") {
+            return ctc::commands::watch_command(args);
+        } else if (command == "serve") {
+            return ctc::commands::serve_command(args);
+        } else if (command == "pgo") {
+            return ctc::commands::pgo_command(args);
+        } else if (command == "analyze") {
+            return ctc::commands::analyze_command(args);
+        } else if (command == "pch") {
+            return ctc::commands::pch_command(args);
+        } else if (command == "__time-compile") {
+            // Internal: compile/link wrapper installed by 'ctc run --timings'
+            return ctc::utils::run_timed_command(args);
         } else if (command == "list") {
             return ctc::commands::list_command(args);
         } else if (command == "help" || command == "--help" || command == "-h") {
@@ -0,0 +1,315 @@
+#include "analyze_utils.h"
+#include "file_utils.h"
+#include <cctype>
+#include <cstdlib>
+
+namespace ctc {
+    namespace utils {
+        
+        namespace {
+            void skip_whitespace(const std::string& text, size_t& pos) {
+                while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+            }
+            
+            // A JSON string starting at the opening quote; pos ends up after the closing one
+            bool read_json_string(const std::string& text, size_t& pos, std::string& value) {
+                if (pos >= text.size() || text[pos] != '"') return false;
+                value.clear();
+                for (++pos; pos < text.size(); ++pos) {
+                    char c = text[pos];
+                    if (c == '"') {
+                        ++pos;
+                        return true;
+                    }
+                    if (c != '\\' || pos + 1 >= text.size()) {
+                        value += c;
+                        continue;
+                    }
+                    c = text[++pos];
+                    switch (c) {
+                        case 'n': value += '\n'; break;
+                        case 't': value += '\t'; break;
+                        case 'r': value += '\r'; break;
+                        case 'b': value += '\b'; break;
+                        case 'f': value += '\f'; break;
+                        case 'u': {
+                            if (pos + 4 >= text.size()) return false;
+                            const unsigned code = static_cast<unsigned>(std::strtoul(text.substr(pos + 1, 4).c_str(), nullptr, 16));
+                            pos += 4;
+                            // UTF-8; surrogate pairs do not occur in paths and flags worth supporting here
+                            if (code < 0x80) {
+                                value += static_cast<char>(code);
+                            } else if (code < 0x800) {
+                                value += static_cast<char>(0xC0 | (code >> 6));
+                                value += static_cast<char>(0x80 | (code & 0x3F));
+                            } else {
+                                value += static_cast<char>(0xE0 | (code >> 12));
+                                value += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                                value += static_cast<char>(0x80 | (code & 0x3F));
+                            }
+                            break;
+                        }
+                        default: value += c; break;  // \" \\ \/
+                    }
+                }
+                return false;
+            }
+            
+            // Skip a value other than a string or an array of strings (numbers, true, nested objects, ...)
+            void skip_json_value(const std::string& text, size_t& pos) {
+                int depth = 0;
+                std::string ignored;
+                while (pos < text.size()) {
+                    const char c = text[pos];
+                    if (c == '"') {
+                        if (!read_json_string(text, pos, ignored)) return;
+                        continue;
+                    }
+                    if (c == '{' || c == '[') {
+                        ++depth;
+                    } else if (c == '}' || c == ']') {
+                        if (depth == 0) return;
+                        --depth;
+                    } else if (c == ',' && depth == 0) {
+                        return;
+                    }
+                    ++pos;
+                }
+            }
+            
+            // One object of the top-level array; pos ends up after its closing brace
+            bool read_compile_command(const std::string& text, size_t& pos, CompileCommand& entry) {
+                if (pos >= text.size() || text[pos] != '{') return false;
+                ++pos;
+                std::string command;
+                while (true) {
+                    skip_whitespace(text, pos);
+                    if (pos < text.size() && text[pos] == '}') {
+                        ++pos;
+                        break;
+                    }
+                    std::string key;
+                    if (!read_json_string(text, pos, key)) return false;
+                    skip_whitespace(text, pos);
+                    if (pos >= text.size() || text[pos] != ':') return false;
+                    ++pos;
+                    skip_whitespace(text, pos);
+                    
+                    std::string value;
+                    if (key == "arguments" && pos < text.size() && text[pos] == '[') {
+                        ++pos;
+                        while (true) {
+                            skip_whitespace(text, pos);
+                            if (pos < text.size() && text[pos] == ']') {
+                                ++pos;
+                                break;
+                            }
+                            if (!read_json_string(text, pos, value)) return false;
+                            entry.arguments.push_back(value);
+                            skip_whitespace(text, pos);
+                            if (pos < text.size() && text[pos] == ',') ++pos;
+                        }
+                    } else if (pos < text.size() && text[pos] == '"') {
+                        if (!read_json_string(text, pos, value)) return false;
+                        if (key == "directory") entry.directory = value;
+                        else if (key == "file") entry.file = value;
+                        else if (key == "command") command = value;
+                    } else {
+                        skip_json_value(text, pos);
+                    }
+                    skip_whitespace(text, pos);
+                    if (pos < text.size() && text[pos] == ',') ++pos;
+                }
+                if (entry.arguments.empty()) {
+                    entry.arguments = split_command_line(command);
+                }
+                // Relative file names are relative to the entry's directory
+                if (!entry.file.empty() && entry.file.is_relative()) {
+                    entry.file = entry.directory / entry.file;
+                }
+                return !entry.arguments.empty() && !entry.file.empty();
+            }
+            
+            // Options (and the ones taking a separate value) that must not reach the preprocess-only command
+            bool is_dropped_option(const std::string& arg, bool& takes_value) {
+                takes_value = arg == "-o" || arg == "-MF" || arg == "-MT" || arg == "-MQ";
+                if (takes_value || arg == "-c" || arg == "-MD" || arg == "-MMD") {
+                    return true;
+                }
+                // -MF<file>, -MT<target>, -MQ<target>
+                return arg.size() > 3 && (arg.compare(0, 3, "-MF") == 0 || arg.compare(0, 3, "-MT") == 0 || arg.compare(0, 3, "-MQ") == 0);
+            }
+        }
+        
+        std::vector<CompileCommand> read_compile_commands(const std::filesystem::path& path) {
+            std::vector<CompileCommand> commands;
+            const std::string text = read_file(path);
+            size_t pos = 0;
+            skip_whitespace(text, pos);
+            if (pos >= text.size() || text[pos] != '[') {
+                return commands;
+            }
+            ++pos;
+            while (true) {
+                skip_whitespace(text, pos);
+                if (pos >= text.size() || text[pos] == ']') {
+                    break;
+                }
+                CompileCommand entry;
+                if (!read_compile_command(text, pos, entry)) {
+                    return {};
+                }
+                commands.push_back(std::move(entry));
+                skip_whitespace(text, pos);
+                if (pos < text.size() && text[pos] == ',') ++pos;
+            }
+            return commands;
+        }
+        
+        std::vector<std::string> split_command_line(const std::string& command) {
+            std::vector<std::string> arguments;
+            std::string current;
+            bool in_argument = false;
+            char quote = 0;
+            for (size_t i = 0; i < command.size(); ++i) {
+                const char c = command[i];
+                if (quote == '\'') {
+                    if (c == '\'') quote = 0;
+                    else current += c;
+                } else if (quote == '"') {
+                    if (c == '"') {
+                        quote = 0;
+                    } else if (c == '\\' && i + 1 < command.size() && (command[i + 1] == '"' || command[i + 1] == '\\')) {
+                        current += command[++i];
+                    } else {
+                        current += c;
+                    }
+                } else if (std::isspace(static_cast<unsigned char>(c))) {
+                    if (in_argument) arguments.push_back(current);
+                    current.clear();
+                    in_argument = false;
+                } else {
+                    in_argument = true;
+                    if (c == '"' || c == '\'') quote = c;
+                    else if (c == '\\' && i + 1 < command.size()) current += command[++i];
+                    else current += c;
+                }
+            }
+            if (in_argument) arguments.push_back(current);
+            return arguments;
+        }
+        
+        std::vector<std::string> preprocess_arguments(const std::vector<std::string>& arguments) {
+            if (arguments.empty()) {
+                return {};
+            }
+            const std::string compiler = std::filesystem::path(arguments[0]).stem().string();
+            if (compiler == "cl" || compiler == "clang-cl") {
+                return {};
+            }
+            std::vector<std::string> result = {arguments[0]};
+            for (size_t i = 1; i < arguments.size(); ++i) {
+                bool takes_value = false;
+                if (is_dropped_option(arguments[i], takes_value)) {
+                    if (takes_value) ++i;
+                    continue;
+                }
+                result.push_back(arguments[i]);
+            }
+            result.push_back("-E");
+            return result;
+        }
+        
+        TranslationUnitIncludes parse_preprocessed_output(const std::string& file, const std::string& output) {
+            TranslationUnitIncludes unit;
+            unit.file = file;
+            
+            // Files currently open, innermost last; "" is the translation unit itself
+            struct OpenFile {
+                std::string name;
+                unsigned long long bytes = 0;
+            };
+            std::vector<OpenFile> open = {{"", 0}};
+            std::string root_name;
+            auto close_innermost = [&]() {
+                const OpenFile done = open.back();
+                open.pop_back();
+                unit.headers[done.name].total_bytes += done.bytes;
+                open.back().bytes += done.bytes;
+            };
+            
+            size_t pos = 0;
+            while (pos < output.size()) {
+                size_t end = output.find('\n', pos);
+                if (end == std::string::npos) end = output.size();
+                const size_t length = end - pos;
+                
+                // Line marker: # <line> "<file>" [flags]
+                if (length > 2 && output[pos] == '#' && output[pos + 1] == ' ' && std::isdigit(static_cast<unsigned char>(output[pos + 2]))) {
+                    const std::string line = output.substr(pos, length);
+                    size_t cursor = line.find('"');
+                    std::string name;
+                    bool closed = false;
+                    for (++cursor; cursor < line.size(); ++cursor) {
+                        if (line[cursor] == '\\' && cursor + 1 < line.size()) {
+                            name += line[++cursor];
+                        } else if (line[cursor] == '"') {
+                            closed = true;
+                            ++cursor;
+                            break;
+                        } else {
+                            name += line[cursor];
+                        }
+                    }
+                    if (closed) {
+                        if (root_name.empty()) root_name = name;
+                        const std::string flags = line.substr(cursor);
+                        const bool entering = flags.find(" 1") == 0;
+                        const bool returning = flags.find(" 2") == 0;
+                        // <built-in>, <command-line> and the TU's own name all stand for the TU
+                        const std::string target = (name.empty() || name[0] == '<' || name == root_name) ? "" : name;
+                        if (entering && !target.empty()) {
+                            const std::string& parent = open.back().name;
+                            IncludedHeader& header = unit.headers[target];
+                            header.included_by.insert(parent.empty() ? file : parent);
+                            if (!parent.empty()) unit.headers[parent].includes.insert(target);
+                            open.push_back({target, 0});
+                        } else if (returning) {
+                            while (open.size() > 1 && open.back().name != target) close_innermost();
+                        }
+                    }
+                } else {
+                    const unsigned long long bytes = length + 1;
+                    open.back().bytes += bytes;
+                    if (open.size() > 1) unit.headers[open.back().name].own_bytes += bytes;
+                    unit.bytes += bytes;
+                }
+                pos = end + 1;
+            }
+            while (open.size() > 1) {
+                close_innermost();
+            }
+            return unit;
+        }
+        
+        std::vector<HeaderCost> aggregate_header_costs(const std::vector<TranslationUnitIncludes>& units) {
+            std::map<std::string, HeaderCost> costs;
+            for (const auto& unit : units) {
+                for (const auto& entry : unit.headers) {
+                    HeaderCost& cost = costs[entry.first];
+                    cost.header = entry.first;
+                    ++cost.translation_units;
+                    cost.own_bytes += entry.second.own_bytes;
+                    cost.total_bytes += entry.second.total_bytes;
+                    cost.includes.insert(entry.second.includes.begin(), entry.second.includes.end());
+                    cost.included_by.insert(entry.second.included_by.begin(), entry.second.included_by.end());
+                }
+            }
+            std::vector<HeaderCost> result;
+            for (auto& entry : costs) {
+                result.push_back(std::move(entry.second));
+            }
+            return result;
+        }
+    }
+}
@@ -0,0 +1,319 @@
+#include "artifact_utils.h"
+#include "file_utils.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#endif
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace ctc {
+    namespace utils {
+        
+        namespace {
+            // What was published to one destination, and from which build output
+            struct ManifestEntry {
+                long long source_mtime = 0;
+                unsigned long long source_size = 0;
+                unsigned long long hash = 0;
+                long long destination_mtime = 0;
+            };
+            
+            long long file_mtime(const std::filesystem::path& path) {
+                std::error_code ec;
+                auto time = std::filesystem::last_write_time(path, ec);
+                return ec ? 0 : static_cast<long long>(time.time_since_epoch().count());
+            }
+            
+            // Manifest line: <destination>\t<source mtime>\t<source size>\t<hash>\t<destination mtime>
+            std::map<std::string, ManifestEntry> read_manifest(const std::filesystem::path& manifest_path) {
+                std::map<std::string, ManifestEntry> manifest;
+                for (const auto& line : read_lines(manifest_path)) {
+                    std::istringstream in(line);
+                    std::string destination, field;
+                    ManifestEntry entry;
+                    // A damaged line only means that executable is published again
+                    if (!std::getline(in, destination, '\t')) continue;
+                    if (!std::getline(in, field, '\t') || !parse_integer(field, entry.source_mtime)) continue;
+                    if (!std::getline(in, field, '\t') || !parse_integer(field, entry.source_size)) continue;
+                    if (!std::getline(in, field, '\t') || !parse_integer(field, entry.hash)) continue;
+                    if (!std::getline(in, field, '\t') || !parse_integer(field, entry.destination_mtime)) continue;
+                    manifest[destination] = entry;
+                }
+                return manifest;
+            }
+            
+            void write_manifest(const std::filesystem::path& manifest_path, const std::map<std::string, ManifestEntry>& manifest) {
+                std::vector<std::string> lines;
+                for (const auto& kv : manifest) {
+                    const ManifestEntry& entry = kv.second;
+                    lines.push_back(kv.first + "\t" + std::to_string(entry.source_mtime) + "\t" + std::to_string(entry.source_size) +
+                                    "\t" + std::to_string(entry.hash) + "\t" + std::to_string(entry.destination_mtime));
+                }
+                write_lines(manifest_path, lines);
+            }
+            
+            // FNV-1a over 8-byte words (bytes for the tail): executables can be hundreds of MB,
+            // so this runs about eight times faster than hash_content's byte-wise loop
+            bool hash_file(const std::filesystem::path& path, unsigned long long& hash) {
+                std::ifstream in(path, std::ios::binary);
+                if (!in) {
+                    return false;
+                }
+                hash = 14695981039346656037ULL;
+                std::vector<char> buffer(1 << 20);
+                while (in) {
+                    in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                    const size_t count = static_cast<size_t>(in.gcount());
+                    size_t i = 0;
+                    for (; i + 8 <= count; i += 8) {
+                        std::uint64_t word;
+                        std::memcpy(&word, buffer.data() + i, 8);
+                        hash ^= word;
+                        hash *= 1099511628211ULL;
+                    }
+                    for (; i < count; ++i) {
+                        hash ^= static_cast<unsigned char>(buffer[i]);
+                        hash *= 1099511628211ULL;
+                    }
+                }
+                return in.eof();
+            }
+            
+            std::uint64_t read_unsigned(const unsigned char* bytes, size_t size, bool big_endian) {
+                std::uint64_t value = 0;
+                for (size_t i = 0; i < size; ++i) {
+                    value |= static_cast<std::uint64_t>(bytes[big_endian ? size - 1 - i : i]) << (8 * i);
+                }
+                return value;
+            }
+            
+            // ET_EXEC, or ET_DYN with a PT_INTERP program header (a position-independent executable
+            // rather than a shared library)
+            bool is_elf_executable(std::ifstream& in, const unsigned char* header) {
+                const bool is_64 = header[4] == 2;
+                const bool big_endian = header[5] == 2;
+                const std::uint64_t type = read_unsigned(header + 16, 2, big_endian);
+                if (type == 2) {
+                    return true;
+                }
+                if (type != 3) {
+                    return false;
+                }
+                const std::uint64_t phoff = read_unsigned(header + (is_64 ? 32 : 28), is_64 ? 8 : 4, big_endian);
+                const std::uint64_t phentsize = read_unsigned(header + (is_64 ? 54 : 42), 2, big_endian);
+                const std::uint64_t phnum = read_unsigned(header + (is_64 ? 56 : 44), 2, big_endian);
+                if (phentsize < 4 || phnum > 4096) {
+                    return false;
+                }
+                std::vector<unsigned char> headers(phentsize * phnum);
+                in.clear();
+                in.seekg(static_cast<std::streamoff>(phoff));
+                if (!in.read(reinterpret_cast<char*>(headers.data()), static_cast<std::streamsize>(headers.size()))) {
+                    return false;
+                }
+                for (std::uint64_t i = 0; i < phnum; ++i) {
+                    if (read_unsigned(headers.data() + i * phentsize, 4, big_endian) == 3) { // PT_INTERP
+                        return true;
+                    }
+                }
+                return false;
+            }
+            
+            // Clone source into destination (which must not exist) sharing its blocks. Linux only.
+            // Clone source into the empty file open as out, with source's mode
+            bool reflink_file(const std::filesystem::path& source, int out) {
+#if defined(__linux__) && defined(FICLONE)
+                const int in = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+                if (in < 0) {
+                    return false;
+                }
+                struct stat info;
+                const bool ok = fstat(in, &info) == 0 && ioctl(out, FICLONE, in) == 0 && fchmod(out, info.st_mode & 07777) == 0;
+                close(in);
+                return ok;
+#else
+                (void)source;
+                (void)out;
+                return false;
+#endif
+            }
+            
+            // Put source at destination through a temporary file renamed over it
+            bool publish_file(const std::filesystem::path& source, const std::filesystem::path& destination,
+                              PublishMethod& method, std::string& error) {
+                std::error_code ec;
+#ifndef _WIN32
+                // A unique name, so concurrent publishers of the same destination never share one temporary
+                std::string temp_name = destination.string() + ".ctc-tmp-XXXXXX";
+                const int fd = mkstemp(temp_name.data());
+                if (fd < 0) {
+                    error = std::strerror(errno);
+                    return false;
+                }
+                const std::filesystem::path temp_path = temp_name;
+                const bool cloned = reflink_file(source, fd);
+                close(fd);
+#else
+                std::filesystem::path temp_path = destination;
+                temp_path += ".ctc-tmp";
+                const bool cloned = false;
+#endif
+                
+                // A hard link is as cheap as a clone, but shares later in-place writes to the build
+                // output. Linkers write a new file instead, so this only matters when the clone fails.
+                // Linking and copying need the name to be free, so the reserved file makes way for them.
+                if (cloned) {
+                    method = PublishMethod::reflink;
+                } else if (std::filesystem::remove(temp_path, ec), std::filesystem::create_hard_link(source, temp_path, ec), !ec) {
+                    method = PublishMethod::hardlink;
+                } else {
+                    std::filesystem::copy_file(source, temp_path, ec);
+                    if (ec) {
+                        error = ec.message();
+                        std::filesystem::remove(temp_path, ec);
+                        return false;
+                    }
+                    method = PublishMethod::copy;
+                }
+                
+                std::filesystem::rename(temp_path, destination, ec);
+                if (ec) {
+                    error = ec.message();
+                    std::filesystem::remove(temp_path, ec);
+                    return false;
+                }
+                return true;
+            }
+        }
+        
+        const char* publish_method_name(PublishMethod method) {
+            switch (method) {
+                case PublishMethod::unchanged: return "unchanged";
+                case PublishMethod::reflink: return "reflink";
+                case PublishMethod::hardlink: return "hardlink";
+                case PublishMethod::copy: return "copy";
+            }
+            return "";
+        }
+        
+        bool is_executable_artifact(const std::filesystem::path& path) {
+            std::error_code ec;
+            const std::filesystem::file_status status = std::filesystem::status(path, ec);
+            if (ec || !std::filesystem::is_regular_file(status)) {
+                return false;
+            }
+            std::ifstream in(path, std::ios::binary);
+            unsigned char header[64] = {};
+            in.read(reinterpret_cast<char*>(header), sizeof(header));
+            const size_t count = static_cast<size_t>(in.gcount());
+#ifdef _WIN32
+            return path.extension() == ".exe" && count >= 2 && header[0] == 'M' && header[1] == 'Z';
+#else
+            const auto exec_bits = std::filesystem::perms::owner_exec | std::filesystem::perms::group_exec |
+                                   std::filesystem::perms::others_exec;
+            if ((status.permissions() & exec_bits) == std::filesystem::perms::none) {
+                return false;
+            }
+            if (count == sizeof(header) && std::memcmp(header, "\x7f" "ELF", 4) == 0) {
+                return is_elf_executable(in, header);
+            }
+            if (count >= 16) {
+                // Mach-O (32/64-bit, either byte order) with filetype MH_EXECUTE
+                const std::uint64_t magic = read_unsigned(header, 4, false);
+                if (magic == 0xfeedfaceULL || magic == 0xfeedfacfULL) {
+                    return read_unsigned(header + 12, 4, false) == 2;
+                }
+                if (magic == 0xcefaedfeULL || magic == 0xcffaedfeULL) {
+                    return read_unsigned(header + 12, 4, true) == 2;
+                }
+            }
+            return false;
+#endif
+        }
+        
+        std::vector<PublishedArtifact> publish_executables(const std::filesystem::path& from_dir,
+                                                           const std::filesystem::path& output_dir,
+                                                           const std::filesystem::path& manifest_path) {
+            std::vector<PublishedArtifact> published;
+            std::error_code ec;
+            if (!std::filesystem::is_directory(from_dir, ec) || std::filesystem::equivalent(from_dir, output_dir, ec)) {
+                return published;
+            }
+            
+            std::map<std::string, ManifestEntry> manifest = read_manifest(manifest_path);
+            bool manifest_changed = false;
+            for (const auto& item : std::filesystem::directory_iterator(from_dir, ec)) {
+                if (!is_executable_artifact(item.path())) {
+                    continue;
+                }
+                PublishedArtifact artifact;
+                artifact.source = item.path();
+                artifact.destination = output_dir / item.path().filename();
+                const std::string key = artifact.destination.generic_string();
+                
+                ManifestEntry current;
+                current.source_mtime = file_mtime(artifact.source);
+                current.source_size = static_cast<unsigned long long>(std::filesystem::file_size(artifact.source, ec));
+                const bool destination_exists = std::filesystem::exists(artifact.destination, ec);
+                const long long destination_mtime = destination_exists ? file_mtime(artifact.destination) : 0;
+                
+                // Already a hard link to the build output
+                if (destination_exists && std::filesystem::equivalent(artifact.source, artifact.destination, ec)) {
+                    artifact.succeeded = true;
+                    published.push_back(artifact);
+                    continue;
+                }
+                
+                // The destination is still what was published last time; compare the build output with it
+                auto recorded = manifest.find(key);
+                const bool destination_intact = recorded != manifest.end() && destination_exists &&
+                                                recorded->second.destination_mtime == destination_mtime;
+                if (destination_intact && recorded->second.source_mtime == current.source_mtime &&
+                    recorded->second.source_size == current.source_size) {
+                    artifact.succeeded = true;
+                    published.push_back(artifact);
+                    continue;
+                }
+                if (!hash_file(artifact.source, current.hash)) {
+                    artifact.error = "could not read " + artifact.source.generic_string();
+                    published.push_back(artifact);
+                    continue;
+                }
+                if (destination_intact && recorded->second.hash == current.hash) {
+                    // Rewritten by the build with the same content (e.g. relinked after a comment change)
+                    current.destination_mtime = destination_mtime;
+                    manifest[key] = current;
+                    manifest_changed = true;
+                    artifact.succeeded = true;
+                    published.push_back(artifact);
+                    continue;
+                }
+                
+                artifact.succeeded = publish_file(artifact.source, artifact.destination, artifact.method, artifact.error);
+                if (artifact.succeeded) {
+                    current.destination_mtime = file_mtime(artifact.destination);
+                    manifest[key] = current;
+                    manifest_changed = true;
+                }
+                published.push_back(artifact);
+            }
+            
+            if (manifest_changed) {
+                write_manifest(manifest_path, manifest);
+            }
+            return published;
+        }
+    }
+}
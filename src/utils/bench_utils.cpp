@@ -0,0 +1,98 @@
+#include "bench_utils.h"
+#include "result_set_utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+
+namespace ctc {
+    namespace utils {
+        
+        std::vector<BenchmarkResult> read_bench_results(const std::filesystem::path& path) {
+            // The harness writes {"unit": ..., "benchmarks": [{"name": "...", "median_ns": <n>, "samples_ns": [...]}, ...]}
+            std::vector<BenchmarkResult> results;
+            for (auto& record : read_result_records(path, "name")) {
+                BenchmarkResult result;
+                result.name = record.strings["name"];
+                result.median_ns = record.numbers["median_ns"];
+                result.samples_ns = std::move(record.number_arrays["samples_ns"]);
+                results.push_back(std::move(result));
+            }
+            return results;
+        }
+        
+        double mann_whitney_p_value(const std::vector<double>& a, const std::vector<double>& b) {
+            const double n1 = static_cast<double>(a.size());
+            const double n2 = static_cast<double>(b.size());
+            if (a.empty() || b.empty()) return 1;
+            
+            // Rank the pooled samples, giving tied values their average rank
+            std::vector<std::pair<double, bool>> pooled; // value, from a
+            for (double v : a) pooled.emplace_back(v, true);
+            for (double v : b) pooled.emplace_back(v, false);
+            std::sort(pooled.begin(), pooled.end());
+            double rank_sum_a = 0;
+            double tie_term = 0;
+            for (size_t i = 0; i < pooled.size();) {
+                size_t j = i;
+                while (j < pooled.size() && pooled[j].first == pooled[i].first) ++j;
+                const double average_rank = (static_cast<double>(i + 1) + static_cast<double>(j)) / 2;
+                for (size_t k = i; k < j; ++k) {
+                    if (pooled[k].second) rank_sum_a += average_rank;
+                }
+                const double ties = static_cast<double>(j - i);
+                tie_term += ties * ties * ties - ties;
+                i = j;
+            }
+            
+            const double n = n1 + n2;
+            const double u = rank_sum_a - n1 * (n1 + 1) / 2;
+            const double mean = n1 * n2 / 2;
+            const double variance = n1 * n2 / 12 * ((n + 1) - tie_term / (n * (n - 1)));
+            if (variance <= 0) return 1;
+            const double distance = std::max(0.0, std::fabs(u - mean) - 0.5);
+            return std::erfc(distance / std::sqrt(variance) / std::sqrt(2.0));
+        }
+        
+        std::vector<BenchmarkComparison> compare_bench_results(const std::vector<BenchmarkResult>& baseline,
+                                                               const std::vector<BenchmarkResult>& current,
+                                                               double alpha, double threshold_percent) {
+            std::map<std::string, const BenchmarkResult*> baseline_by_name;
+            for (const auto& result : baseline) baseline_by_name[result.name] = &result;
+            
+            std::vector<BenchmarkComparison> comparisons;
+            for (const auto& result : current) {
+                BenchmarkComparison comparison;
+                comparison.name = result.name;
+                comparison.current_ns = result.median_ns;
+                auto it = baseline_by_name.find(result.name);
+                if (it == baseline_by_name.end()) {
+                    comparison.verdict = "new";
+                } else {
+                    const BenchmarkResult& base = *it->second;
+                    comparison.baseline_ns = base.median_ns;
+                    if (base.median_ns > 0) {
+                        comparison.change_percent = (result.median_ns - base.median_ns) / base.median_ns * 100;
+                    }
+                    comparison.p_value = mann_whitney_p_value(base.samples_ns, result.samples_ns);
+                    if (comparison.p_value >= alpha) {
+                        comparison.verdict = "noise";
+                    } else {
+                        comparison.verdict = comparison.change_percent > 0 ? "slower" : "faster";
+                        comparison.regression = comparison.change_percent > threshold_percent;
+                    }
+                    baseline_by_name.erase(it);
+                }
+                comparisons.push_back(comparison);
+            }
+            for (const auto& entry : baseline_by_name) {
+                BenchmarkComparison comparison;
+                comparison.name = entry.first;
+                comparison.baseline_ns = entry.second->median_ns;
+                comparison.verdict = "removed";
+                comparisons.push_back(comparison);
+            }
+            return comparisons;
+        }
+    }
+}
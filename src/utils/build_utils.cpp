@@ -0,0 +1,523 @@
+#include "build_utils.h"
+#include "file_utils.h"
+#include "source_utils.h"
+#include "process_utils.h"
+#include <thread>
+#include <sstream>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ctc {
+    namespace utils {
+        
+        namespace {
+            // Returns the cgroup CPU quota rounded up to whole CPUs, or 0 if unlimited/unknown
+            unsigned read_cgroup_cpu_limit() {
+#ifdef __linux__
+                // cgroup v2: "<quota> <period>" or "max <period>"
+                std::string cpu_max = read_file("/sys/fs/cgroup/cpu.max");
+                if (!cpu_max.empty()) {
+                    std::istringstream in(cpu_max);
+                    std::string quota;
+                    double period = 0;
+                    in >> quota >> period;
+                    if (quota != "max" && period > 0) {
+                        double q = std::atof(quota.c_str());
+                        if (q > 0) return static_cast<unsigned>(std::ceil(q / period));
+                    }
+                    return 0;
+                }
+                
+                // cgroup v1: separate quota and period files, quota is -1 when unlimited
+                std::string quota_str = read_file("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+                std::string period_str = read_file("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+                if (!quota_str.empty() && !period_str.empty()) {
+                    double q = std::atof(quota_str.c_str());
+                    double period = std::atof(period_str.c_str());
+                    if (q > 0 && period > 0) return static_cast<unsigned>(std::ceil(q / period));
+                }
+#endif
+                return 0;
+            }
+            
+            // Tool output of a build tree: relayed as is, or line by line behind the tree's log prefix
+            ProcessOptions tool_output_options(const BuildTreeOptions& options) {
+                ProcessOptions process;
+                process.cancel = options.cancel;
+                if (!options.log_prefix.empty()) {
+                    process.stdout_mode = OutputMode::capture;
+                    process.stderr_mode = OutputMode::capture;
+                    process.on_line = [&options](const OutputLine& line) { print_build_message(options, line.text, line.is_stderr); };
+                }
+                return process;
+            }
+            
+            // Ninja joins a make jobserver (through its FIFO) from version 1.13 on
+            bool ninja_supports_jobserver(const std::filesystem::path& build_dir) {
+                std::string ninja = read_cmake_cache_value(build_dir, "CMAKE_MAKE_PROGRAM");
+                std::string version;
+                if (ninja.empty() || capture_command_output({ninja, "--version"}, version, 10) != 0) {
+                    return false;
+                }
+                unsigned major = 0, minor = 0;
+                std::istringstream in(version);
+                char dot = 0;
+                in >> major >> dot >> minor;
+                return major > 1 || (major == 1 && minor >= 13);
+            }
+        }
+        
+        unsigned detect_job_count(std::string* detail) {
+            unsigned jobs = std::thread::hardware_concurrency();
+            std::string source = "hardware concurrency";
+            
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+                unsigned affinity = static_cast<unsigned>(CPU_COUNT(&set));
+                if (affinity > 0) {
+                    jobs = affinity;
+                    source = "CPU affinity";
+                }
+            }
+#endif
+            
+            unsigned cgroup_limit = read_cgroup_cpu_limit();
+            if (cgroup_limit > 0 && (jobs == 0 || cgroup_limit < jobs)) {
+                jobs = cgroup_limit;
+                source = "cgroup CPU quota";
+            }
+            
+            if (jobs == 0) {
+                jobs = 1;
+                source = "fallback";
+            }
+            if (detail) {
+                *detail = source;
+            }
+            return jobs;
+        }
+        
+        bool parse_job_count(const std::string& value, unsigned& jobs) {
+            // strtoul skips leading whitespace and accepts a sign; neither is a job count
+            if (value.empty() || !std::isdigit(static_cast<unsigned char>(value[0]))) {
+                return false;
+            }
+            char* end = nullptr;
+            errno = 0;
+            const unsigned long parsed = std::strtoul(value.c_str(), &end, 10);
+            if (*end != '\0' || errno == ERANGE || parsed == 0 || parsed > max_job_count) {
+                return false;
+            }
+            jobs = static_cast<unsigned>(parsed);
+            return true;
+        }
+        
+        bool find_program(const std::string& name, std::filesystem::path* found) {
+            const char* path_env = std::getenv("PATH");
+            if (!path_env) {
+                return false;
+            }
+#ifdef _WIN32
+            const char separator = ';';
+            const std::vector<std::string> suffixes = {".exe", ".cmd", ".bat", ""};
+#else
+            const char separator = ':';
+            const std::vector<std::string> suffixes = {""};
+#endif
+            std::stringstream paths(path_env);
+            std::string dir;
+            while (std::getline(paths, dir, separator)) {
+                if (dir.empty()) continue;
+                for (const auto& suffix : suffixes) {
+                    std::filesystem::path candidate = std::filesystem::path(dir) / (name + suffix);
+                    std::error_code ec;
+                    if (std::filesystem::is_regular_file(candidate, ec)) {
+                        if (found) *found = candidate;
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+        
+        std::string read_cmake_cache_value(const std::filesystem::path& build_dir, const std::string& key) {
+            // Cache lines look like KEY:TYPE=VALUE
+            for (const auto& line : read_lines(build_dir / "CMakeCache.txt")) {
+                if (line.compare(0, key.size(), key) != 0 || line.size() <= key.size() || line[key.size()] != ':') {
+                    continue;
+                }
+                auto eq = line.find('=', key.size());
+                if (eq != std::string::npos) {
+                    return line.substr(eq + 1);
+                }
+            }
+            return "";
+        }
+        
+        std::string select_generator(const std::filesystem::path& build_dir, const std::string& requested) {
+            std::string cached = read_cmake_cache_value(build_dir, "CMAKE_GENERATOR");
+            if (!cached.empty()) {
+                return cached;
+            }
+            if (!requested.empty()) {
+                return requested;
+            }
+            if (find_program("ninja")) {
+                return "Ninja";
+            }
+            return "";
+        }
+        
+        std::string compute_configure_fingerprint(const std::filesystem::path& build_dir, const std::string& build_mode,
+                                                  const std::string& generator, const std::vector<std::string>& extra_args) {
+            std::ostringstream inputs;
+            auto add_file = [&inputs](const std::string& label, const std::filesystem::path& path) {
+                inputs << label << "=" << path.generic_string() << ":" << hash_content(read_file(path)) << "\n";
+            };
+            auto add_env = [&inputs](const char* name) {
+                const char* value = std::getenv(name);
+                inputs << name << "=" << (value ? value : "") << "\n";
+            };
+            
+            add_file("cmakelists", "CMakeLists.txt");
+            add_file("sources", "ctc_sources.cmake");
+            for (const auto& entry : read_libname(".libname")) {
+                if (entry.type == DependencyEntry::TOOLCHAIN_FILE) {
+                    add_file("toolchain", entry.value);
+                }
+            }
+            inputs << "mode=" << build_mode << "\n";
+            inputs << "generator=" << generator << "\n";
+            for (const auto& arg : extra_args) {
+                inputs << "arg=" << arg << "\n";
+            }
+            for (const char* name : {"CC", "CXX", "CFLAGS", "CXXFLAGS", "LDFLAGS"}) {
+                add_env(name);
+            }
+            
+            // The compiler binary itself, so that a compiler upgrade triggers a reconfigure
+            std::filesystem::path compiler = read_cmake_cache_value(build_dir, "CMAKE_CXX_COMPILER");
+            const char* cxx = std::getenv("CXX");
+            if (cxx && *cxx) {
+                std::filesystem::path found;
+                compiler = find_program(cxx, &found) ? found : std::filesystem::path(cxx);
+            }
+            std::error_code ec;
+            auto size = std::filesystem::file_size(compiler, ec);
+            auto mtime = std::filesystem::last_write_time(compiler, ec);
+            inputs << "compiler=" << compiler.generic_string() << ":" << (ec ? 0 : size) << ":"
+                   << (ec ? 0 : static_cast<long long>(mtime.time_since_epoch().count())) << "\n";
+            
+            std::ostringstream fingerprint;
+            fingerprint << std::hex << hash_content(inputs.str());
+            return fingerprint.str();
+        }
+        
+        std::string compute_source_fingerprint() {
+            std::vector<std::string> files = list_project_files(project_source_roots(), ".ctc/dir_snapshot");
+            files.push_back("CMakeLists.txt");
+            files.push_back("ctc_sources.cmake");
+            
+            std::ostringstream inputs;
+            for (const auto& file : files) {
+                inputs << file << ":" << hash_content(read_file(file)) << "\n";
+            }
+            std::ostringstream fingerprint;
+            fingerprint << std::hex << hash_content(inputs.str());
+            return fingerprint.str();
+        }
+        
+        std::string read_configure_fingerprint(const std::filesystem::path& build_dir) {
+            std::string fingerprint = read_file(build_dir / "ctc_configure.fingerprint");
+            while (!fingerprint.empty() && (fingerprint.back() == '\n' || fingerprint.back() == '\r')) {
+                fingerprint.pop_back();
+            }
+            return fingerprint;
+        }
+        
+        bool write_configure_fingerprint(const std::filesystem::path& build_dir, const std::string& fingerprint) {
+            return write_file(build_dir / "ctc_configure.fingerprint", fingerprint + "\n");
+        }
+        
+        void print_build_message(const BuildTreeOptions& options, const std::string& message, bool error) {
+            // Concurrent builds print whole lines, each tagged with its build mode
+            static std::mutex output_mutex;
+            std::lock_guard<std::mutex> lock(output_mutex);
+            std::ostream& out = error ? std::cerr : std::cout;
+            std::istringstream lines(message);
+            std::string line;
+            while (std::getline(lines, line)) {
+                out << options.log_prefix << line << "\n";
+            }
+            out << std::flush;
+        }
+        
+        bool create_jobserver(Jobserver& jobserver, const std::filesystem::path& fifo, unsigned tokens) {
+#ifdef _WIN32
+            (void)jobserver;
+            (void)fifo;
+            (void)tokens;
+            return false;
+#else
+            std::error_code ec;
+            std::filesystem::remove(fifo, ec);
+            if (mkfifo(fifo.c_str(), 0600) != 0) {
+                return false;
+            }
+            // Not close-on-exec: make clients inherit the descriptors named in MAKEFLAGS
+            jobserver.fifo = std::filesystem::absolute(fifo);
+            jobserver.read_fd = open(fifo.c_str(), O_RDONLY | O_NONBLOCK);
+            jobserver.write_fd = jobserver.read_fd >= 0 ? open(fifo.c_str(), O_WRONLY) : -1;
+            if (jobserver.write_fd < 0) {
+                close_jobserver(jobserver);
+                return false;
+            }
+            fcntl(jobserver.read_fd, F_SETFL, fcntl(jobserver.read_fd, F_GETFL) & ~O_NONBLOCK);
+            const std::string token_bytes(tokens, '+');
+            if (write(jobserver.write_fd, token_bytes.data(), token_bytes.size()) != static_cast<ssize_t>(token_bytes.size())) {
+                close_jobserver(jobserver);
+                return false;
+            }
+            return true;
+#endif
+        }
+        
+        void close_jobserver(Jobserver& jobserver) {
+#ifndef _WIN32
+            if (jobserver.read_fd >= 0) close(jobserver.read_fd);
+            if (jobserver.write_fd >= 0) close(jobserver.write_fd);
+            std::error_code ec;
+            if (!jobserver.fifo.empty()) std::filesystem::remove(jobserver.fifo, ec);
+#endif
+            jobserver = Jobserver();
+        }
+        
+        bool prepare_build_tree(const BuildTreeOptions& options) {
+            const std::filesystem::path& build_dir = options.build_dir;
+            std::error_code ec;
+            if (options.clean && std::filesystem::exists(build_dir, ec)) {
+                print_build_message(options, "Removing existing build tree " + build_dir.generic_string() + " (--clean)...");
+                std::filesystem::remove_all(build_dir, ec);
+                if (ec) {
+                    print_build_message(options, "Warning: Failed to remove existing build directory: " + ec.message(), true);
+                }
+            }
+            
+            // An explicitly requested generator that differs from the one the tree was
+            // configured with cannot be switched in place, so start that tree over
+            std::string cached_generator = read_cmake_cache_value(build_dir, "CMAKE_GENERATOR");
+            if (!options.generator.empty() && !cached_generator.empty() && options.generator != cached_generator) {
+                print_build_message(options, "Build tree " + build_dir.generic_string() + " uses generator '" + cached_generator +
+                                             "'; recreating it for '" + options.generator + "'...");
+                std::filesystem::remove_all(build_dir, ec);
+                if (ec) {
+                    print_build_message(options, "Failed to remove build directory: " + ec.message(), true);
+                    return false;
+                }
+            }
+            
+            if (std::filesystem::exists(build_dir / "CMakeCache.txt", ec)) {
+                print_build_message(options, "Reusing build tree " + build_dir.generic_string());
+            } else {
+                if (!create_directory_if_not_exists(build_dir)) {
+                    print_build_message(options, "Failed to create build directory", true);
+                    return false;
+                }
+                print_build_message(options, "Created build tree " + build_dir.generic_string());
+            }
+            return true;
+        }
+        
+        bool configure_build_tree(const BuildTreeOptions& options, bool* skipped) {
+            const std::filesystem::path& build_dir = options.build_dir;
+            
+            // The generator is remembered by the tree's CMakeCache.txt; always pass the same
+            // one back so CMake never sees a generator mismatch
+            std::string generator = select_generator(build_dir, options.generator);
+            if (generator.empty()) {
+                print_build_message(options, "Using CMake's default generator (Ninja not found on PATH)");
+            } else {
+                print_build_message(options, "Using generator '" + generator + "'");
+            }
+            
+            // The executable's directory is always passed, so a tree never keeps the one of an earlier
+            // run (CMakeLists.txt files generated before CTC_BIN_DIR existed always use bin/)
+            std::vector<std::string> cmake_args = options.cmake_args;
+            if (read_file("CMakeLists.txt").find("CTC_BIN_DIR") != std::string::npos) {
+                cmake_args.push_back("-DCTC_BIN_DIR=" + std::filesystem::absolute(options.output_dir).generic_string());
+            }
+            // compile_commands.json, for editors (clangd) and 'ctc analyze'; generators without it ignore the flag
+            cmake_args.push_back("-DCMAKE_EXPORT_COMPILE_COMMANDS=ON");
+            
+            // Skip configure if its inputs are identical to the last successful configure of this tree
+            const std::string stored_fingerprint = read_configure_fingerprint(build_dir);
+            if (!options.force_configure && !stored_fingerprint.empty() &&
+                stored_fingerprint == compute_configure_fingerprint(build_dir, options.build_mode, generator, cmake_args)) {
+                print_build_message(options, "Configure skipped (inputs unchanged since the last configure)");
+                if (skipped) *skipped = true;
+                return true;
+            }
+            if (skipped) *skipped = false;
+            
+            // CMAKE_TOOLCHAIN_FILE is embedded in CMakeLists if specified
+            print_build_message(options, "Running cmake with build mode " + options.build_mode + "...");
+            std::error_code ec;
+            std::filesystem::remove(build_dir / "ctc_configure.fingerprint", ec);
+            std::vector<std::string> cmake_command = {"cmake", "-S", ".", "-B", build_dir.generic_string()};
+            if (!generator.empty()) {
+                cmake_command.insert(cmake_command.end(), {"-G", generator});
+            }
+            cmake_command.push_back("-DCMAKE_BUILD_TYPE=" + options.build_mode);
+            cmake_command.insert(cmake_command.end(), cmake_args.begin(), cmake_args.end());
+            const ProcessResult configure = run_process(cmake_command, tool_output_options(options));
+            if (configure.cancelled) {
+                print_build_message(options, "Configure cancelled");
+                return false;
+            }
+            if (!configure.succeeded()) {
+                print_build_message(options, "CMake configuration failed (cmake " + configure.describe() + ")", true);
+                return false;
+            }
+            
+            // Fingerprint with the generator and compiler CMake actually recorded
+            const std::string used_generator = read_cmake_cache_value(build_dir, "CMAKE_GENERATOR");
+            write_configure_fingerprint(build_dir, compute_configure_fingerprint(build_dir, options.build_mode, used_generator, cmake_args));
+            print_build_message(options, "Configure ran");
+            return true;
+        }
+        
+        bool build_build_tree(const BuildTreeOptions& options) {
+            print_build_message(options, "Building project in " + options.build_mode + " mode...");
+            std::vector<std::string> build_command = {"cmake", "--build", options.build_dir.generic_string(), "--config", options.build_mode};
+            ProcessOptions process = tool_output_options(options);
+            const std::string generator = read_cmake_cache_value(options.build_dir, "CMAKE_GENERATOR");
+            std::string makeflags;
+            if (options.jobserver && options.jobserver->read_fd >= 0) {
+                if (generator.find("Makefiles") != std::string::npos) {
+                    makeflags = "-j --jobserver-fds=" + std::to_string(options.jobserver->read_fd) + "," + std::to_string(options.jobserver->write_fd) +
+                                " --jobserver-auth=" + std::to_string(options.jobserver->read_fd) + "," + std::to_string(options.jobserver->write_fd);
+                } else if (generator == "Ninja" && ninja_supports_jobserver(options.build_dir)) {
+                    makeflags = "-j --jobserver-auth=fifo:" + options.jobserver->fifo.string();
+                }
+            }
+            if (!makeflags.empty()) {
+                // No --parallel: an explicit job count would make the build tool ignore the jobserver
+                process.environment = {"MAKEFLAGS=" + makeflags, "CMAKE_BUILD_PARALLEL_LEVEL"};
+            } else {
+                build_command.insert(build_command.end(), {"--parallel", std::to_string(options.jobs)});
+            }
+            if (!options.target.empty()) {
+                build_command.insert(build_command.end(), {"--target", options.target});
+            }
+            // Remember the first compiler or linker error, to repeat it below a long build log
+            OutputLine first_error;
+            const auto print_line = process.on_line;
+            process.on_line = [&first_error, &print_line](const OutputLine& line) {
+                if (print_line) print_line(line);
+                if (first_error.text.empty() && (line.text.find(": error") != std::string::npos ||
+                                                 line.text.find(": fatal error") != std::string::npos ||
+                                                 line.text.find("undefined reference to") != std::string::npos)) {
+                    first_error = line;
+                }
+            };
+            const ProcessResult build = run_process(build_command, process);
+            if (build.cancelled) {
+                print_build_message(options, "Build cancelled");
+                return false;
+            }
+            if (!build.succeeded()) {
+                std::ostringstream message;
+                message << "Build failed (cmake --build " << build.describe() << ")";
+                if (!first_error.text.empty()) {
+                    message << "\nFirst error, " << std::fixed << std::setprecision(1) << first_error.elapsed_seconds
+                            << "s into the build:\n  " << first_error.text;
+                }
+                print_build_message(options, message.str(), true);
+                return false;
+            }
+            return true;
+        }
+        
+        int capture_command_output(const std::vector<std::string>& argv, std::string& output, double timeout_seconds) {
+            ProcessOptions process;
+            process.stdout_mode = OutputMode::capture;
+            process.stderr_mode = OutputMode::discard;
+            process.timeout_seconds = timeout_seconds;
+            const ProcessResult result = run_process(argv, process);
+            output = result.output;
+            return result.status();
+        }
+        
+        CompilerCacheStats read_compiler_cache_stats(const std::filesystem::path& launcher) {
+            CompilerCacheStats stats;
+            const std::string tool = launcher.stem().string();
+            std::string output;
+            // sccache starts its server on demand; never let a stuck server hold up the build report
+            const double stats_timeout_seconds = 10;
+            
+            if (tool == "ccache") {
+                // Machine-readable "<key>\t<value>" lines; key names changed in ccache 4.x
+                if (capture_command_output({launcher.string(), "--print-stats"}, output, stats_timeout_seconds) != 0) {
+                    return stats;
+                }
+                std::istringstream in(output);
+                std::string key;
+                unsigned long long value;
+                while (in >> key >> value) {
+                    if (key == "direct_cache_hit" || key == "preprocessed_cache_hit" ||
+                        key == "cache_hit_direct" || key == "cache_hit_preprocessed") {
+                        stats.hits += value;
+                        stats.valid = true;
+                    } else if (key == "cache_miss") {
+                        stats.misses += value;
+                        stats.valid = true;
+                    }
+                }
+            } else if (tool == "sccache") {
+                // Human-readable table: "Cache hits    12", "Cache misses    3"
+                if (capture_command_output({launcher.string(), "--show-stats"}, output, stats_timeout_seconds) != 0) {
+                    return stats;
+                }
+                std::istringstream in(output);
+                std::string line;
+                while (std::getline(in, line)) {
+                    unsigned long long* counter = nullptr;
+                    size_t prefix = 0;
+                    if (line.compare(0, 11, "Cache hits ") == 0) {
+                        counter = &stats.hits;
+                        prefix = 11;
+                    } else if (line.compare(0, 13, "Cache misses ") == 0) {
+                        counter = &stats.misses;
+                        prefix = 13;
+                    }
+                    if (counter) {
+                        std::istringstream value(line.substr(prefix));
+                        unsigned long long v;
+                        if (value >> v) {
+                            *counter = v;
+                            stats.valid = true;
+                        }
+                    }
+                }
+            }
+            return stats;
+        }
+    }
+}
@@ -5,6 +5,16 @@
 #include <algorithm>
 #include <map>
 #include <set>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace ctc {
     namespace utils {
@@ -19,6 +29,12 @@ namespace ctc {
                 case TOOLCHAIN_FILE: return "TOOLCHAIN:" + value;
                 case LINK_OVERRIDE: return "LINKOVR:" + value; // format: pkg[:component]=customTarget
                 case PACKAGE_COMPONENT: return "PKGCOMP:" + value; // format: pkg:component
+                case COMPILER_LAUNCHER: return "LAUNCHER:" + value; // format: auto | ccache | sccache | <path>
+                case UNITY_BUILD: return "UNITY:" + value; // format: batch size
+                case UNITY_EXCLUDE: return "UNITYSKIP:" + value; // format: source path relative to project root
+                case PCH_HEADER: return "PCH:" + value; // format: header path relative to project root
+                case LTO_MODE: return "LTO:" + value; // format: thin | full
+                case APP_TARGETS: return "APPTARGETS:" + value; // format: on
                 default: return value;
             }
         }
@@ -46,6 +62,24 @@ namespace ctc {
             } else if (str.substr(0, 8) == "PKGCOMP:") {
                 entry.type = PACKAGE_COMPONENT;
                 entry.value = str.substr(8); // expected: pkg:component
+            } else if (str.substr(0, 9) == "LAUNCHER:") {
+                entry.type = COMPILER_LAUNCHER;
+                entry.value = str.substr(9);
+            } else if (str.substr(0, 6) == "UNITY:") {
+                entry.type = UNITY_BUILD;
+                entry.value = str.substr(6);
+            } else if (str.substr(0, 10) == "UNITYSKIP:") {
+                entry.type = UNITY_EXCLUDE;
+                entry.value = str.substr(10);
+            } else if (str.substr(0, 4) == "PCH:") {
+                entry.type = PCH_HEADER;
+                entry.value = str.substr(4);
+            } else if (str.substr(0, 4) == "LTO:") {
+                entry.type = LTO_MODE;
+                entry.value = str.substr(4);
+            } else if (str.substr(0, 11) == "APPTARGETS:") {
+                entry.type = APP_TARGETS;
+                entry.value = str.substr(11);
             } else {
                 // Legacy format - assume it's a package
                 entry.type = PACKAGE;
@@ -62,17 +96,90 @@ namespace ctc {
             return true;
         }
 
-        bool write_file(const std::filesystem::path& path, const std::string& content) {
-            std::ofstream file(path);
-            if (!file.is_open()) {
+#ifndef _WIN32
+        namespace {
+            // The umask without changing it: setting and restoring it would race with threads that create
+            // files or start processes meanwhile. Linux reports it in /proc/self/status.
+            mode_t process_umask() {
+                std::ifstream status("/proc/self/status");
+                std::string line;
+                while (std::getline(status, line)) {
+                    if (line.compare(0, 6, "Umask:") == 0) {
+                        return static_cast<mode_t>(std::strtoul(line.c_str() + 6, nullptr, 8));
+                    }
+                }
+                return 022;
+            }
+        }
+#endif
+        
+        bool write_file(const std::filesystem::path& path, const std::string& content, bool* changed) {
+            if (changed) {
+                *changed = false;
+            }
+            
+            // Identical content: keep the file and its mtime, so build tools see no change
+            std::error_code ec;
+            if (std::filesystem::is_regular_file(path, ec) &&
+                std::filesystem::file_size(path, ec) == content.size() && read_file(path) == content) {
+                return true;
+            }
+            
+            // Write to a temporary file next to the target and rename it over the target,
+            // so readers (and interrupted runs) never see a truncated file
+#ifndef _WIN32
+            // A unique name, so concurrent writers of the same file never share (or truncate) one temporary
+            std::string temp_name = path.string() + ".ctc-tmp-XXXXXX";
+            const int fd = mkstemp(temp_name.data());
+            if (fd < 0) {
+                return false;
+            }
+            const std::filesystem::path temp_path = temp_name;
+            // mkstemp creates the file with mode 0600; keep the target's mode, or give a new file the
+            // mode open() would (0666 without the umask's bits)
+            struct stat target_info;
+            const mode_t mode = stat(path.c_str(), &target_info) == 0 ? (target_info.st_mode & 07777) : (0666 & ~process_umask());
+            bool written = fchmod(fd, mode) == 0;
+            for (size_t offset = 0; written && offset < content.size();) {
+                const ssize_t count = ::write(fd, content.data() + offset, content.size() - offset);
+                if (count < 0 && errno == EINTR) continue;
+                written = count > 0;
+                if (written) offset += static_cast<size_t>(count);
+            }
+            written = close(fd) == 0 && written;
+            if (!written) {
+                std::filesystem::remove(temp_path, ec);
+                return false;
+            }
+#else
+            std::filesystem::path temp_path = path;
+            temp_path += ".ctc-tmp";
+            {
+                std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+                if (!file.is_open()) {
+                    return false;
+                }
+                file << content;
+                file.close();
+                if (!file) {
+                    std::filesystem::remove(temp_path, ec);
+                    return false;
+                }
+            }
+#endif
+            std::filesystem::rename(temp_path, path, ec);
+            if (ec) {
+                std::filesystem::remove(temp_path, ec);
                 return false;
             }
-            file << content;
-            return file.good();
+            if (changed) {
+                *changed = true;
+            }
+            return true;
         }
 
         std::string read_file(const std::filesystem::path& path) {
-            std::ifstream file(path);
+            std::ifstream file(path, std::ios::binary);
             if (!file.is_open()) {
                 return "";
             }
@@ -97,18 +204,53 @@ namespace ctc {
         }
 
         bool write_lines(const std::filesystem::path& path, const std::vector<std::string>& lines) {
-            std::ofstream file(path);
-            if (!file.is_open()) {
-                return false;
-            }
-            
+            std::string content;
             for (const auto& line : lines) {
-                file << line << "\n";
+                content += line;
+                content += "\n";
             }
-            return file.good();
+            return write_file(path, content);
         }
         
         // Enhanced libname utilities
+        bool parse_integer(const std::string& text, long long& value) {
+            if (text.empty() || std::isspace(static_cast<unsigned char>(text[0]))) {
+                return false;
+            }
+            char* end = nullptr;
+            errno = 0;
+            const long long parsed = std::strtoll(text.c_str(), &end, 10);
+            if (*end != '\0' || errno == ERANGE) {
+                return false;
+            }
+            value = parsed;
+            return true;
+        }
+        
+        bool parse_integer(const std::string& text, unsigned long long& value) {
+            // strtoull accepts (and negates) a leading '-'
+            if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+                return false;
+            }
+            char* end = nullptr;
+            errno = 0;
+            const unsigned long long parsed = std::strtoull(text.c_str(), &end, 10);
+            if (*end != '\0' || errno == ERANGE) {
+                return false;
+            }
+            value = parsed;
+            return true;
+        }
+        
+        bool parse_integer(const std::string& text, unsigned long long min, unsigned long long max, unsigned long long& value) {
+            unsigned long long parsed = 0;
+            if (!parse_integer(text, parsed) || parsed < min || parsed > max) {
+                return false;
+            }
+            value = parsed;
+            return true;
+        }
+        
         std::vector<DependencyEntry> read_libname(const std::filesystem::path& path) {
             std::vector<DependencyEntry> entries;
             std::vector<std::string> lines = read_lines(path);
@@ -130,33 +272,280 @@ namespace ctc {
         }
         
         bool add_dependency(const std::filesystem::path& libname_path, const DependencyEntry& entry) {
-            std::vector<DependencyEntry> entries = read_libname(libname_path);
-            
-            // Check if entry already exists
-            for (const auto& existing : entries) {
-                if (existing.type == entry.type && existing.value == entry.value) {
-                    return true; // Already exists
-                }
+            LibnameTransaction transaction(libname_path);
+            if (!transaction.locked()) {
+                return false;
             }
-            
-            entries.push_back(entry);
-            return write_libname(libname_path, entries);
+            transaction.add(entry);
+            return transaction.commit();
         }
         
         bool remove_dependency(const std::filesystem::path& libname_path, const DependencyEntry& entry) {
-            std::vector<DependencyEntry> entries = read_libname(libname_path);
-            
-            auto it = std::remove_if(entries.begin(), entries.end(),
-                [&entry](const DependencyEntry& e) {
-                    return e.type == entry.type && e.value == entry.value;
-                });
+            LibnameTransaction transaction(libname_path);
+            if (!transaction.locked()) {
+                return false;
+            }
+            transaction.remove(entry);
+            return transaction.commit();
+        }
+        
+        LibnameTransaction::LibnameTransaction(const std::filesystem::path& libname_path) : path_(libname_path) {
+#ifdef _WIN32
+            locked_ = true;
+#else
+            // Lock the directory rather than .libname itself: commit replaces the file (a new inode),
+            // which would leave later processes locking a different file than earlier ones
+            std::filesystem::path directory = libname_path.parent_path();
+            if (directory.empty()) directory = ".";
+            lock_fd_ = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+            if (lock_fd_ >= 0) {
+                int result;
+                while ((result = flock(lock_fd_, LOCK_EX)) != 0 && errno == EINTR) {
+                }
+                locked_ = result == 0;
+            }
+#endif
+            if (!locked_) {
+                return;
+            }
+            // Read only after the lock is held, so edits committed by other processes are kept
+            for (const auto& entry : read_libname(path_)) {
+                if (index_.insert(entry.to_string()).second) {
+                    entries_.push_back(entry);
+                } else {
+                    changed_ = true; // duplicate line in the file; commit drops it
+                }
+            }
+        }
+        
+        LibnameTransaction::~LibnameTransaction() {
+#ifndef _WIN32
+            if (lock_fd_ >= 0) {
+                close(lock_fd_); // releases the lock
+            }
+#endif
+        }
+        
+        bool LibnameTransaction::add(const DependencyEntry& entry) {
+            if (!index_.insert(entry.to_string()).second) {
+                return false;
+            }
+            entries_.push_back(entry);
+            changed_ = true;
+            return true;
+        }
+        
+        bool LibnameTransaction::remove(const DependencyEntry& entry) {
+            if (index_.erase(entry.to_string()) == 0) {
+                return false;
+            }
+            changed_ = true;
+            return true;
+        }
+        
+        size_t LibnameTransaction::clear(DependencyEntry::Type type) {
+            size_t removed = 0;
+            for (const auto& entry : entries_) {
+                if (entry.type == type) {
+                    removed += index_.erase(entry.to_string());
+                }
+            }
+            changed_ = changed_ || removed > 0;
+            return removed;
+        }
+        
+        std::vector<DependencyEntry> LibnameTransaction::entries() const {
+            // An entry that was removed and then added again sits in entries_ twice; keep its last position
+            std::vector<DependencyEntry> live;
+            std::unordered_set<std::string> seen;
+            for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+                const std::string key = it->to_string();
+                if (index_.count(key) && seen.insert(key).second) {
+                    live.push_back(*it);
+                }
+            }
+            std::reverse(live.begin(), live.end());
+            return live;
+        }
+        
+        bool LibnameTransaction::commit() {
+            if (!locked_) {
+                return false;
+            }
+            if (!changed_) {
+                return true;
+            }
+            if (!write_libname(path_, entries())) {
+                return false;
+            }
+            changed_ = false;
+            return true;
+        }
+        
+        std::string dependency_type_name(DependencyEntry::Type type) {
+            switch (type) {
+                case DependencyEntry::PACKAGE: return "package";
+                case DependencyEntry::LIBRARY_PATH: return "library path";
+                case DependencyEntry::LIBRARY_NAME: return "library";
+                case DependencyEntry::INCLUDE_PATH: return "include path";
+                case DependencyEntry::PACKAGE_COMPONENT: return "package component";
+                case DependencyEntry::TOOLCHAIN_FILE: return "toolchain file";
+                case DependencyEntry::LINK_OVERRIDE: return "link override";
+                case DependencyEntry::COMPILER_LAUNCHER: return "compiler launcher";
+                case DependencyEntry::UNITY_BUILD: return "unity build";
+                case DependencyEntry::UNITY_EXCLUDE: return "unity build exclusion";
+                case DependencyEntry::PCH_HEADER: return "precompiled header";
+                case DependencyEntry::LTO_MODE: return "link-time optimization";
+                case DependencyEntry::APP_TARGETS: return "per-target executables";
+            }
+            return "entry";
+        }
+        
+        bool parse_dependency_operations(const std::vector<std::string>& args, bool uninstall,
+                                         std::vector<DependencyEntry>& entries, std::string& error) {
+            struct ValueOption {
+                const char* flag;
+                DependencyEntry::Type type;
+                const char* missing;
+            };
+            const ValueOption value_options[] = {
+                {"-L", DependencyEntry::LIBRARY_PATH, "Library path required after -L"},
+                {"-l", DependencyEntry::LIBRARY_NAME, "Library name required after -l"},
+                {"-I", DependencyEntry::INCLUDE_PATH, "Include path required after -I"},
+                {"-T", DependencyEntry::TOOLCHAIN_FILE, "Toolchain file path required after -T"},
+                {"-A", DependencyEntry::LINK_OVERRIDE, "Mapping required after -A. Example: -A glfw3=glfw or -A Qt6:Gui=Qt6::Gui"},
+            };
             
-            if (it != entries.end()) {
-                entries.erase(it, entries.end());
-                return write_libname(libname_path, entries);
+            std::string package;        // package that -c components belong to
+            size_t package_entry = 0;   // its plain PKG entry, replaced by the first component
+            bool package_has_entry = false;
+            for (size_t i = 0; i < args.size(); ++i) {
+                const std::string& arg = args[i];
+                const ValueOption* option = nullptr;
+                for (const auto& candidate : value_options) {
+                    if (arg == candidate.flag) option = &candidate;
+                }
+                if (option) {
+                    if (i + 1 >= args.size()) {
+                        error = option->missing;
+                        return false;
+                    }
+                    entries.push_back({option->type, args[++i]});
+                } else if (arg == "-C") {
+                    // Compiler cache launcher: auto (ccache, then sccache), ccache, sccache or a path.
+                    // A bare -C installs auto, and uninstalls whichever launcher is set (empty value). Any other
+                    // word after it is the next operation, e.g. the package of 'ctc install -C Boost'.
+                    const std::string next = i + 1 < args.size() ? args[i + 1] : "";
+                    const bool has_value = next == "auto" || next == "ccache" || next == "sccache" || next.find('/') != std::string::npos;
+                    entries.push_back({DependencyEntry::COMPILER_LAUNCHER, has_value ? args[++i] : (uninstall ? "" : "auto")});
+                } else if (arg == "--unity-exclude" && uninstall) {
+                    if (i + 1 >= args.size()) {
+                        error = "Source file required after --unity-exclude";
+                        return false;
+                    }
+                    entries.push_back({DependencyEntry::UNITY_EXCLUDE, std::filesystem::path(args[++i]).generic_string()});
+                } else if (arg == "-c") {
+                    if (i + 1 >= args.size()) {
+                        error = "Component name required after -c";
+                        return false;
+                    }
+                    if (package.empty()) {
+                        error = "-c " + args[i + 1] + " must follow a package name";
+                        return false;
+                    }
+                    const DependencyEntry component = {DependencyEntry::PACKAGE_COMPONENT, package + ":" + args[++i]};
+                    if (package_has_entry) {
+                        entries[package_entry] = component;
+                        package_has_entry = false;
+                    } else {
+                        entries.push_back(component);
+                    }
+                } else if (!arg.empty() && arg[0] == '-') {
+                    error = "Unknown option '" + arg + "'";
+                    return false;
+                } else {
+                    // Package, or package:component
+                    const size_t sep = arg.find(':');
+                    package = arg.substr(0, sep);
+                    if (sep != std::string::npos && sep + 1 < arg.size()) {
+                        entries.push_back({DependencyEntry::PACKAGE_COMPONENT, arg});
+                        package_has_entry = false;
+                    } else {
+                        package_entry = entries.size();
+                        package_has_entry = true;
+                        entries.push_back({DependencyEntry::PACKAGE, package});
+                    }
+                }
+            }
+            if (entries.empty()) {
+                error = "Argument required";
+                return false;
             }
+            return true;
+        }
+        
+        bool parse_setting_option(const std::vector<std::string>& args, size_t& i, std::vector<SettingChange>& changes, std::string& error) {
+            auto is_number = [](const std::string& s) {
+                return !s.empty() && s.find_first_not_of("0123456789") == std::string::npos;
+            };
             
-            return true; // Nothing to remove
+            if (args[i] == "--unity") {
+                // Optional batch size; CMake's own default is 8
+                std::string batch_size = "8";
+                if (i + 1 < args.size() && is_number(args[i + 1])) {
+                    unsigned long long value = 0;
+                    if (!parse_integer(args[++i], 1, 100000, value)) {
+                        error = "Unity batch size must be a positive integer";
+                    }
+                    batch_size = std::to_string(value);
+                }
+                changes.push_back({SettingChange::SET, {DependencyEntry::UNITY_BUILD, batch_size}});
+                return true;
+            } else if (args[i] == "--no-unity") {
+                changes.push_back({SettingChange::CLEAR, {DependencyEntry::UNITY_BUILD, ""}});
+                return true;
+            } else if (args[i] == "--lto") {
+                // Optional mode; thin only differs from full with Clang
+                std::string mode = "thin";
+                if (i + 1 < args.size() && (args[i + 1] == "thin" || args[i + 1] == "full")) {
+                    mode = args[++i];
+                }
+                changes.push_back({SettingChange::SET, {DependencyEntry::LTO_MODE, mode}});
+                return true;
+            } else if (args[i] == "--no-lto") {
+                changes.push_back({SettingChange::CLEAR, {DependencyEntry::LTO_MODE, ""}});
+                return true;
+            } else if (args[i] == "--app-targets") {
+                changes.push_back({SettingChange::SET, {DependencyEntry::APP_TARGETS, "on"}});
+                return true;
+            } else if (args[i] == "--no-app-targets") {
+                changes.push_back({SettingChange::CLEAR, {DependencyEntry::APP_TARGETS, ""}});
+                return true;
+            } else if (args[i] == "--unity-exclude") {
+                if (i + 1 >= args.size()) {
+                    error = "Source file required after --unity-exclude";
+                } else {
+                    changes.push_back({SettingChange::ADD, {DependencyEntry::UNITY_EXCLUDE, std::filesystem::path(args[++i]).generic_string()}});
+                }
+                return true;
+            }
+            return false;
+        }
+        
+        bool apply_setting_changes(const std::filesystem::path& libname_path, const std::vector<SettingChange>& changes) {
+            LibnameTransaction transaction(libname_path);
+            if (!transaction.locked()) {
+                return false;
+            }
+            for (const auto& change : changes) {
+                if (change.action != SettingChange::ADD) {
+                    transaction.clear(change.entry.type);
+                }
+                if (change.action != SettingChange::CLEAR) {
+                    transaction.add(change.entry);
+                }
+            }
+            return transaction.commit();
         }
         
         // CMakeLists.txt generation and modification
@@ -174,6 +563,17 @@ namespace ctc {
             std::map<std::string, std::string> link_overrides;
             // toolchain file (if specified)
             std::string toolchain_file_path;
+            // compiler launcher / cache (if specified)
+            std::string compiler_launcher;
+            // unity build batch size (empty if disabled) and files excluded from it
+            std::string unity_batch_size;
+            std::vector<std::string> unity_excludes;
+            // generated precompiled header (if 'ctc pch' was run)
+            std::string pch_header;
+            // link-time optimization mode (empty if disabled)
+            std::string lto_mode;
+            // one executable per app/<name>.cpp or app/<name>/ instead of one for all of app/
+            bool app_targets = false;
             
             for (const auto& dep : dependencies) {
                 switch (dep.type) {
@@ -212,6 +612,26 @@ namespace ctc {
                         }
                         break;
                     }
+                    case DependencyEntry::COMPILER_LAUNCHER:
+                        if (compiler_launcher.empty()) {
+                            compiler_launcher = dep.value;
+                        }
+                        break;
+                    case DependencyEntry::UNITY_BUILD:
+                        unity_batch_size = dep.value;
+                        break;
+                    case DependencyEntry::UNITY_EXCLUDE:
+                        unity_excludes.push_back(dep.value);
+                        break;
+                    case DependencyEntry::PCH_HEADER:
+                        pch_header = dep.value;
+                        break;
+                    case DependencyEntry::LTO_MODE:
+                        lto_mode = dep.value;
+                        break;
+                    case DependencyEntry::APP_TARGETS:
+                        app_targets = true;
+                        break;
                 }
             }
 
@@ -235,6 +655,19 @@ namespace ctc {
             cmake_content << "set(CMAKE_CXX_STANDARD 17)\n";
             cmake_content << "set(CMAKE_CXX_STANDARD_REQUIRED ON)\n\n";
 
+            // Compiler cache: looked up at configure time so the project still builds where it is not installed
+            if (!compiler_launcher.empty()) {
+                std::string launcher_names = compiler_launcher == "auto" ? "ccache sccache" : "\"" + compiler_launcher + "\"";
+                cmake_content << "# Compiler cache (launcher)\n";
+                cmake_content << "find_program(CTC_COMPILER_LAUNCHER NAMES " << launcher_names << ")\n";
+                cmake_content << "if(CTC_COMPILER_LAUNCHER)\n";
+                cmake_content << "    set(CMAKE_C_COMPILER_LAUNCHER \"${CTC_COMPILER_LAUNCHER}\")\n";
+                cmake_content << "    set(CMAKE_CXX_COMPILER_LAUNCHER \"${CTC_COMPILER_LAUNCHER}\")\n";
+                cmake_content << "else()\n";
+                cmake_content << "    message(STATUS \"Compiler cache (" << compiler_launcher << ") not found, building without it\")\n";
+                cmake_content << "endif()\n\n";
+            }
+
             // Add find_package calls: try CONFIG first (with COMPONENTS if present), fallback to MODULE (with COMPONENTS if present)
             if (!packages.empty() || !package_to_components.empty()) {
                 cmake_content << "# Find packages (try CONFIG first, fallback to MODULE)\n";
@@ -287,69 +720,149 @@ namespace ctc {
             }
             cmake_content << "\n";
             
-            // Collect source files
-            cmake_content << "# Collect source files from lib directory\n";
-            cmake_content << "file(GLOB_RECURSE LIB_SOURCES \"lib/*.cpp\" \"lib/*.cc\" \"lib/*.c\")\n\n";
-            cmake_content << "# Collect source files from app directory\n";
-            cmake_content << "file(GLOB_RECURSE APP_SOURCES \"app/*.cpp\" \"app/*.cc\" \"app/*.c\")\n\n";
-            
-            // Create executable
-            cmake_content << "# Create executable\n";
-            cmake_content << "add_executable(${PROJECT_NAME} ${APP_SOURCES} ${LIB_SOURCES})\n\n";
-            
-            // Set output directory
-            cmake_content << "# Set output directory\n";
-            cmake_content << "set_target_properties(${PROJECT_NAME} PROPERTIES\n";
-            cmake_content << "    RUNTIME_OUTPUT_DIRECTORY ${CMAKE_SOURCE_DIR}/bin\n";
-            cmake_content << ")\n\n";
-            
-            // Link libraries
-            if (!lib_names.empty() || !packages.empty() || !package_to_components.empty()) {
-                cmake_content << "# Link libraries\n";
-                cmake_content << "target_link_libraries(${PROJECT_NAME}";
-                
-                // Add package libraries honoring link overrides: either pkg::component (if components specified) or pkg::pkg
-                {
-                    std::set<std::string> printed_pkg_targets;
-                    // packages with components
-                    for (const auto& kv : package_to_components) {
-                        const auto& pkg = kv.first;
-                        for (const auto& comp : kv.second) {
-                            std::string key = pkg + ":" + comp;
-                            auto it = link_overrides.find(key);
-                            if (it != link_overrides.end()) {
-                                cmake_content << " " << it->second;
-                            } else {
-                                cmake_content << " " << pkg << "::" << comp;
-                            }
-                        }
-                        printed_pkg_targets.insert(pkg);
+            // Targets linked by everything: packages (honoring link overrides) and plain libraries
+            std::vector<std::string> link_items;
+            {
+                std::set<std::string> printed_pkg_targets;
+                // packages with components: pkg::component
+                for (const auto& kv : package_to_components) {
+                    const auto& pkg = kv.first;
+                    for (const auto& comp : kv.second) {
+                        std::string key = pkg + ":" + comp;
+                        auto it = link_overrides.find(key);
+                        link_items.push_back(it != link_overrides.end() ? it->second : pkg + "::" + comp);
                     }
-                    // plain packages
-                    for (const auto& pkg : packages) {
-                        if (printed_pkg_targets.find(pkg) == printed_pkg_targets.end()) {
-                            auto it = link_overrides.find(pkg);
-                            if (it != link_overrides.end()) {
-                                cmake_content << " " << it->second;
-                            } else {
-                                cmake_content << " " << pkg << "::" << pkg;
-                            }
-                        }
+                    printed_pkg_targets.insert(pkg);
+                }
+                // plain packages: pkg::pkg
+                for (const auto& pkg : packages) {
+                    if (printed_pkg_targets.find(pkg) == printed_pkg_targets.end()) {
+                        auto it = link_overrides.find(pkg);
+                        link_items.push_back(it != link_overrides.end() ? it->second : pkg + "::" + pkg);
                     }
                 }
-                
-                // Add library names
-                for (const auto& lib : lib_names) {
-                    cmake_content << " " << lib;
+                // library names
+                link_items.insert(link_items.end(), lib_names.begin(), lib_names.end());
+            }
+            
+            // Unity build applies to every target created below
+            if (!unity_batch_size.empty()) {
+                cmake_content << "# Unity (jumbo) build\n";
+                cmake_content << "set(CMAKE_UNITY_BUILD ON)\n";
+                cmake_content << "set(CMAKE_UNITY_BUILD_BATCH_SIZE " << unity_batch_size << ")\n";
+                if (!unity_excludes.empty()) {
+                    cmake_content << "set_source_files_properties(";
+                    for (const auto& file : unity_excludes) {
+                        cmake_content << "\n    \"${CMAKE_SOURCE_DIR}/" << file << "\"";
+                    }
+                    cmake_content << "\n    PROPERTIES SKIP_UNITY_BUILD_INCLUSION ON\n)\n";
                 }
-                
-                cmake_content << ")\n";
+                cmake_content << "\n";
+            }
+            
+            // Explicit source lists and lib/ targets live in ctc_sources.cmake, so adding or removing
+            // files only rewrites that file (and CMake reconfigures only when it actually changed)
+            cmake_content << "# External libraries linked by the executable and every lib/ target\n";
+            cmake_content << "set(CTC_LINK_LIBRARIES";
+            for (const auto& item : link_items) {
+                cmake_content << " " << item;
+            }
+            cmake_content << ")\n\n";
+            cmake_content << "# Source lists and lib/ object libraries (generated by ctc, refreshed by 'ctc apply' and 'ctc run')\n";
+            cmake_content << "include(${CMAKE_SOURCE_DIR}/ctc_sources.cmake)\n\n";
+            
+            // Set output directory; ctc passes bin/<mode> when it builds several modes at once
+            const std::string output_dir_setup =
+                "# Set output directory (CTC_BIN_DIR is set by ctc, e.g. bin/<mode> for 'ctc run -m Debug,Release')\n"
+                "if(NOT CTC_BIN_DIR)\n"
+                "    set(CTC_BIN_DIR ${CMAKE_SOURCE_DIR}/bin)\n"
+                "endif()\n";
+            // Executable targets, for the settings below (none for a project that only has lib/ sources)
+            const std::string executables = "${CTC_EXECUTABLE_TARGETS}";
+            if (app_targets) {
+                // One executable per app target listed in ctc_sources.cmake; 'ctc run -t <name>' builds one
+                cmake_content << output_dir_setup << "\n";
+                cmake_content << "# Create executables: one per app/<name>.cpp or app/<name>/, written to bin/<name>\n";
+                cmake_content << "set(CTC_EXECUTABLE_TARGETS)\n";
+                cmake_content << "foreach(ctc_app ${CTC_APP_TARGETS})\n";
+                cmake_content << "    add_executable(${PROJECT_NAME}_app_${ctc_app} ${APP_SOURCES_${ctc_app}})\n";
+                cmake_content << "    set_target_properties(${PROJECT_NAME}_app_${ctc_app} PROPERTIES\n";
+                cmake_content << "        OUTPUT_NAME ${ctc_app}\n";
+                cmake_content << "        RUNTIME_OUTPUT_DIRECTORY ${CTC_BIN_DIR}\n";
+                cmake_content << "    )\n";
+                cmake_content << "    list(APPEND CTC_EXECUTABLE_TARGETS ${PROJECT_NAME}_app_${ctc_app})\n";
+                cmake_content << "endforeach()\n\n";
+            } else {
+                // Create executable; add_executable() fails without sources, e.g. while app/ is still empty
+                cmake_content << output_dir_setup << "\n";
+                cmake_content << "# Create executable\n";
+                cmake_content << "set(CTC_EXECUTABLE_TARGETS)\n";
+                cmake_content << "if(APP_SOURCES)\n";
+                cmake_content << "    add_executable(${PROJECT_NAME} ${APP_SOURCES})\n";
+                cmake_content << "    set_target_properties(${PROJECT_NAME} PROPERTIES\n";
+                cmake_content << "        RUNTIME_OUTPUT_DIRECTORY ${CTC_BIN_DIR}\n";
+                cmake_content << "    )\n";
+                cmake_content << "    list(APPEND CTC_EXECUTABLE_TARGETS ${PROJECT_NAME})\n";
+                cmake_content << "endif()\n\n";
+            }
+            
+            // Benchmark executable over the lib/ targets; kept in the build tree, not in bin/
+            cmake_content << "# Benchmarks from bench/ (built and run by 'ctc bench')\n";
+            cmake_content << "if(BENCH_SOURCES)\n";
+            cmake_content << "    set(CTC_BENCH_TARGET ${PROJECT_NAME}_bench)\n";
+            cmake_content << "    add_executable(${CTC_BENCH_TARGET} ${BENCH_SOURCES})\n";
+            cmake_content << "    target_include_directories(${CTC_BENCH_TARGET} PRIVATE ${CMAKE_SOURCE_DIR}/bench)\n";
+            cmake_content << "    target_link_libraries(${CTC_BENCH_TARGET} ${CTC_LIBRARY_TARGETS} ${CTC_LINK_LIBRARIES})\n";
+            cmake_content << "    set_target_properties(${CTC_BENCH_TARGET} PROPERTIES\n";
+            cmake_content << "        OUTPUT_NAME ctc_bench\n";
+            cmake_content << "        RUNTIME_OUTPUT_DIRECTORY ${CMAKE_BINARY_DIR}/bench\n";
+            cmake_content << "    )\n";
+            cmake_content << "endif()\n\n";
+            
+            // Precompiled header (C++ sources only; skipped if the generated header is missing, e.g. in a fresh clone)
+            if (!pch_header.empty()) {
+                cmake_content << "# Precompiled header (generated by 'ctc pch')\n";
+                cmake_content << "if(EXISTS \"${CMAKE_SOURCE_DIR}/" << pch_header << "\")\n";
+                cmake_content << "    foreach(ctc_target " << executables << " ${CTC_LIBRARY_TARGETS} ${CTC_BENCH_TARGET})\n";
+                cmake_content << "        target_precompile_headers(${ctc_target} PRIVATE \"$<$<COMPILE_LANGUAGE:CXX>:${CMAKE_SOURCE_DIR}/" << pch_header << ">\")\n";
+                cmake_content << "    endforeach()\n";
+                cmake_content << "endif()\n\n";
+            }
+            
+            // Link-time optimization for the executables and every lib/ target
+            if (!lto_mode.empty()) {
+                cmake_content << "# Link-time optimization (IPO, " << lto_mode << ")\n";
+                cmake_content << "include(CheckIPOSupported)\n";
+                cmake_content << "check_ipo_supported(RESULT CTC_IPO_SUPPORTED OUTPUT CTC_IPO_OUTPUT)\n";
+                cmake_content << "if(CTC_IPO_SUPPORTED)\n";
+                cmake_content << "    if(CMAKE_CXX_COMPILER_ID MATCHES \"Clang\")\n";
+                cmake_content << "        set(CMAKE_C_COMPILE_OPTIONS_IPO " << (lto_mode == "thin" ? "-flto=thin" : "-flto") << ")\n";
+                cmake_content << "        set(CMAKE_CXX_COMPILE_OPTIONS_IPO " << (lto_mode == "thin" ? "-flto=thin" : "-flto") << ")\n";
+                cmake_content << "    endif()\n";
+                cmake_content << "    set_property(TARGET " << executables << " ${CTC_LIBRARY_TARGETS} ${CTC_BENCH_TARGET} PROPERTY INTERPROCEDURAL_OPTIMIZATION ON)\n";
+                cmake_content << "else()\n";
+                cmake_content << "    message(WARNING \"LTO requested but not supported: ${CTC_IPO_OUTPUT}\")\n";
+                cmake_content << "endif()\n\n";
+            }
+            
+            // Link libraries: every generated library (object files) plus the external ones. App targets
+            // link all of them too: which lib/ code a tool calls cannot be told from its #includes alone
+            // (forward declarations, headers named differently from their sources)
+            cmake_content << "# Link libraries\n";
+            if (app_targets) {
+                cmake_content << "foreach(ctc_app ${CTC_APP_TARGETS})\n";
+                cmake_content << "    target_link_libraries(${PROJECT_NAME}_app_${ctc_app} ${CTC_LIBRARY_TARGETS} ${CTC_LINK_LIBRARIES})\n";
+                cmake_content << "endforeach()\n";
+            } else {
+                cmake_content << "if(TARGET ${PROJECT_NAME})\n";
+                cmake_content << "    target_link_libraries(${PROJECT_NAME} ${CTC_LIBRARY_TARGETS} ${CTC_LINK_LIBRARIES})\n";
+                cmake_content << "endif()\n";
             }
             
             return cmake_content.str();
         }
         
-        bool update_cmake_file(const std::filesystem::path& cmake_path, const std::string& project_name, const std::vector<DependencyEntry>& dependencies) {
+        bool update_cmake_file(const std::filesystem::path& cmake_path, const std::string& project_name, const std::vector<DependencyEntry>& dependencies, bool* changed) {
             const std::string user_marker = "# === CTC USER SECTION (not modified by ctc) ===";
             const std::string user_placeholder = R"(# === CTC USER SECTION (not modified by ctc) ===
 # Add any custom CMake logic below. This section is preserved by ctc.
@@ -371,9 +884,121 @@ namespace ctc {
             }
 
             std::string final_content = managed_content + "\n" + user_section;
-            return write_file(cmake_path, final_content);
+            if (!write_file(cmake_path, final_content, changed)) {
+                return false;
+            }
+            return update_sources_manifest(cmake_path.parent_path() / "ctc_sources.cmake");
+        }
+        
+        namespace {
+            // A quoted CMake argument, so a path with spaces, '"', '\' or '$' stays one literal entry
+            std::string cmake_quoted(const std::string& value) {
+                std::string quoted = "\"";
+                for (char c : value) {
+                    if (c == '"' || c == '\\' || c == '$') quoted += '\\';
+                    quoted += c;
+                }
+                return quoted + "\"";
+            }
+        }
+        
+        std::string generate_sources_manifest(const SourceLayout& layout, bool app_targets) {
+            std::stringstream manifest;
+            manifest << "# === Generated by ctc from app/, lib/ and bench/ - do not edit ===\n";
+            manifest << "# Rewritten by 'ctc apply' and 'ctc run' only when the set of source files changes.\n\n";
+            
+            manifest << "set(APP_SOURCES\n";
+            for (const auto& file : layout.app_sources) {
+                manifest << "    " << cmake_quoted(file) << "\n";
+            }
+            manifest << ")\n\n";
+            
+            manifest << "# Benchmarks (built and run by 'ctc bench')\n";
+            manifest << "set(BENCH_SOURCES\n";
+            for (const auto& file : layout.bench_sources) {
+                manifest << "    " << cmake_quoted(file) << "\n";
+            }
+            manifest << ")\n\n";
+            
+            // One object library per top-level directory of lib/, linked together as their includes require
+            manifest << "# Libraries: one object library per top-level directory of lib/\n";
+            manifest << "# (source files directly in lib/ form ${PROJECT_NAME}_lib)\n";
+            manifest << "set(CTC_LIBRARY_TARGETS)\n";
+            std::map<std::string, std::string> targets; // by library name
+            for (const auto& lib : layout.libraries) {
+                targets[lib.name] = "${PROJECT_NAME}_" + lib.target_suffix();
+            }
+            for (const auto& lib : layout.libraries) {
+                const std::string& target = targets[lib.name];
+                const std::string sources_var = lib.name.empty() ? "LIB_SOURCES" : "LIB_SOURCES_" + lib.target_suffix().substr(4);
+                manifest << "\nset(" << sources_var << "\n";
+                for (const auto& file : lib.sources) {
+                    manifest << "    " << cmake_quoted(file) << "\n";
+                }
+                manifest << ")\n";
+                manifest << "add_library(" << target << " OBJECT ${" << sources_var << "})\n";
+                // Dependencies inferred from #include relationships, plus the external libraries
+                manifest << "target_link_libraries(" << target << " PUBLIC";
+                for (const auto& dep : lib.dependencies) {
+                    manifest << " " << targets[dep];
+                }
+                manifest << " ${CTC_LINK_LIBRARIES})\n";
+                manifest << "list(APPEND CTC_LIBRARY_TARGETS " << target << ")\n";
+            }
+            
+            if (app_targets) {
+                manifest << "\n# Executables ('ctc apply --app-targets'): one per app/<name>.cpp or app/<name>/,\n";
+                manifest << "# each linked with every lib/ target\n";
+                manifest << "set(CTC_APP_TARGETS)\n";
+                for (const auto& app : layout.app_targets) {
+                    manifest << "\nset(APP_SOURCES_" << app.name << "\n";
+                    for (const auto& file : app.sources) {
+                        manifest << "    " << cmake_quoted(file) << "\n";
+                    }
+                    manifest << ")\n";
+                    manifest << "list(APPEND CTC_APP_TARGETS " << app.name << ")\n";
+                }
+            }
+            return manifest.str();
+        }
+        
+        bool update_sources_manifest(const std::filesystem::path& manifest_path, bool* changed) {
+            const std::filesystem::path project_dir = manifest_path.parent_path().empty() ? "." : manifest_path.parent_path();
+            SourceLayout layout = scan_source_layout(project_dir / ".ctc");
+            bool app_targets = false;
+            for (const auto& entry : read_libname(project_dir / ".libname")) {
+                app_targets = app_targets || entry.type == DependencyEntry::APP_TARGETS;
+            }
+            std::string content = generate_sources_manifest(layout, app_targets);
+            
+            // write_file leaves the file (and its mtime) alone if nothing changed, so CMake does not reconfigure
+            return write_file(manifest_path, content, changed);
         }
 
+        bool app_targets_enabled() {
+            bool enabled = false;
+            for (const auto& entry : read_libname(".libname")) {
+                enabled = enabled || entry.type == DependencyEntry::APP_TARGETS;
+            }
+            return enabled && read_file("CMakeLists.txt").find("CTC_APP_TARGETS") != std::string::npos;
+        }
+        
+        bool check_app_target(const std::string& name, std::string& error) {
+            if (!app_targets_enabled()) {
+                error = "-t needs one executable per app/<name>.cpp or app/<name>/. Enable it with 'ctc run -U --app-targets' (or 'ctc apply --app-targets').";
+                return false;
+            }
+            std::string names;
+            for (const auto& app : scan_source_layout(".ctc").app_targets) {
+                if (app.name == name) {
+                    return true;
+                }
+                names += (names.empty() ? "" : ", ") + app.name;
+            }
+            error = "No executable target '" + name + "' in app/. Targets: " + (names.empty() ? "(none)" : names);
+            return false;
+        }
+        
         std::string get_cmake_template() {
             return R"(cmake_minimum_required(VERSION 3.17)
 project(my_project VERSION 1.0.0)
@@ -397,9 +1022,12 @@ file(GLOB_RECURSE APP_SOURCES "app/*.cpp" "app/*.cc" "app/*.c")
 # Create executable
 add_executable(${PROJECT_NAME} ${APP_SOURCES} ${LIB_SOURCES})
 
-# Set output directory
+# Set output directory (CTC_BIN_DIR is set by ctc, e.g. bin/<mode> for 'ctc run -m Debug,Release')
+if(NOT CTC_BIN_DIR)
+    set(CTC_BIN_DIR ${CMAKE_SOURCE_DIR}/bin)
+endif()
 set_target_properties(${PROJECT_NAME} PROPERTIES
-    RUNTIME_OUTPUT_DIRECTORY ${CMAKE_SOURCE_DIR}/bin
+    RUNTIME_OUTPUT_DIRECTORY ${CTC_BIN_DIR}
 )
 
 # Link libraries (add your libraries here)
@@ -456,6 +1084,10 @@ CMakeCache.txt
 cmake_install.cmake
 Makefile
 *.cmake
+!ctc_sources.cmake
+
+# CTC caches and generated files
+.ctc/
 
 # IDE files
 .vscode/
@@ -512,6 +1144,7 @@ The executable will be placed in the `bin` directory.
 - `app/` - Main application source files
 - `lib/` - Library source files  
 - `include/` - Header files
+- `bench/` - Benchmarks (optional, created by `ctc init -b`; run with `ctc bench`)
 - `bin/` - Built executables (created after build)
 
 ## Dependencies
@@ -521,5 +1154,284 @@ Dependencies are managed in the `.libname` file. Use:
 - `ctc uninstall <package>` to remove dependencies
 )";
         }
+
+        std::string get_bench_header_template() {
+            return R"CTC(// ctc_bench.h - microbenchmark harness (generated by ctc; 'ctc bench' builds and runs bench/)
+//
+//   #include "ctc_bench.h"
+//
+//   CTC_BENCH(vector_push_back) {
+//       while (state.keep_running()) {
+//           std::vector<int> v;
+//           v.push_back(42);
+//           ctc_bench::do_not_optimize(v.data());
+//       }
+//   }
+//
+// Every benchmark is warmed up, its iteration count is calibrated so that one sample takes about
+// --sample-ms, and --samples samples are taken. Results are reported as ns per iteration.
+// bench_main.cpp defines CTC_BENCH_MAIN to get main(); other files only include this header.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace ctc_bench {
+    // Passed to every benchmark; the timed loop runs while keep_running() returns true
+    class State {
+    public:
+        explicit State(std::uint64_t iterations) : iterations_(iterations), remaining_(iterations) {}
+        bool keep_running() {
+            if (remaining_ == 0) return false;
+            --remaining_;
+            return true;
+        }
+        std::uint64_t iterations() const { return iterations_; }
+    private:
+        std::uint64_t iterations_;
+        std::uint64_t remaining_;
+    };
+
+    // Keep the compiler from discarding a value (and the computation that produced it)
+    template <typename T>
+    inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static const void* volatile sink;
+        sink = &value;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+    }
+
+    // Force pending writes to memory to be treated as observable
+    inline void clobber_memory() {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : : "memory");
+#else
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+    }
+
+    using Function = void (*)(State&);
+    struct Benchmark {
+        const char* name;
+        Function function;
+    };
+
+    inline std::vector<Benchmark>& registry() {
+        static std::vector<Benchmark> benchmarks;
+        return benchmarks;
+    }
+
+    inline bool register_benchmark(const char* name, Function function) {
+        registry().push_back({name, function});
+        return true;
+    }
+
+    struct Options {
+        std::string filter;        // run benchmarks whose name contains this
+        std::string json_path;     // write results as JSON
+        int samples = 30;
+        double warmup_ms = 100;
+        double sample_ms = 10;
+    };
+
+    struct Result {
+        std::string name;
+        std::uint64_t iterations = 0;    // per sample
+        std::vector<double> samples_ns;  // ns per iteration of each sample
+        double median_ns = 0;
+        double p99_ns = 0;
+        double mean_ns = 0;
+        double stddev_ns = 0;
+        double min_ns = 0;
+    };
+
+    namespace detail {
+        inline double run_batch(Function function, std::uint64_t iterations) {
+            State state(iterations);
+            const auto start = std::chrono::steady_clock::now();
+            function(state);
+            const auto end = std::chrono::steady_clock::now();
+            return std::chrono::duration<double, std::nano>(end - start).count();
+        }
+
+        // Nearest-rank percentile of sorted values
+        inline double percentile(const std::vector<double>& sorted, double p) {
+            size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(sorted.size())));
+            return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+        }
+    }
+
+    inline Result measure(const Benchmark& benchmark, const Options& options) {
+        // Warmup: run growing batches until the warmup time is spent; the last batch estimates
+        // the cost of one iteration
+        const double warmup_ns = options.warmup_ms * 1e6;
+        std::uint64_t iterations = 1;
+        double spent_ns = 0;
+        double per_iteration_ns = 0;
+        do {
+            const double batch_ns = detail::run_batch(benchmark.function, iterations);
+            spent_ns += batch_ns;
+            per_iteration_ns = batch_ns / static_cast<double>(iterations);
+            if (batch_ns < warmup_ns / 4 && iterations < (1ull << 40)) iterations *= 2;
+        } while (spent_ns < warmup_ns);
+
+        // Calibrate the batch size so one sample takes about sample_ms
+        Result result;
+        result.name = benchmark.name;
+        result.iterations = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(options.sample_ms * 1e6 / std::max(per_iteration_ns, 0.01)));
+        for (int i = 0; i < options.samples; ++i) {
+            result.samples_ns.push_back(detail::run_batch(benchmark.function, result.iterations) / static_cast<double>(result.iterations));
+        }
+
+        std::vector<double> sorted = result.samples_ns;
+        std::sort(sorted.begin(), sorted.end());
+        const size_t n = sorted.size();
+        const double count = static_cast<double>(n);
+        result.median_ns = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+        result.p99_ns = detail::percentile(sorted, 99);
+        result.min_ns = sorted.front();
+        for (double v : sorted) result.mean_ns += v / count;
+        for (double v : sorted) result.stddev_ns += (v - result.mean_ns) * (v - result.mean_ns);
+        result.stddev_ns = n > 1 ? std::sqrt(result.stddev_ns / (count - 1)) : 0;
+        return result;
+    }
+
+    inline bool write_json(const std::string& path, const std::vector<Result>& results, const Options& options) {
+        FILE* out = std::fopen(path.c_str(), "w");
+        if (!out) return false;
+        std::fprintf(out, "{\n  \"unit\": \"ns/op\",\n  \"samples\": %d,\n  \"sample_ms\": %g,\n  \"benchmarks\": [", options.samples, options.sample_ms);
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            std::fprintf(out, "%s\n    {\"name\": \"%s\", \"iterations\": %llu, \"median_ns\": %.4f, \"p99_ns\": %.4f, "
+                              "\"mean_ns\": %.4f, \"stddev_ns\": %.4f, \"min_ns\": %.4f, \"samples_ns\": [",
+                         i ? "," : "", r.name.c_str(), static_cast<unsigned long long>(r.iterations),
+                         r.median_ns, r.p99_ns, r.mean_ns, r.stddev_ns, r.min_ns);
+            for (size_t j = 0; j < r.samples_ns.size(); ++j) {
+                std::fprintf(out, "%s%.4f", j ? ", " : "", r.samples_ns[j]);
+            }
+            std::fprintf(out, "]}");
+        }
+        std::fprintf(out, "\n  ]\n}\n");
+        return std::fclose(out) == 0;
+    }
+
+    inline int run(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+            if (arg == "--filter" && value) {
+                options.filter = value;
+            } else if (arg == "--json" && value) {
+                options.json_path = value;
+            } else if (arg == "--samples" && value) {
+                options.samples = std::max(1, std::atoi(value));
+            } else if (arg == "--warmup-ms" && value) {
+                options.warmup_ms = std::max(0.0, std::atof(value));
+            } else if (arg == "--sample-ms" && value) {
+                options.sample_ms = std::max(0.001, std::atof(value));
+            } else {
+                std::fprintf(stderr, "Usage: %s [--filter <text>] [--samples <n>] [--warmup-ms <ms>] [--sample-ms <ms>] [--json <file>]\n", argv[0]);
+                return 1;
+            }
+            ++i;
+        }
+
+        std::vector<Benchmark> benchmarks = registry();
+        std::sort(benchmarks.begin(), benchmarks.end(), [](const Benchmark& a, const Benchmark& b) {
+            return std::string(a.name) < b.name;
+        });
+        std::vector<Result> results;
+        std::printf("%-40s %14s %14s %14s %12s\n", "benchmark", "median ns/op", "p99 ns/op", "stddev ns", "iterations");
+        for (const auto& benchmark : benchmarks) {
+            if (std::string(benchmark.name).find(options.filter) == std::string::npos) continue;
+            Result r = measure(benchmark, options);
+            std::printf("%-40s %14.2f %14.2f %14.2f %12llu\n", r.name.c_str(), r.median_ns, r.p99_ns, r.stddev_ns,
+                        static_cast<unsigned long long>(r.iterations));
+            std::fflush(stdout);
+            results.push_back(std::move(r));
+        }
+        if (results.empty()) {
+            std::fprintf(stderr, "No benchmarks%s%s\n", options.filter.empty() ? "" : " match ", options.filter.c_str());
+            return 1;
+        }
+        if (!options.json_path.empty() && !write_json(options.json_path, results, options)) {
+            std::fprintf(stderr, "Failed to write %s\n", options.json_path.c_str());
+            return 1;
+        }
+        return 0;
+    }
+}
+
+#define CTC_BENCH_CONCAT_(a, b) a##b
+#define CTC_BENCH(name) \
+    static void CTC_BENCH_CONCAT_(ctc_bench_, name)(::ctc_bench::State& state); \
+    [[maybe_unused]] static const bool CTC_BENCH_CONCAT_(ctc_bench_registered_, name) = \
+        ::ctc_bench::register_benchmark(#name, CTC_BENCH_CONCAT_(ctc_bench_, name)); \
+    static void CTC_BENCH_CONCAT_(ctc_bench_, name)([[maybe_unused]] ::ctc_bench::State& state)
+
+#ifdef CTC_BENCH_MAIN
+int main(int argc, char** argv) {
+    return ::ctc_bench::run(argc, argv);
+}
+#endif
+)CTC";
+        }
+
+        std::string get_bench_main_template() {
+            return R"(// main() of the benchmark executable; benchmarks live in the other files of bench/
+#define CTC_BENCH_MAIN
+#include "ctc_bench.h"
+)";
+        }
+
+        std::string get_bench_example_template() {
+            return R"(// Example benchmark: replace it with benchmarks of your lib/ code (headers from include/ are available)
+#include "ctc_bench.h"
+
+#include <numeric>
+#include <vector>
+
+CTC_BENCH(vector_sum_1k) {
+    std::vector<int> values(1000);
+    std::iota(values.begin(), values.end(), 0);
+    while (state.keep_running()) {
+        long long sum = std::accumulate(values.begin(), values.end(), 0LL);
+        ctc_bench::do_not_optimize(sum);
+    }
+}
+)";
+        }
+
+        bool create_bench_skeleton() {
+            if (!create_directory_if_not_exists("bench")) {
+                std::cerr << "Failed to create directory: bench\n";
+                return false;
+            }
+            const std::vector<std::pair<std::string, std::string>> files = {
+                {"bench/ctc_bench.h", get_bench_header_template()},
+                {"bench/bench_main.cpp", get_bench_main_template()},
+                {"bench/example_bench.cpp", get_bench_example_template()},
+            };
+            for (const auto& file : files) {
+                if (std::filesystem::exists(file.first)) continue; // never overwrite user benchmarks
+                if (!write_file(file.first, file.second)) {
+                    std::cerr << "Failed to create " << file.first << "\n";
+                    return false;
+                }
+                std::cout << "Created file: " << file.first << "\n";
+            }
+            return true;
+        }
     }
 }
@@ -0,0 +1,452 @@
+#include "process_utils.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+#ifdef _WIN32
+#include <cstdlib>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace ctc {
+    namespace utils {
+        
+        namespace {
+#ifndef _WIN32
+            // Process groups of the children currently running, so signals sent to ctc reach them too
+            constexpr size_t max_active_groups = 256;
+            std::atomic<pid_t> active_groups[max_active_groups];
+            std::atomic<int> last_forwarded_signal{0};
+            
+            void forward_signal(int signal_number) {
+                bool forwarded = false;
+                for (auto& group : active_groups) {
+                    const pid_t pgid = group.load();
+                    if (pgid > 0) {
+                        kill(-pgid, signal_number);
+                        forwarded = true;
+                    }
+                }
+                if (forwarded) {
+                    last_forwarded_signal.store(signal_number);
+                }
+                // Nothing to pass it on to: behave as if ctc had no handler
+                if (!forwarded) {
+                    std::signal(signal_number, SIG_DFL);
+                    std::raise(signal_number);
+                }
+            }
+            
+            void install_signal_forwarding() {
+                static std::once_flag once;
+                std::call_once(once, []() {
+                    for (int signal_number : {SIGINT, SIGTERM, SIGHUP}) {
+                        struct sigaction current;
+                        if (sigaction(signal_number, nullptr, &current) != 0 || current.sa_handler != SIG_DFL) {
+                            continue; // keep signals that were ignored on purpose (nohup) or are handled elsewhere
+                        }
+                        struct sigaction forward;
+                        std::memset(&forward, 0, sizeof(forward));
+                        forward.sa_handler = forward_signal;
+                        forward.sa_flags = SA_RESTART;
+                        sigemptyset(&forward.sa_mask);
+                        sigaction(signal_number, &forward, nullptr);
+                    }
+                });
+            }
+            
+            size_t register_group(pid_t pgid) {
+                for (size_t i = 0; i < max_active_groups; ++i) {
+                    pid_t expected = 0;
+                    if (active_groups[i].compare_exchange_strong(expected, pgid)) return i;
+                }
+                return max_active_groups;
+            }
+            
+            void unregister_group(size_t slot) {
+                if (slot < max_active_groups) active_groups[slot].store(0);
+            }
+            
+            bool write_all(int fd, const char* data, size_t size) {
+                while (size > 0) {
+                    const ssize_t written = write(fd, data, size);
+                    if (written < 0) {
+                        if (errno == EINTR) continue;
+                        return false;
+                    }
+                    data += written;
+                    size -= static_cast<size_t>(written);
+                }
+                return true;
+            }
+            
+            // The read end of a piped stream and what to do with its data
+            struct PipedStream {
+                int fd = -1;
+                bool is_stderr = false;
+                OutputMode mode = OutputMode::forward;
+                std::string* captured = nullptr;
+                std::string partial_line;
+            };
+            
+            void deliver_lines(PipedStream& stream, const ProcessOptions& options, double elapsed, bool flush) {
+                size_t begin = 0;
+                for (size_t end; (end = stream.partial_line.find('\n', begin)) != std::string::npos; begin = end + 1) {
+                    OutputLine line;
+                    line.elapsed_seconds = elapsed;
+                    line.is_stderr = stream.is_stderr;
+                    line.text = stream.partial_line.substr(begin, end - begin);
+                    if (!line.text.empty() && line.text.back() == '\r') line.text.pop_back();
+                    options.on_line(line);
+                }
+                stream.partial_line.erase(0, begin);
+                if (flush && !stream.partial_line.empty()) {
+                    options.on_line(OutputLine{elapsed, stream.is_stderr, stream.partial_line});
+                    stream.partial_line.clear();
+                }
+            }
+            
+            // Read what is available; returns false at end of file
+            bool read_stream(PipedStream& stream, const ProcessOptions& options, double elapsed) {
+                char buffer[8192];
+                const ssize_t n = read(stream.fd, buffer, sizeof(buffer));
+                if (n < 0 && (errno == EINTR || errno == EAGAIN)) return true;
+                if (n <= 0) {
+                    if (options.on_line) deliver_lines(stream, options, elapsed, true);
+                    close(stream.fd);
+                    stream.fd = -1;
+                    return false;
+                }
+                const size_t size = static_cast<size_t>(n);
+                if (stream.mode == OutputMode::forward) {
+                    write_all(stream.is_stderr ? STDERR_FILENO : STDOUT_FILENO, buffer, size);
+                } else {
+                    stream.captured->append(buffer, size);
+                }
+                if (options.on_line) {
+                    stream.partial_line.append(buffer, size);
+                    deliver_lines(stream, options, elapsed, false);
+                }
+                return true;
+            }
+#endif
+
+            bool needs_quoting(const std::string& arg) {
+#ifdef _WIN32
+                return arg.empty() || arg.find_first_of(" \t\n\v\"") != std::string::npos;
+#else
+                return arg.empty() || arg.find_first_of(" \t\n\"'\\$`;&|<>()*?") != std::string::npos;
+#endif
+            }
+        }
+        
+        int forwarded_signal() {
+#ifdef _WIN32
+            return 0;
+#else
+            return last_forwarded_signal.load();
+#endif
+        }
+        
+        int ProcessResult::status() const {
+            if (!started) return 127;
+            if (signal != 0) return 128 + signal;
+            return exit_code;
+        }
+        
+        std::string ProcessResult::describe() const {
+            if (!started) return "could not be started: " + error;
+            std::string description;
+            if (timed_out) {
+                description = "timed out after " + std::to_string(static_cast<long long>(elapsed_seconds)) + "s";
+            } else if (cancelled) {
+                description = "was cancelled";
+            } else if (signal != 0) {
+                description = "killed by signal " + std::to_string(signal);
+#ifndef _WIN32
+                description += std::string(" (") + strsignal(signal) + ")";
+#endif
+            } else {
+                description = "exited with status " + std::to_string(exit_code);
+            }
+            return description;
+        }
+        
+        std::string format_command_line(const std::vector<std::string>& argv) {
+            std::string line;
+            for (const auto& arg : argv) {
+                if (!line.empty()) line += " ";
+                if (!needs_quoting(arg)) {
+                    line += arg;
+                    continue;
+                }
+                line += "\"";
+#ifdef _WIN32
+                // Backslashes are literal except before a quote, where each one and the quote are escaped
+                size_t backslashes = 0;
+                for (char c : arg) {
+                    if (c == '\\') {
+                        ++backslashes;
+                        continue;
+                    }
+                    line.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+                    backslashes = 0;
+                    line += c;
+                }
+                line.append(backslashes * 2, '\\');
+#else
+                for (char c : arg) {
+                    if (c == '"' || c == '\\' || c == '$' || c == '`') line += "\\";
+                    line += c;
+                }
+#endif
+                line += "\"";
+            }
+            return line;
+        }
+        
+        ProcessResult run_process(const std::vector<std::string>& argv, const ProcessOptions& options) {
+            ProcessResult result;
+            if (argv.empty()) {
+                result.error = "empty command";
+                return result;
+            }
+            // Anything ctc printed so far must come out before the child's output
+            std::cout << std::flush;
+            std::cerr << std::flush;
+            const auto start = std::chrono::steady_clock::now();
+            auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+
+#ifdef _WIN32
+            // No process groups or non-blocking pipes here: run through the C runtime, without
+            // timeouts, cancellation or extra environment entries, and capture stdout through _popen
+            std::string command = "\"" + format_command_line(argv);
+            if (!options.working_directory.empty()) {
+                command = "\"cd /d \"" + options.working_directory.string() + "\" && " + format_command_line(argv);
+            }
+            if (options.stdout_mode == OutputMode::discard) command += " >NUL";
+            if (options.stderr_mode == OutputMode::discard) command += " 2>NUL";
+            command += "\"";
+            result.started = true;
+            if (options.stdout_mode == OutputMode::capture) {
+                FILE* pipe = _popen(command.c_str(), "r");
+                if (!pipe) {
+                    result.started = false;
+                    result.error = std::strerror(errno);
+                    return result;
+                }
+                char buffer[4096];
+                size_t n;
+                while ((n = std::fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+                    result.output.append(buffer, n);
+                }
+                result.exit_code = _pclose(pipe);
+            } else {
+                result.exit_code = std::system(command.c_str());
+            }
+            result.elapsed_seconds = elapsed();
+            return result;
+#else
+            install_signal_forwarding();
+            
+            // Pipes for the streams ctc reads; the write ends become the child's stdout/stderr
+            PipedStream streams[2];
+            int write_ends[2] = {-1, -1};
+            const OutputMode modes[2] = {options.stdout_mode, options.stderr_mode};
+            auto close_all = [&]() {
+                for (int i = 0; i < 2; ++i) {
+                    if (streams[i].fd >= 0) close(streams[i].fd);
+                    if (write_ends[i] >= 0) close(write_ends[i]);
+                    streams[i].fd = write_ends[i] = -1;
+                }
+            };
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            if (options.stdin_mode == InputMode::null_device) {
+                posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+            }
+            // A process group reading the terminal must be its foreground group, or it is stopped (SIGTTIN)
+            const bool foreground = options.stdin_mode == InputMode::inherit && isatty(STDIN_FILENO) &&
+                                    tcgetpgrp(STDIN_FILENO) == getpgrp();
+            if (!options.working_directory.empty()) {
+#if defined(__APPLE__) || (defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29)))
+                posix_spawn_file_actions_addchdir_np(&actions, options.working_directory.c_str());
+#else
+                result.error = "running a command in another directory needs glibc 2.29 or macOS";
+                posix_spawn_file_actions_destroy(&actions);
+                return result;
+#endif
+            }
+            bool force_color = false;
+            for (int i = 0; i < 2; ++i) {
+                const int target = i == 0 ? STDOUT_FILENO : STDERR_FILENO;
+                streams[i].is_stderr = i == 1;
+                streams[i].mode = modes[i];
+                streams[i].captured = i == 0 ? &result.output : &result.error_output;
+                if (modes[i] == OutputMode::discard) {
+                    posix_spawn_file_actions_addopen(&actions, target, "/dev/null", O_WRONLY, 0);
+                } else if (modes[i] == OutputMode::forward || modes[i] == OutputMode::capture) {
+                    int fds[2];
+                    if (pipe2(fds, O_CLOEXEC) != 0) {
+                        result.error = std::string("pipe: ") + std::strerror(errno);
+                        posix_spawn_file_actions_destroy(&actions);
+                        close_all();
+                        return result;
+                    }
+                    streams[i].fd = fds[0];
+                    write_ends[i] = fds[1];
+                    posix_spawn_file_actions_adddup2(&actions, fds[1], target);
+                    // Tools that color their output on a terminal only see a pipe; keep their colors
+                    force_color = force_color || (modes[i] == OutputMode::forward && isatty(target));
+                }
+            }
+            
+            // Own process group, default signal handling and an empty signal mask in the child
+            posix_spawnattr_t attributes;
+            posix_spawnattr_init(&attributes);
+            posix_spawnattr_setpgroup(&attributes, 0);
+            sigset_t signals;
+            sigemptyset(&signals);
+            posix_spawnattr_setsigmask(&attributes, &signals);
+            for (int signal_number : {SIGINT, SIGTERM, SIGHUP, SIGPIPE, SIGQUIT}) sigaddset(&signals, signal_number);
+            posix_spawnattr_setsigdefault(&attributes, &signals);
+            posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+            
+            std::vector<char*> args;
+            for (const auto& arg : argv) args.push_back(const_cast<char*>(arg.c_str()));
+            args.push_back(nullptr);
+            std::vector<char*> environment;
+            std::string color_variable = "CLICOLOR_FORCE=1";
+            auto overridden = [&options](const char* variable) {
+                for (const auto& entry : options.environment) {
+                    const std::string name = entry.substr(0, entry.find('=')) + "=";
+                    if (std::strncmp(variable, name.c_str(), name.size()) == 0) return true;
+                }
+                return false;
+            };
+            for (char** variable = environ; *variable; ++variable) {
+                if (std::strncmp(*variable, "CLICOLOR_FORCE=", 15) == 0) force_color = false;
+                if (!overridden(*variable)) environment.push_back(*variable);
+            }
+            for (const auto& entry : options.environment) {
+                if (entry.find('=') != std::string::npos) environment.push_back(const_cast<char*>(entry.c_str()));
+            }
+            if (force_color) environment.push_back(&color_variable[0]);
+            environment.push_back(nullptr);
+            
+            // A signal between the spawn and register_group would find no group to pass it on to and end
+            // ctc alone, leaving the child running; hold the forwarded signals until the group is known
+            sigset_t forwarded;
+            sigset_t previous_mask;
+            sigemptyset(&forwarded);
+            for (int signal_number : {SIGINT, SIGTERM, SIGHUP}) sigaddset(&forwarded, signal_number);
+            pthread_sigmask(SIG_BLOCK, &forwarded, &previous_mask);
+            pid_t pid = -1;
+            const int spawn_error = posix_spawnp(&pid, args[0], &actions, &attributes, args.data(), environment.data());
+            posix_spawn_file_actions_destroy(&actions);
+            posix_spawnattr_destroy(&attributes);
+            for (int& fd : write_ends) {
+                if (fd >= 0) close(fd);
+                fd = -1;
+            }
+            if (spawn_error != 0) {
+                pthread_sigmask(SIG_SETMASK, &previous_mask, nullptr);
+                result.error = argv[0] + ": " + std::strerror(spawn_error);
+                close_all();
+                return result;
+            }
+            result.started = true;
+            const size_t slot = register_group(pid);
+            pthread_sigmask(SIG_SETMASK, &previous_mask, nullptr);
+            if (foreground) {
+                // The child may already have tried to read and been stopped for it
+                tcsetpgrp(STDIN_FILENO, pid);
+                kill(-pid, SIGCONT);
+            }
+            
+            // Relay output until both pipes close, and stop the process group on timeout or cancellation:
+            // SIGTERM first, SIGKILL if it is still there two seconds later
+            int wait_status = 0;
+            bool exited = false;
+            double terminate_sent_at = -1;
+            const bool watched = options.timeout_seconds > 0 || options.cancel != nullptr;
+            while (!exited) {
+                std::vector<pollfd> pfds;
+                for (const auto& stream : streams) {
+                    if (stream.fd >= 0) pfds.push_back({stream.fd, POLLIN, 0});
+                }
+                if (pfds.empty() && !watched) {
+                    while (waitpid(pid, &wait_status, 0) < 0 && errno == EINTR) {
+                    }
+                    break;
+                }
+                if (poll(pfds.data(), pfds.size(), pfds.empty() ? 20 : 100) > 0) {
+                    for (auto& stream : streams) {
+                        for (const auto& pfd : pfds) {
+                            if (pfd.fd == stream.fd && (pfd.revents & (POLLIN | POLLHUP | POLLERR))) {
+                                read_stream(stream, options, elapsed());
+                                break;
+                            }
+                        }
+                    }
+                }
+                exited = waitpid(pid, &wait_status, WNOHANG) == pid;
+                const double now = elapsed();
+                if (!exited && terminate_sent_at < 0) {
+                    result.timed_out = options.timeout_seconds > 0 && now >= options.timeout_seconds;
+                    result.cancelled = !result.timed_out && options.cancel && options.cancel->load();
+                    if (result.timed_out || result.cancelled) {
+                        kill(-pid, SIGTERM);
+                        terminate_sent_at = now;
+                    }
+                } else if (!exited && now - terminate_sent_at >= 2) {
+                    kill(-pid, SIGKILL);
+                }
+            }
+            // Background processes the child left behind (e.g. a compiler cache server) may still
+            // hold the pipes open; take what is there and stop reading
+            for (auto& stream : streams) {
+                if (stream.fd >= 0) {
+                    const int flags = fcntl(stream.fd, F_GETFL);
+                    fcntl(stream.fd, F_SETFL, flags | O_NONBLOCK);
+                    while (stream.fd >= 0) {
+                        pollfd pfd = {stream.fd, POLLIN, 0};
+                        if (poll(&pfd, 1, 0) <= 0 || !read_stream(stream, options, elapsed())) break;
+                    }
+                    if (options.on_line && stream.fd >= 0) deliver_lines(stream, options, elapsed(), true);
+                }
+            }
+            close_all();
+            unregister_group(slot);
+            if (foreground) {
+                // Take the terminal back; ctc is in a background group now, which gets SIGTTOU for this
+                sigset_t ttou;
+                sigemptyset(&ttou);
+                sigaddset(&ttou, SIGTTOU);
+                pthread_sigmask(SIG_BLOCK, &ttou, &previous_mask);
+                tcsetpgrp(STDIN_FILENO, getpgrp());
+                pthread_sigmask(SIG_SETMASK, &previous_mask, nullptr);
+            }
+            
+            result.elapsed_seconds = elapsed();
+            if (WIFEXITED(wait_status)) {
+                result.exit_code = WEXITSTATUS(wait_status);
+            } else if (WIFSIGNALED(wait_status)) {
+                result.signal = WTERMSIG(wait_status);
+            }
+            return result;
+#endif
+        }
+    }
+}
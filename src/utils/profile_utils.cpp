@@ -0,0 +1,618 @@
+#include "profile_utils.h"
+#include "file_utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <csignal>
+#include <cxxabi.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace ctc {
+    namespace utils {
+
+        namespace {
+#ifdef __linux__
+            // Fork a child that waits until release_gated_child lets it exec argv, so that counters can be
+            // attached to its pid before the program starts. gate receives the controlling pipe end.
+            pid_t start_gated_child(const std::vector<std::string>& argv, bool quiet, int& gate, std::string& error) {
+                int go[2];
+                if (pipe2(go, O_CLOEXEC) != 0) {
+                    error = std::string("pipe: ") + std::strerror(errno);
+                    return -1;
+                }
+                const pid_t child = fork();
+                if (child < 0) {
+                    error = std::string("fork: ") + std::strerror(errno);
+                    close(go[0]);
+                    close(go[1]);
+                    return -1;
+                }
+                if (child == 0) {
+                    close(go[1]);
+                    char token;
+                    if (read(go[0], &token, 1) != 1) _exit(127);
+                    if (quiet) {
+                        const int null_fd = open("/dev/null", O_WRONLY);
+                        if (null_fd >= 0) {
+                            dup2(null_fd, STDOUT_FILENO);
+                            dup2(null_fd, STDERR_FILENO);
+                        }
+                    }
+                    std::vector<char*> args;
+                    for (const auto& arg : argv) args.push_back(const_cast<char*>(arg.c_str()));
+                    args.push_back(nullptr);
+                    execvp(args[0], args.data());
+                    std::perror(args[0]);
+                    _exit(127);
+                }
+                close(go[0]);
+                gate = go[1];
+                return child;
+            }
+            
+            // Let the gated child exec its program, or (run = false) make it exit without doing so
+            void release_gated_child(int gate, bool run) {
+                if (run && write(gate, "g", 1) != 1) {
+                    std::perror("ctc");
+                }
+                close(gate);
+            }
+            
+            std::string perf_open_error(int error_number) {
+                std::string error = std::string("perf_event_open: ") + std::strerror(error_number);
+                if (error_number == EACCES || error_number == EPERM) {
+                    error += " (check /proc/sys/kernel/perf_event_paranoid; a value of 2 or less allows profiling your own processes,"
+                             " and container seccomp profiles may block the syscall)";
+                }
+                return error;
+            }
+            
+            // Function symbols of one ELF file, with the PT_LOAD segments needed to turn a file
+            // offset into a symbol address
+            struct ElfSymbols {
+                struct Segment {
+                    uint64_t offset, vaddr, size;
+                };
+                struct Symbol {
+                    uint64_t start, size;
+                    std::string name;
+                };
+                std::vector<Segment> segments;
+                std::vector<Symbol> symbols;  // sorted by start
+            };
+
+            std::string demangle(const char* name) {
+                int status = 0;
+                std::unique_ptr<char, void (*)(void*)> demangled(abi::__cxa_demangle(name, nullptr, nullptr, &status), std::free);
+                return status == 0 && demangled ? demangled.get() : name;
+            }
+
+            ElfSymbols load_elf_symbols(const std::string& path) {
+                ElfSymbols elf;
+                const std::string image = read_file(path);
+                if (image.size() < sizeof(Elf64_Ehdr) || image.compare(0, SELFMAG, ELFMAG) != 0 || image[EI_CLASS] != ELFCLASS64) {
+                    return elf;
+                }
+                const char* base = image.data();
+                Elf64_Ehdr header;
+                std::memcpy(&header, base, sizeof(header));
+                auto in_bounds = [&](uint64_t offset, uint64_t size) { return offset <= image.size() && size <= image.size() - offset; };
+
+                for (unsigned i = 0; i < header.e_phnum; ++i) {
+                    Elf64_Phdr program;
+                    const uint64_t offset = header.e_phoff + uint64_t(i) * header.e_phentsize;
+                    if (!in_bounds(offset, sizeof(program))) break;
+                    std::memcpy(&program, base + offset, sizeof(program));
+                    if (program.p_type == PT_LOAD) {
+                        elf.segments.push_back({program.p_offset, program.p_vaddr, program.p_filesz});
+                    }
+                }
+
+                // .symtab when the binary is not stripped, .dynsym otherwise
+                std::vector<Elf64_Shdr> sections(header.e_shnum);
+                for (unsigned i = 0; i < header.e_shnum; ++i) {
+                    const uint64_t offset = header.e_shoff + uint64_t(i) * header.e_shentsize;
+                    if (!in_bounds(offset, sizeof(Elf64_Shdr))) return elf;
+                    std::memcpy(&sections[i], base + offset, sizeof(Elf64_Shdr));
+                }
+                for (const auto& section : sections) {
+                    if ((section.sh_type != SHT_SYMTAB && section.sh_type != SHT_DYNSYM) || section.sh_link >= sections.size() ||
+                        !in_bounds(section.sh_offset, section.sh_size)) {
+                        continue;
+                    }
+                    const Elf64_Shdr& strings = sections[section.sh_link];
+                    if (!in_bounds(strings.sh_offset, strings.sh_size)) continue;
+                    for (uint64_t offset = 0; offset + sizeof(Elf64_Sym) <= section.sh_size; offset += sizeof(Elf64_Sym)) {
+                        Elf64_Sym symbol;
+                        std::memcpy(&symbol, base + section.sh_offset + offset, sizeof(symbol));
+                        const int type = ELF64_ST_TYPE(symbol.st_info);
+                        if ((type != STT_FUNC && type != STT_GNU_IFUNC) || symbol.st_value == 0 || symbol.st_name >= strings.sh_size) {
+                            continue;
+                        }
+                        const char* name = base + strings.sh_offset + symbol.st_name;
+                        elf.symbols.push_back({symbol.st_value, symbol.st_size, demangle(name)});
+                    }
+                }
+                std::sort(elf.symbols.begin(), elf.symbols.end(), [](const ElfSymbols::Symbol& a, const ElfSymbols::Symbol& b) {
+                    return a.start < b.start;
+                });
+                return elf;
+            }
+
+            // Memory mappings of a profiled process, from PERF_RECORD_MMAP
+            struct Mapping {
+                uint64_t start, end, pgoff;
+                std::string file;
+            };
+
+            class Symbolizer {
+            public:
+                std::string symbolize(const std::vector<Mapping>& mappings, uint64_t address) {
+                    // Later mappings replace earlier ones at the same address
+                    for (auto it = mappings.rbegin(); it != mappings.rend(); ++it) {
+                        if (address < it->start || address >= it->end) continue;
+                        if (it->file.empty() || it->file[0] == '[' || it->file[0] != '/') {
+                            return it->file.empty() ? "[anon]" : it->file;
+                        }
+                        const ElfSymbols& elf = load(it->file);
+                        const uint64_t offset = address - it->start + it->pgoff;
+                        for (const auto& segment : elf.segments) {
+                            if (offset < segment.offset || offset >= segment.offset + segment.size) continue;
+                            const uint64_t vaddr = offset - segment.offset + segment.vaddr;
+                            auto sym = std::upper_bound(elf.symbols.begin(), elf.symbols.end(), vaddr,
+                                                        [](uint64_t value, const ElfSymbols::Symbol& s) { return value < s.start; });
+                            if (sym != elf.symbols.begin()) {
+                                --sym;
+                                if (sym->size == 0 || vaddr < sym->start + sym->size) return sym->name;
+                            }
+                            break;
+                        }
+                        return "[" + std::filesystem::path(it->file).filename().string() + "]";
+                    }
+                    return "[unknown]";
+                }
+
+            private:
+                const ElfSymbols& load(const std::string& file) {
+                    auto it = files_.find(file);
+                    if (it == files_.end()) {
+                        it = files_.emplace(file, load_elf_symbols(file)).first;
+                    }
+                    return it->second;
+                }
+
+                std::map<std::string, ElfSymbols> files_;
+            };
+
+            // Decodes the records of the perf ring buffers. Every CPU has its own buffer, so a sample
+            // can be read before the MMAP record describing its addresses: stacks are kept as raw
+            // addresses and only symbolized once everything has been read.
+            struct SampleCollector {
+                std::map<uint32_t, std::vector<Mapping>> mappings;  // by pid
+                std::map<uint32_t, uint32_t> parents;               // forked processes inherit their parent's mappings
+                std::map<uint32_t, std::string> names;              // comm by pid
+                std::map<std::pair<uint32_t, std::vector<uint64_t>>, unsigned long long> raw_stacks;  // (pid, leaf-first addresses)
+                SamplingResult* result = nullptr;
+
+                template <typename T>
+                static T field(const char*& cursor) {
+                    T value;
+                    std::memcpy(&value, cursor, sizeof(T));
+                    cursor += sizeof(T);
+                    return value;
+                }
+
+                void handle(const std::vector<char>& record) {
+                    perf_event_header header;
+                    std::memcpy(&header, record.data(), sizeof(header));
+                    const char* cursor = record.data() + sizeof(header);
+                    const char* end = record.data() + record.size();
+
+                    if (header.type == PERF_RECORD_MMAP) {
+                        const uint32_t pid = field<uint32_t>(cursor);
+                        field<uint32_t>(cursor);
+                        Mapping mapping;
+                        mapping.start = field<uint64_t>(cursor);
+                        mapping.end = mapping.start + field<uint64_t>(cursor);
+                        mapping.pgoff = field<uint64_t>(cursor);
+                        mapping.file.assign(cursor, strnlen(cursor, static_cast<size_t>(end - cursor)));
+                        mappings[pid].push_back(mapping);
+                    } else if (header.type == PERF_RECORD_COMM) {
+                        const uint32_t pid = field<uint32_t>(cursor);
+                        field<uint32_t>(cursor);
+                        names[pid].assign(cursor, strnlen(cursor, static_cast<size_t>(end - cursor)));
+                    } else if (header.type == PERF_RECORD_FORK) {
+                        const uint32_t pid = field<uint32_t>(cursor);
+                        const uint32_t ppid = field<uint32_t>(cursor);
+                        if (pid != ppid) parents[pid] = ppid;
+                    } else if (header.type == PERF_RECORD_LOST) {
+                        field<uint64_t>(cursor);
+                        result->lost += field<uint64_t>(cursor);
+                    } else if (header.type == PERF_RECORD_SAMPLE) {
+                        field<uint64_t>(cursor);  // ip, repeated as the first user frame of the callchain
+                        const uint32_t pid = field<uint32_t>(cursor);
+                        field<uint32_t>(cursor);
+                        const uint64_t count = field<uint64_t>(cursor);
+                        std::vector<uint64_t> addresses;
+                        for (uint64_t i = 0; i < count && cursor + sizeof(uint64_t) <= end; ++i) {
+                            const uint64_t address = field<uint64_t>(cursor);
+                            if (address >= static_cast<uint64_t>(PERF_CONTEXT_MAX)) continue;  // context marker
+                            // Return addresses point after the call instruction
+                            addresses.push_back(addresses.empty() ? address : address - 1);
+                        }
+                        ++raw_stacks[{pid, addresses}];
+                        ++result->samples;
+                    }
+                }
+
+                // Mappings of a process: its own (newest first), then those inherited from its parents
+                std::string symbolize(Symbolizer& symbolizer, uint32_t pid, uint64_t address) {
+                    for (int hops = 0; hops < 64; ++hops) {
+                        const std::string frame = symbolizer.symbolize(mappings[pid], address);
+                        auto parent = parents.find(pid);
+                        if (frame != "[unknown]" || parent == parents.end()) return frame;
+                        pid = parent->second;
+                    }
+                    return "[unknown]";
+                }
+
+                void fold(const std::string& default_name) {
+                    Symbolizer symbolizer;
+                    for (const auto& entry : raw_stacks) {
+                        const uint32_t pid = entry.first.first;
+                        const auto& addresses = entry.first.second;
+                        std::string stack = names.count(pid) ? names[pid] : default_name;
+                        for (auto it = addresses.rbegin(); it != addresses.rend(); ++it) {
+                            stack += ";" + symbolize(symbolizer, pid, *it);
+                        }
+                        result->stacks[stack] += entry.second;
+                    }
+                }
+            };
+
+            // Consume all complete records between data_tail and data_head
+            void drain_ring_buffer(char* base, size_t page_size, size_t data_size, SampleCollector& collector) {
+                auto* meta = reinterpret_cast<perf_event_mmap_page*>(base);
+                const char* data = base + page_size;
+                const uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+                uint64_t tail = meta->data_tail;
+                std::vector<char> record;
+                auto copy = [&](uint64_t from, size_t size) {
+                    record.resize(size);
+                    for (size_t i = 0; i < size; ++i) record[i] = data[(from + i) % data_size];
+                };
+                while (tail + sizeof(perf_event_header) <= head) {
+                    copy(tail, sizeof(perf_event_header));
+                    perf_event_header header;
+                    std::memcpy(&header, record.data(), sizeof(header));
+                    if (header.size < sizeof(header) || tail + header.size > head) break;
+                    copy(tail, header.size);
+                    collector.handle(record);
+                    tail += header.size;
+                }
+                __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+            }
+#endif
+
+            std::string xml_escape(const std::string& text) {
+                std::string escaped;
+                for (char c : text) {
+                    switch (c) {
+                        case '&': escaped += "&amp;"; break;
+                        case '<': escaped += "&lt;"; break;
+                        case '>': escaped += "&gt;"; break;
+                        case '"': escaped += "&quot;"; break;
+                        default: escaped += c; break;
+                    }
+                }
+                return escaped;
+            }
+
+            struct FlameNode {
+                unsigned long long value = 0;
+                std::map<std::string, FlameNode> children;
+            };
+
+            size_t flame_depth(const FlameNode& node) {
+                size_t depth = 0;
+                for (const auto& child : node.children) depth = std::max(depth, flame_depth(child.second) + 1);
+                return depth;
+            }
+        }
+
+        bool sample_process(const std::vector<std::string>& argv, unsigned frequency, SamplingResult& result, std::string& error) {
+#ifndef __linux__
+            (void)argv;
+            (void)frequency;
+            (void)result;
+            error = "sampling uses perf_event_open, which is only available on Linux";
+            return false;
+#else
+            if (argv.empty()) {
+                error = "no program to profile";
+                return false;
+            }
+            int gate = -1;
+            const pid_t child = start_gated_child(argv, false, gate, error);
+            if (child < 0) {
+                return false;
+            }
+
+            // CPU-clock is a software event, so it works in VMs and containers without a PMU
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_SOFTWARE;
+            attr.config = PERF_COUNT_SW_CPU_CLOCK;
+            attr.freq = 1;
+            attr.sample_freq = frequency;
+            attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+            attr.disabled = 1;
+            attr.enable_on_exec = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.exclude_callchain_kernel = 1;
+            attr.mmap = 1;
+            attr.comm = 1;
+            attr.comm_exec = 1;
+            attr.task = 1;
+            // Inherited events can only be mmapped per CPU, so open one event (and ring buffer) per CPU
+            struct RingBuffer {
+                int fd;
+                char* base;
+            };
+            std::vector<RingBuffer> rings;
+            const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            const size_t data_size = 128 * page_size;
+            const long cpu_count = sysconf(_SC_NPROCESSORS_CONF);
+            auto close_rings = [&]() {
+                for (const auto& ring : rings) {
+                    munmap(ring.base, page_size + data_size);
+                    close(ring.fd);
+                }
+            };
+            for (long cpu = 0; cpu < cpu_count && error.empty(); ++cpu) {
+                const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, child, static_cast<int>(cpu), -1, PERF_FLAG_FD_CLOEXEC));
+                if (fd < 0) {
+                    if (errno == ENODEV) continue;  // offline CPU
+                    error = perf_open_error(errno);
+                    break;
+                }
+                void* base = mmap(nullptr, page_size + data_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (base == MAP_FAILED) {
+                    error = std::string("mmap of the perf ring buffer: ") + std::strerror(errno);
+                    close(fd);
+                    break;
+                }
+                rings.push_back({fd, static_cast<char*>(base)});
+            }
+            if (error.empty() && rings.empty()) {
+                error = "perf_event_open: no usable CPU";
+            }
+            if (!error.empty()) {
+                close_rings();
+                release_gated_child(gate, false);
+                waitpid(child, nullptr, 0);
+                return false;
+            }
+
+            SampleCollector collector;
+            collector.result = &result;
+
+            // Ctrl-C stops the profiled program, not the profiler, so the samples taken so far are kept
+            struct sigaction ignore, previous;
+            std::memset(&ignore, 0, sizeof(ignore));
+            ignore.sa_handler = SIG_IGN;
+            sigaction(SIGINT, &ignore, &previous);
+
+            release_gated_child(gate, true);
+            std::vector<pollfd> pfds;
+            for (const auto& ring : rings) pfds.push_back({ring.fd, POLLIN, 0});
+            int status = 0;
+            for (bool running = true; running;) {
+                poll(pfds.data(), pfds.size(), 100);
+                const pid_t done = waitpid(child, &status, WNOHANG);
+                running = done == 0 || (done < 0 && errno == EINTR);
+                for (const auto& ring : rings) {
+                    drain_ring_buffer(ring.base, page_size, data_size, collector);
+                }
+            }
+            sigaction(SIGINT, &previous, nullptr);
+            close_rings();
+
+            collector.fold(std::filesystem::path(argv[0]).filename().string());
+            result.exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            return true;
+#endif
+        }
+
+        const char* counter_name(Counter counter) {
+            switch (counter) {
+                case Counter::task_clock: return "task-clock";
+                case Counter::cycles: return "cycles";
+                case Counter::instructions: return "instructions";
+                case Counter::cache_misses: return "cache-misses";
+                case Counter::branch_misses: return "branch-misses";
+                case Counter::page_faults: return "page-faults";
+            }
+            return "";
+        }
+        
+        bool count_process(const std::vector<std::string>& argv, const std::vector<Counter>& counters, bool quiet,
+                           CountingResult& result, std::string& error) {
+#ifndef __linux__
+            (void)argv;
+            (void)counters;
+            (void)quiet;
+            (void)result;
+            error = "hardware counters use perf_event_open, which is only available on Linux";
+            return false;
+#else
+            if (argv.empty()) {
+                error = "no program to run";
+                return false;
+            }
+            int gate = -1;
+            const pid_t child = start_gated_child(argv, quiet, gate, error);
+            if (child < 0) {
+                return false;
+            }
+            
+            // One independent counter per event; when there are more than the PMU has registers the
+            // kernel time-slices them, and the enabled/running times let the counts be scaled back up
+            std::vector<int> fds;
+            result.readings.clear();
+            for (Counter counter : counters) {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                switch (counter) {
+                    case Counter::task_clock: attr.type = PERF_TYPE_SOFTWARE; attr.config = PERF_COUNT_SW_TASK_CLOCK; break;
+                    case Counter::cycles: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+                    case Counter::instructions: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+                    case Counter::cache_misses: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+                    case Counter::branch_misses: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+                    case Counter::page_faults: attr.type = PERF_TYPE_SOFTWARE; attr.config = PERF_COUNT_SW_PAGE_FAULTS; break;
+                }
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                attr.disabled = 1;
+                attr.enable_on_exec = 1;
+                attr.inherit = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, child, -1, -1, PERF_FLAG_FD_CLOEXEC));
+                if (fd < 0 && errno != ENOENT && errno != EOPNOTSUPP && errno != ENODEV && errno != EINVAL) {
+                    error = perf_open_error(errno);
+                    break;
+                }
+                CounterReading reading;
+                reading.counter = counter;
+                reading.supported = fd >= 0;
+                result.readings.push_back(reading);
+                fds.push_back(fd);
+            }
+            auto close_counters = [&]() {
+                for (int fd : fds) {
+                    if (fd >= 0) close(fd);
+                }
+            };
+            if (!error.empty()) {
+                close_counters();
+                release_gated_child(gate, false);
+                waitpid(child, nullptr, 0);
+                return false;
+            }
+            
+            const auto start = std::chrono::steady_clock::now();
+            release_gated_child(gate, true);
+            int status = 0;
+            while (waitpid(child, &status, 0) < 0 && errno == EINTR) {
+            }
+            result.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            result.exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            
+            for (size_t i = 0; i < fds.size(); ++i) {
+                unsigned long long values[3] = {0, 0, 0}; // value, time enabled, time running
+                CounterReading& reading = result.readings[i];
+                if (fds[i] < 0 || read(fds[i], values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)) || values[2] == 0) {
+                    reading.supported = false;
+                    continue;
+                }
+                reading.running_fraction = static_cast<double>(values[2]) / static_cast<double>(values[1]);
+                reading.value = static_cast<double>(values[0]) / reading.running_fraction;
+            }
+            close_counters();
+            return true;
+#endif
+        }
+        
+        std::string format_folded_stacks(const FoldedStacks& stacks) {
+            std::ostringstream out;
+            for (const auto& entry : stacks) {
+                out << entry.first << " " << entry.second << "\n";
+            }
+            return out.str();
+        }
+
+        std::string render_flamegraph_svg(const FoldedStacks& stacks, const std::string& title) {
+            FlameNode root;
+            for (const auto& entry : stacks) {
+                root.value += entry.second;
+                FlameNode* node = &root;
+                std::istringstream frames(entry.first);
+                std::string frame;
+                while (std::getline(frames, frame, ';')) {
+                    node = &node->children[frame];
+                    node->value += entry.second;
+                }
+            }
+
+            const double width = 1200, padding = 10, frame_height = 16, top = 40;
+            const size_t depth = flame_depth(root);
+            const double height = top + frame_height * static_cast<double>(depth) + 30;
+            const double scale = root.value ? (width - 2 * padding) / static_cast<double>(root.value) : 0;
+
+            std::ostringstream svg;
+            svg << std::fixed << std::setprecision(1);
+            svg << "<?xml version=\"1.0\" standalone=\"no\"?>\n";
+            svg << "<svg version=\"1.1\" width=\"" << width << "\" height=\"" << height << "\" viewBox=\"0 0 " << width << " " << height
+                << "\" xmlns=\"http://www.w3.org/2000/svg\" font-family=\"monospace\" font-size=\"12\">\n";
+            svg << "<rect x=\"0\" y=\"0\" width=\"100%\" height=\"100%\" fill=\"#f8f8f2\"/>\n";
+            svg << "<text x=\"" << width / 2 << "\" y=\"24\" text-anchor=\"middle\" font-size=\"17\">" << xml_escape(title) << "</text>\n";
+            svg << "<text x=\"" << padding << "\" y=\"" << height - 10 << "\">" << root.value
+                << " samples - hover a frame for details</text>\n";
+
+            // Depth-first layout, children sorted by name as in flamegraph.pl; the root frame is at the bottom
+            struct Item {
+                const std::string* name;
+                const FlameNode* node;
+                double x;
+                size_t level;
+            };
+            const std::string all = "all";
+            std::vector<Item> pending = {{&all, &root, padding, 0}};
+            while (!pending.empty()) {
+                const Item item = pending.back();
+                pending.pop_back();
+                const double w = static_cast<double>(item.node->value) * scale;
+                if (w < 0.3) continue;
+                const double y = height - 30 - frame_height * static_cast<double>(item.level + 1);
+                const double percent = 100.0 * static_cast<double>(item.node->value) / static_cast<double>(root.value);
+                const unsigned long long hash = hash_content(*item.name);
+                svg << "<g><title>" << xml_escape(*item.name) << " (" << item.node->value << " samples, " << percent << "%)</title>";
+                svg << "<rect x=\"" << item.x << "\" y=\"" << y << "\" width=\"" << w << "\" height=\"" << frame_height - 1
+                    << "\" rx=\"2\" fill=\"rgb(" << 205 + hash % 50 << "," << (hash >> 8) % 200 << "," << (hash >> 16) % 55 << ")\"/>";
+                const size_t chars = w > 6 ? static_cast<size_t>((w - 6) / 7.2) : 0;
+                if (chars >= 3) {
+                    std::string label = item.name->size() <= chars ? *item.name : item.name->substr(0, chars - 2) + "..";
+                    svg << "<text x=\"" << item.x + 3 << "\" y=\"" << y + 11.5 << "\">" << xml_escape(label) << "</text>";
+                }
+                svg << "</g>\n";
+
+                double x = item.x;
+                for (const auto& child : item.node->children) {
+                    pending.push_back({&child.first, &child.second, x, item.level + 1});
+                    x += static_cast<double>(child.second.value) * scale;
+                }
+            }
+            svg << "</svg>\n";
+            return svg.str();
+        }
+    }
+}
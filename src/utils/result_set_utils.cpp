@@ -0,0 +1,194 @@
+#include "result_set_utils.h"
+#include "file_utils.h"
+#include "build_utils.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace ctc {
+    namespace utils {
+        
+        namespace {
+            // A small JSON reader for the files ctc writes itself (the bench/ harness and 'ctc stat')
+            class ResultReader {
+            public:
+                ResultReader(const std::string& text, const std::string& key_member, std::vector<ResultRecord>& records)
+                    : text_(text), key_member_(key_member), records_(records) {}
+                
+                bool read_document() {
+                    if (!read_value(nullptr, "", 0)) return false;
+                    skip_whitespace();
+                    return pos_ == text_.size();
+                }
+            
+            private:
+                const std::string& text_;
+                const std::string& key_member_;
+                std::vector<ResultRecord>& records_;
+                size_t pos_ = 0;
+                
+                void skip_whitespace() {
+                    while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+                }
+                
+                bool read_string(std::string& value) {
+                    if (pos_ >= text_.size() || text_[pos_] != '"') return false;
+                    value.clear();
+                    for (++pos_; pos_ < text_.size(); ++pos_) {
+                        char c = text_[pos_];
+                        if (c == '"') {
+                            ++pos_;
+                            return true;
+                        }
+                        if (c == '\\') {
+                            if (++pos_ >= text_.size()) return false;
+                            c = text_[pos_];
+                            if (c == 'n') c = '\n';
+                            else if (c == 't') c = '\t';
+                            else if (c == 'u') return false; // never written by ctc
+                        }
+                        value += c;
+                    }
+                    return false;
+                }
+                
+                bool read_number(double& value) {
+                    const char* begin = text_.c_str() + pos_;
+                    char* end = nullptr;
+                    value = std::strtod(begin, &end);
+                    if (end == begin) return false;
+                    pos_ += static_cast<size_t>(end - begin);
+                    return true;
+                }
+                
+                // One value; members of owner (the enclosing object) are recorded under member
+                bool read_value(ResultRecord* owner, const std::string& member, int depth) {
+                    if (depth > 32) return false;
+                    skip_whitespace();
+                    if (pos_ >= text_.size()) return false;
+                    const char c = text_[pos_];
+                    if (c == '{') return read_object(depth + 1);
+                    if (c == '[') return read_array(owner, member, depth + 1);
+                    if (c == '"') {
+                        std::string value;
+                        if (!read_string(value)) return false;
+                        if (owner) owner->strings[member] = value;
+                        return true;
+                    }
+                    for (const char* literal : {"true", "false", "null"}) {
+                        if (text_.compare(pos_, std::strlen(literal), literal) == 0) {
+                            pos_ += std::strlen(literal);
+                            return true;
+                        }
+                    }
+                    double number = 0;
+                    if (!read_number(number)) return false;
+                    if (owner) owner->numbers[member] = number;
+                    return true;
+                }
+                
+                bool read_object(int depth) {
+                    ResultRecord record;
+                    ++pos_;
+                    skip_whitespace();
+                    if (pos_ < text_.size() && text_[pos_] == '}') {
+                        ++pos_;
+                        return true;
+                    }
+                    while (true) {
+                        skip_whitespace();
+                        std::string member;
+                        if (!read_string(member)) return false;
+                        skip_whitespace();
+                        if (pos_ >= text_.size() || text_[pos_] != ':') return false;
+                        ++pos_;
+                        if (!read_value(&record, member, depth)) return false;
+                        skip_whitespace();
+                        if (pos_ < text_.size() && text_[pos_] == ',') {
+                            ++pos_;
+                        } else if (pos_ < text_.size() && text_[pos_] == '}') {
+                            ++pos_;
+                            break;
+                        } else {
+                            return false;
+                        }
+                    }
+                    if (record.strings.count(key_member_)) {
+                        records_.push_back(std::move(record));
+                    }
+                    return true;
+                }
+                
+                // Arrays of numbers are recorded; objects inside arrays are read as records of their own
+                bool read_array(ResultRecord* owner, const std::string& member, int depth) {
+                    std::vector<double> numbers;
+                    bool only_numbers = true;
+                    ++pos_;
+                    skip_whitespace();
+                    if (pos_ < text_.size() && text_[pos_] == ']') {
+                        ++pos_;
+                    } else {
+                        while (true) {
+                            skip_whitespace();
+                            double number = 0;
+                            if (read_number(number)) {
+                                numbers.push_back(number);
+                            } else {
+                                only_numbers = false;
+                                if (!read_value(nullptr, "", depth)) return false;
+                            }
+                            skip_whitespace();
+                            if (pos_ < text_.size() && text_[pos_] == ',') {
+                                ++pos_;
+                            } else if (pos_ < text_.size() && text_[pos_] == ']') {
+                                ++pos_;
+                                break;
+                            } else {
+                                return false;
+                            }
+                        }
+                    }
+                    if (owner && only_numbers) {
+                        owner->number_arrays[member] = std::move(numbers);
+                    }
+                    return true;
+                }
+            };
+        }
+        
+        bool is_valid_result_set_name(const std::string& name) {
+            return !name.empty() && name != "latest" && name[0] != '.' && name[0] != '-' &&
+                   name.find_first_of("/\\") == std::string::npos;
+        }
+        
+        std::string current_commit_name() {
+            std::string output;
+            if (capture_command_output({"git", "rev-parse", "--short", "HEAD"}, output) != 0) {
+                return "";
+            }
+            output.erase(output.find_last_not_of(" \r\n") + 1);
+            return output;
+        }
+        
+        bool save_result_set(const std::filesystem::path& results_dir, const std::string& name) {
+            const std::filesystem::path saved = results_dir / (name + ".json");
+            if (!write_file(saved, read_file(results_dir / "latest.json"))) {
+                std::cerr << "Failed to save " << saved.generic_string() << "\n";
+                return false;
+            }
+            std::cout << "Saved results as '" << name << "' (" << saved.generic_string() << ")\n";
+            return true;
+        }
+        
+        std::vector<ResultRecord> read_result_records(const std::filesystem::path& path, const std::string& key_member) {
+            const std::string text = read_file(path);
+            std::vector<ResultRecord> records;
+            ResultReader reader(text, key_member, records);
+            if (text.empty() || !reader.read_document()) {
+                return {};
+            }
+            return records;
+        }
+    }
+}
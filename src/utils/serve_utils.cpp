@@ -0,0 +1,259 @@
+#include "serve_utils.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace ctc {
+    namespace utils {
+        
+        namespace {
+            const char serve_magic[4] = {'C', 'T', 'C', '1'};
+
+#ifndef _WIN32
+            // Connection to the daemon while a forwarded command runs, for the signal handler
+            volatile sig_atomic_t forwarding_fd = -1;
+            
+            // Ctrl-C and friends go to the daemon as one byte; it signals the command's process
+            void forward_signal_to_server(int signal_number) {
+                const int fd = forwarding_fd;
+                if (fd >= 0) {
+                    const unsigned char byte = static_cast<unsigned char>(signal_number);
+                    (void)!write(fd, &byte, 1);
+                }
+            }
+            
+            bool read_all(int fd, char* data, size_t size) {
+                while (size > 0) {
+                    const ssize_t got = read(fd, data, size);
+                    if (got < 0 && errno == EINTR) continue;
+                    if (got <= 0) return false;
+                    data += got;
+                    size -= static_cast<size_t>(got);
+                }
+                return true;
+            }
+#endif
+        }
+        
+#ifndef _WIN32
+        bool is_private_directory(const std::filesystem::path& directory) {
+            struct stat info;
+            return lstat(directory.empty() ? "." : directory.c_str(), &info) == 0 && S_ISDIR(info.st_mode) &&
+                   info.st_uid == getuid() && (info.st_mode & 077) == 0;
+        }
+        
+        bool peer_is_this_user(int fd) {
+#ifdef __linux__
+            struct ucred peer;
+            socklen_t peer_size = sizeof(peer);
+            return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &peer_size) == 0 && peer.uid == getuid();
+#else
+            (void)fd;
+            return false; // ctc serve only runs on Linux
+#endif
+        }
+#endif
+        
+        std::filesystem::path serve_socket_path() {
+#ifdef _WIN32
+            return {};
+#else
+            const char* explicit_path = std::getenv("CTC_SERVE_SOCKET");
+            if (explicit_path && *explicit_path) {
+                return explicit_path;
+            }
+            const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+            if (runtime_dir && *runtime_dir) {
+                return std::filesystem::path(runtime_dir) / "ctc" / "serve.sock";
+            }
+            return std::filesystem::path("/tmp") / ("ctc-" + std::to_string(getuid())) / "serve.sock";
+#endif
+        }
+        
+        std::string encode_serve_request(const ServeRequest& request) {
+            std::string payload;
+            auto add = [&payload](const std::string& field) {
+                payload += field;
+                payload += '\0';
+            };
+            add(request.cwd);
+            add(request.command);
+            add(std::to_string(request.umask));
+            add(std::to_string(request.args.size()));
+            for (const auto& arg : request.args) add(arg);
+            add(std::to_string(request.environment.size()));
+            for (const auto& entry : request.environment) add(entry);
+            
+            const uint32_t size = static_cast<uint32_t>(payload.size());
+            std::string message(serve_magic, sizeof(serve_magic));
+            message.append(reinterpret_cast<const char*>(&size), sizeof(size));
+            return message + payload;
+        }
+        
+        bool decode_serve_request(const std::string& payload, ServeRequest& request) {
+            size_t offset = 0;
+            auto next = [&payload, &offset](std::string& field) {
+                const size_t end = payload.find('\0', offset);
+                if (end == std::string::npos) return false;
+                field = payload.substr(offset, end - offset);
+                offset = end + 1;
+                return true;
+            };
+            auto next_count = [&next](size_t& count) {
+                std::string field;
+                if (!next(field) || field.empty() || field.size() > 9 || field.find_first_not_of("0123456789") != std::string::npos) {
+                    return false;
+                }
+                count = std::stoul(field);
+                return true;
+            };
+            
+            size_t umask_value = 0;
+            size_t count = 0;
+            if (!next(request.cwd) || !next(request.command) || !next_count(umask_value) || !next_count(count)) {
+                return false;
+            }
+            request.umask = static_cast<unsigned>(umask_value);
+            request.args.assign(count, "");
+            for (auto& arg : request.args) {
+                if (!next(arg)) return false;
+            }
+            if (!next_count(count)) {
+                return false;
+            }
+            request.environment.assign(count, "");
+            for (auto& entry : request.environment) {
+                if (!next(entry)) return false;
+            }
+            return offset == payload.size();
+        }
+        
+        bool forward_to_server(const std::string& command, const std::vector<std::string>& args, int& status) {
+#ifdef _WIN32
+            (void)command;
+            (void)args;
+            (void)status;
+            return false;
+#else
+            const char* disabled = std::getenv("CTC_NO_SERVE");
+            if (disabled && *disabled && std::strcmp(disabled, "0") != 0) {
+                return false;
+            }
+            // Stat first: without a daemon, plain commands only pay for this one system call
+            const std::filesystem::path socket_path = serve_socket_path();
+            struct stat info;
+            if (stat(socket_path.c_str(), &info) != 0 || !S_ISSOCK(info.st_mode)) {
+                return false;
+            }
+            // The request carries the environment and this process's stdout/stderr, so only a daemon of
+            // this user may get it: a socket directory someone else created (e.g. /tmp/ctc-<uid> made
+            // first by another user) or can write to is not trusted
+            if (!is_private_directory(socket_path.parent_path())) {
+                return false;
+            }
+            struct sockaddr_un address;
+            std::memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            if (socket_path.native().size() >= sizeof(address.sun_path)) {
+                return false;
+            }
+            std::strcpy(address.sun_path, socket_path.c_str());
+            const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd < 0) {
+                return false;
+            }
+            if (connect(fd, reinterpret_cast<const struct sockaddr*>(&address), sizeof(address)) != 0) {
+                close(fd); // a socket left behind by a daemon that is gone
+                return false;
+            }
+            if (!peer_is_this_user(fd)) {
+                close(fd);
+                return false;
+            }
+            
+            ServeRequest request;
+            std::error_code ec;
+            request.cwd = std::filesystem::current_path(ec).string();
+            request.command = command;
+            request.args = args;
+            for (char** entry = environ; entry && *entry; ++entry) {
+                request.environment.push_back(*entry);
+            }
+            const mode_t mask = ::umask(0);
+            ::umask(mask);
+            request.umask = static_cast<unsigned>(mask);
+            const std::string message = encode_serve_request(request);
+            
+            // The command writes straight to this process's stdout and stderr (a terminal keeps its colors)
+            std::cout.flush();
+            std::cerr.flush();
+            const int fds[2] = {STDOUT_FILENO, STDERR_FILENO};
+            alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+            std::memset(control, 0, sizeof(control));
+            struct iovec iov = {const_cast<char*>(message.data()), message.size()};
+            struct msghdr header;
+            std::memset(&header, 0, sizeof(header));
+            header.msg_iov = &iov;
+            header.msg_iovlen = 1;
+            header.msg_control = control;
+            header.msg_controllen = sizeof(control);
+            struct cmsghdr* rights = CMSG_FIRSTHDR(&header);
+            rights->cmsg_level = SOL_SOCKET;
+            rights->cmsg_type = SCM_RIGHTS;
+            rights->cmsg_len = CMSG_LEN(sizeof(fds));
+            std::memcpy(CMSG_DATA(rights), fds, sizeof(fds));
+            
+            ssize_t sent = sendmsg(fd, &header, MSG_NOSIGNAL);
+            while (sent > 0 && static_cast<size_t>(sent) < message.size()) {
+                const ssize_t more = send(fd, message.data() + sent, message.size() - static_cast<size_t>(sent), MSG_NOSIGNAL);
+                if (more < 0 && errno == EINTR) continue;
+                sent = more < 0 ? more : sent + more;
+            }
+            if (sent < 0) {
+                close(fd); // nothing was started; run the command here instead
+                return false;
+            }
+            
+            // Wait for the exit status, passing termination signals on meanwhile
+            forwarding_fd = fd;
+            struct sigaction forward;
+            std::memset(&forward, 0, sizeof(forward));
+            forward.sa_handler = forward_signal_to_server;
+            forward.sa_flags = SA_RESTART;
+            sigemptyset(&forward.sa_mask);
+            struct sigaction previous[3];
+            const int signals[3] = {SIGINT, SIGTERM, SIGHUP};
+            for (int i = 0; i < 3; ++i) {
+                sigaction(signals[i], &forward, &previous[i]);
+            }
+            int32_t reply = 0;
+            const bool answered = read_all(fd, reinterpret_cast<char*>(&reply), sizeof(reply));
+            for (int i = 0; i < 3; ++i) {
+                sigaction(signals[i], &previous[i], nullptr);
+            }
+            forwarding_fd = -1;
+            close(fd);
+            
+            if (!answered) {
+                std::cerr << "Error: ctc serve closed the connection before '" << command << "' finished\n";
+                status = 1;
+            } else {
+                status = reply;
+            }
+            return true;
+#endif
+        }
+    }
+}
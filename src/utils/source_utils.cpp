@@ -0,0 +1,437 @@
+#include "source_utils.h"
+#include "file_utils.h"
+#include <sstream>
+#include <iostream>
+#include <functional>
+#include <cctype>
+#include <algorithm>
+#include <iomanip>
+
+namespace ctc {
+    namespace utils {
+        
+        namespace {
+            // Set by set_warm_source_layout
+            struct WarmLayout {
+                std::filesystem::path cache_dir;    // absolute; empty if none
+                SourceLayout layout;
+                std::string warnings;
+            } warm;
+            
+            std::filesystem::path absolute_path(const std::filesystem::path& path) {
+                std::error_code ec;
+                const std::filesystem::path absolute = std::filesystem::absolute(path, ec);
+                return ec ? path : absolute.lexically_normal();
+            }
+            
+            struct CachedScan {
+                long long mtime = 0;
+                unsigned long long size = 0;
+                unsigned long long hash = 0;
+                std::vector<IncludeDirective> includes;
+            };
+            
+            long long file_mtime(const std::filesystem::path& path) {
+                std::error_code ec;
+                auto time = std::filesystem::last_write_time(path, ec);
+                return ec ? 0 : static_cast<long long>(time.time_since_epoch().count());
+            }
+            
+            // Cache line: <path>\t<mtime>\t<size>\t<hash>\t<A|Q><header>\t<A|Q><header>...
+            std::map<std::string, CachedScan> read_scan_cache(const std::filesystem::path& cache_path) {
+                std::map<std::string, CachedScan> cache;
+                for (const auto& line : read_lines(cache_path)) {
+                    std::istringstream in(line);
+                    std::string path, field;
+                    CachedScan scan;
+                    // A damaged line only costs a rescan of its file
+                    if (!std::getline(in, path, '\t')) continue;
+                    if (!std::getline(in, field, '\t') || !parse_integer(field, scan.mtime)) continue;
+                    if (!std::getline(in, field, '\t') || !parse_integer(field, scan.size)) continue;
+                    if (!std::getline(in, field, '\t') || !parse_integer(field, scan.hash)) continue;
+                    while (std::getline(in, field, '\t')) {
+                        if (field.size() > 1) {
+                            scan.includes.push_back({field.substr(1), field[0] == 'A'});
+                        }
+                    }
+                    cache[path] = scan;
+                }
+                return cache;
+            }
+            
+            // Library a project path (e.g. "lib/net/socket.cpp") belongs to; false if it is not under lib/
+            bool library_of(const std::string& path, std::string& name) {
+                if (path.compare(0, 4, "lib/") != 0) {
+                    return false;
+                }
+                size_t slash = path.find('/', 4);
+                name = slash == std::string::npos ? "" : path.substr(4, slash - 4);
+                return true;
+            }
+            
+            void write_scan_cache(const std::filesystem::path& cache_path, const std::map<std::string, CachedScan>& cache) {
+                std::vector<std::string> lines;
+                lines.reserve(cache.size());
+                for (const auto& kv : cache) {
+                    const CachedScan& scan = kv.second;
+                    std::string line = kv.first + "\t" + std::to_string(scan.mtime) + "\t" + std::to_string(scan.size) + "\t" + std::to_string(scan.hash);
+                    for (const auto& inc : scan.includes) {
+                        line += std::string("\t") + (inc.angled ? "A" : "Q") + inc.header;
+                    }
+                    lines.push_back(line);
+                }
+                create_directory_if_not_exists(cache_path.parent_path());
+                write_lines(cache_path, lines);
+            }
+        }
+        
+        bool is_source_file(const std::filesystem::path& path) {
+            const std::string ext = path.extension().string();
+            return ext == ".cpp" || ext == ".cc" || ext == ".c" || ext == ".cxx";
+        }
+        
+        bool is_header_file(const std::filesystem::path& path) {
+            const std::string ext = path.extension().string();
+            return ext == ".h" || ext == ".hpp" || ext == ".hh" || ext == ".hxx" || ext == ".inl";
+        }
+        
+        unsigned long long hash_content(const std::string& content) {
+            unsigned long long hash = 14695981039346656037ULL;
+            for (unsigned char c : content) {
+                hash ^= c;
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+        
+        std::vector<IncludeDirective> parse_includes(const std::string& content) {
+            std::vector<IncludeDirective> includes;
+            std::istringstream in(content);
+            std::string line;
+            while (std::getline(in, line)) {
+                // Accept "#include", "# include" and leading whitespace
+                size_t pos = line.find_first_not_of(" \t");
+                if (pos == std::string::npos || line[pos] != '#') continue;
+                pos = line.find_first_not_of(" \t", pos + 1);
+                if (pos == std::string::npos || line.compare(pos, 7, "include") != 0) continue;
+                pos = line.find_first_not_of(" \t", pos + 7);
+                if (pos == std::string::npos) continue;
+                
+                const char open = line[pos];
+                const char close = open == '<' ? '>' : (open == '"' ? '"' : '\0');
+                if (close == '\0') continue;
+                size_t end = line.find(close, pos + 1);
+                if (end == std::string::npos || end == pos + 1) continue;
+                includes.push_back({line.substr(pos + 1, end - pos - 1), open == '<'});
+            }
+            return includes;
+        }
+        
+        std::vector<std::string> list_project_files(
+            const std::vector<std::filesystem::path>& roots,
+            const std::filesystem::path& snapshot_path,
+            size_t* rescanned_dirs) {
+            // Snapshot line: <dir>\t<mtime>\t<F|D><name>\t<F|D><name>...
+            std::map<std::string, std::pair<long long, std::vector<std::string>>> snapshot;
+            for (const auto& line : read_lines(snapshot_path)) {
+                std::istringstream in(line);
+                std::string dir, field;
+                long long mtime = 0;
+                if (!std::getline(in, dir, '\t') || !std::getline(in, field, '\t') || !parse_integer(field, mtime)) continue;
+                auto& entry = snapshot[dir];
+                entry.first = mtime;
+                while (std::getline(in, field, '\t')) {
+                    entry.second.push_back(field);
+                }
+            }
+            
+            std::map<std::string, std::pair<long long, std::vector<std::string>>> updated;
+            std::vector<std::string> files;
+            std::vector<std::string> pending;
+            size_t listed = 0;
+            for (const auto& root : roots) {
+                std::error_code ec;
+                if (std::filesystem::is_directory(root, ec)) pending.push_back(root.generic_string());
+            }
+            
+            while (!pending.empty()) {
+                const std::string dir = pending.back();
+                pending.pop_back();
+                
+                // A directory's mtime changes when entries are added, removed or renamed,
+                // so an unchanged mtime means its cached listing is still valid
+                const long long mtime = file_mtime(dir);
+                auto cached = snapshot.find(dir);
+                std::vector<std::string> entries;
+                if (cached != snapshot.end() && cached->second.first == mtime) {
+                    entries = cached->second.second;
+                } else {
+                    std::error_code ec;
+                    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+                        std::error_code type_ec;
+                        if (entry.is_directory(type_ec)) {
+                            entries.push_back("D" + entry.path().filename().generic_string());
+                        } else if (entry.is_regular_file(type_ec)) {
+                            entries.push_back("F" + entry.path().filename().generic_string());
+                        }
+                    }
+                    std::sort(entries.begin(), entries.end());
+                    ++listed;
+                }
+                
+                for (const auto& entry : entries) {
+                    const std::string path = dir + "/" + entry.substr(1);
+                    if (entry[0] == 'D') {
+                        pending.push_back(path);
+                    } else if (is_source_file(path) || is_header_file(path)) {
+                        files.push_back(path);
+                    }
+                }
+                updated[dir] = {mtime, std::move(entries)};
+            }
+            
+            if (listed > 0 || updated.size() != snapshot.size()) {
+                std::vector<std::string> lines;
+                for (const auto& kv : updated) {
+                    std::string line = kv.first + "\t" + std::to_string(kv.second.first);
+                    for (const auto& entry : kv.second.second) {
+                        line += "\t" + entry;
+                    }
+                    lines.push_back(line);
+                }
+                create_directory_if_not_exists(snapshot_path.parent_path());
+                write_lines(snapshot_path, lines);
+            }
+            if (rescanned_dirs) {
+                *rescanned_dirs = listed;
+            }
+            
+            std::sort(files.begin(), files.end());
+            return files;
+        }
+        
+        std::map<std::string, std::vector<IncludeDirective>> scan_includes(
+            const std::vector<std::string>& files,
+            const std::filesystem::path& cache_path,
+            size_t* rescanned) {
+            std::map<std::string, CachedScan> cache = read_scan_cache(cache_path);
+            std::map<std::string, CachedScan> updated;
+            size_t parsed = 0;
+            bool changed = false;
+            
+            for (const auto& key : files) {
+                const std::filesystem::path path = key;
+                std::error_code ec;
+                CachedScan scan;
+                scan.mtime = file_mtime(path);
+                scan.size = static_cast<unsigned long long>(std::filesystem::file_size(path, ec));
+                if (ec) continue;
+                
+                auto cached = cache.find(key);
+                if (cached != cache.end() && cached->second.mtime == scan.mtime && cached->second.size == scan.size) {
+                    updated[key] = cached->second;
+                    continue;
+                }
+                
+                // mtime or size changed: only re-parse if the content actually differs
+                const std::string content = read_file(path);
+                scan.hash = hash_content(content);
+                if (cached != cache.end() && cached->second.hash == scan.hash) {
+                    scan.includes = cached->second.includes;
+                } else {
+                    scan.includes = parse_includes(content);
+                    ++parsed;
+                }
+                updated[key] = scan;
+                changed = true;
+            }
+            
+            if (changed || updated.size() != cache.size()) {
+                write_scan_cache(cache_path, updated);
+            }
+            if (rescanned) {
+                *rescanned = parsed;
+            }
+            
+            std::map<std::string, std::vector<IncludeDirective>> result;
+            for (auto& kv : updated) {
+                result[kv.first] = std::move(kv.second.includes);
+            }
+            return result;
+        }
+        
+        std::string LibraryTarget::target_suffix() const {
+            if (name.empty()) {
+                return "lib";
+            }
+            std::string suffix = "lib_" + name;
+            for (auto& c : suffix) {
+                if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') c = '_';
+            }
+            return tag.empty() ? suffix : suffix + "_" + tag;
+        }
+        
+        const std::vector<std::filesystem::path>& project_source_roots() {
+            static const std::vector<std::filesystem::path> roots = {"app", "lib", "include", "bench"};
+            return roots;
+        }
+        
+        void set_warm_source_layout(const std::filesystem::path& cache_dir, const SourceLayout& layout, const std::string& warnings) {
+            warm.cache_dir = cache_dir.empty() ? cache_dir : absolute_path(cache_dir);
+            warm.layout = layout;
+            warm.warnings = warnings;
+        }
+        
+        SourceLayout scan_source_layout(const std::filesystem::path& cache_dir) {
+            if (!warm.cache_dir.empty() && warm.cache_dir == absolute_path(cache_dir)) {
+                std::cerr << warm.warnings;
+                return warm.layout;
+            }
+            std::string warnings;
+            SourceLayout layout = scan_source_layout(cache_dir, warnings);
+            std::cerr << warnings;
+            return layout;
+        }
+        
+        SourceLayout scan_source_layout(const std::filesystem::path& cache_dir, std::string& warnings) {
+            std::ostringstream warn;
+            
+            // Always scan the same roots as 'ctc pch' so both share the caches
+            const auto files = list_project_files(project_source_roots(), cache_dir / "dir_snapshot");
+            auto includes = scan_includes(files, cache_dir / "include_cache");
+            SourceLayout layout;
+            
+            // 1. Libraries are the groups under lib/ that contain at least one source file
+            std::map<std::string, LibraryTarget> libraries;
+            std::map<std::string, std::set<std::string>> stem_owners;
+            for (const auto& file : files) {
+                std::string name;
+                if (!is_source_file(file)) continue;
+                if (library_of(file, name)) {
+                    libraries[name].name = name;
+                    libraries[name].sources.push_back(file);
+                    stem_owners[std::filesystem::path(file).stem().string()].insert(name);
+                } else if (file.compare(0, 4, "app/") == 0) {
+                    layout.app_sources.push_back(file);
+                } else if (file.compare(0, 6, "bench/") == 0) {
+                    layout.bench_sources.push_back(file);
+                }
+            }
+            
+            // lib/foo-bar and lib/foo_bar would both be ${PROJECT_NAME}_lib_foo_bar: every one of them but
+            // the directory spelled like the target gets a tag from its name's hash
+            std::map<std::string, std::vector<std::string>> by_target;
+            for (const auto& kv : libraries) {
+                by_target[kv.second.target_suffix()].push_back(kv.first);
+            }
+            for (const auto& kv : by_target) {
+                if (kv.second.size() < 2) continue;
+                for (const auto& name : kv.second) {
+                    if ("lib_" + name == kv.first) continue;
+                    std::ostringstream tag;
+                    tag << std::hex << std::setw(8) << std::setfill('0') << (hash_content(name) & 0xffffffffULL);
+                    libraries[name].tag = tag.str();
+                    warn << "Warning: lib/" << name << "/ shares the CMake target name ${PROJECT_NAME}_" << kv.first
+                         << " with another lib/ directory; it builds ${PROJECT_NAME}_" << libraries[name].target_suffix() << " instead\n";
+                }
+            }
+            
+            // Libraries owning a resolved header path
+            auto owners_of = [&](const std::string& header) {
+                std::set<std::string> owners;
+                std::string name;
+                if (library_of(header, name)) {
+                    owners.insert(name);
+                } else if (header.compare(0, 8, "include/") == 0) {
+                    size_t slash = header.find('/', 8);
+                    std::string first = slash == std::string::npos ? "" : header.substr(8, slash - 8);
+                    if (!first.empty() && libraries.count(first)) {
+                        owners.insert(first);
+                    } else {
+                        auto it = stem_owners.find(std::filesystem::path(header).stem().string());
+                        if (it != stem_owners.end()) owners = it->second;
+                    }
+                }
+                return owners;
+            };
+            
+            // Resolve an include the way the compiler would (including file's directory, include/, then lib/);
+            // empty if it is not a project file
+            auto resolve = [&](const std::string& file, const IncludeDirective& inc) {
+                const std::filesystem::path dir = std::filesystem::path(file).parent_path();
+                for (const auto& base : {dir, std::filesystem::path("include"), std::filesystem::path("lib")}) {
+                    const std::string resolved = (base / inc.header).lexically_normal().generic_string();
+                    if (includes.count(resolved)) return resolved;
+                }
+                return std::string();
+            };
+            
+            // 2. Resolve every include of every lib/ file
+            std::map<std::string, std::set<std::string>> edges;
+            for (const auto& kv : includes) {
+                std::string name;
+                if (!library_of(kv.first, name) || !libraries.count(name)) continue;
+                for (const auto& inc : kv.second) {
+                    const std::string resolved = resolve(kv.first, inc);
+                    for (const auto& owner : owners_of(resolved)) {
+                        if (owner != name && libraries.count(owner)) edges[name].insert(owner);
+                    }
+                }
+            }
+            
+            // 3. Keep the graph acyclic: drop edges that point back into the current DFS path
+            std::map<std::string, int> state; // 0 = unvisited, 1 = on stack, 2 = done
+            std::function<void(const std::string&)> visit = [&](const std::string& node) {
+                state[node] = 1;
+                for (const auto& dep : edges[node]) {
+                    if (state[dep] == 1) {
+                        warn << "Warning: include cycle between lib/" << node << " and lib/" << dep
+                                  << "; not linking lib/" << node << " to lib/" << dep << "\n";
+                        continue;
+                    }
+                    libraries[node].dependencies.insert(dep);
+                    if (state[dep] == 0) visit(dep);
+                }
+                state[node] = 2;
+            };
+            for (const auto& kv : libraries) {
+                if (state[kv.first] == 0) visit(kv.first);
+            }
+            
+            // 4. App targets: app/<name>.cpp or app/<name>/, each linked with every library.
+            // The name ends up in a CMake target (<project>_app_<name>), a variable name and a file name
+            // in bin/, and is passed to -t: letters, digits and _.+- only, not starting with '.' or '-'.
+            std::map<std::string, AppTarget> apps;
+            std::map<std::string, std::string> origins; // name -> app/<name>.cpp or app/<name>/ it came from
+            for (const auto& file : layout.app_sources) {
+                const std::string rest = file.substr(4);
+                const size_t slash = rest.find('/');
+                const std::string name = slash == std::string::npos ? std::filesystem::path(rest).stem().string() : rest.substr(0, slash);
+                const std::string origin = slash == std::string::npos ? file : "app/" + name + "/";
+                if (name.empty() || name[0] == '.' || name[0] == '-' ||
+                    name.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_.+-") != std::string::npos) {
+                    warn << "Warning: " << origin << " skipped: '" << name << "' is not a valid executable target name"
+                         << " (use letters, digits and _.+-, not starting with '.' or '-')\n";
+                    continue;
+                }
+                // app/tool.cpp next to app/tool.c or app/tool/ would give one target two main()s
+                const auto claimed = origins.emplace(name, origin);
+                if (!claimed.second && claimed.first->second != origin) {
+                    warn << "Warning: " << origin << " skipped: " << claimed.first->second << " already builds executable '" << name << "'\n";
+                    continue;
+                }
+                apps[name].name = name;
+                apps[name].sources.push_back(file);
+            }
+            for (auto& kv : apps) {
+                layout.app_targets.push_back(std::move(kv.second));
+            }
+            
+            for (auto& kv : libraries) {
+                layout.libraries.push_back(std::move(kv.second));
+            }
+            warnings = warn.str();
+            return layout;
+        }
+    }
+}
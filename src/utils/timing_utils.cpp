@@ -0,0 +1,386 @@
+#include "timing_utils.h"
+#include "file_utils.h"
+#include "process_utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ctc {
+    namespace utils {
+
+        namespace {
+            bool is_object_file(const std::string& output) {
+                for (const char* ext : {".o", ".obj", ".gch", ".pch"}) {
+                    const std::string suffix = ext;
+                    if (output.size() > suffix.size() && output.compare(output.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // Turn an output path into a readable step: CMakeFiles/<target>.dir/<source>.o becomes
+            // <source> with <target> as detail; anything else is shown relative to the project
+            TimingEvent make_step(const std::filesystem::path& build_dir, const std::string& output, long long start_us, long long end_us) {
+                TimingEvent step;
+                step.category = is_object_file(output) ? "compile" : "link";
+                step.start_us = start_us;
+                step.duration_us = std::max(0LL, end_us - start_us);
+
+                std::filesystem::path path = output;
+                if (path.is_relative()) path = std::filesystem::absolute(build_dir / path);
+                step.output = path.generic_string();
+                std::error_code ec;
+                std::string relative = std::filesystem::relative(path, std::filesystem::absolute(build_dir), ec).generic_string();
+                const std::string prefix = "CMakeFiles/";
+                const size_t dir_end = relative.find(".dir/");
+                if (!ec && relative.compare(0, prefix.size(), prefix) == 0 && dir_end != std::string::npos) {
+                    step.name = relative.substr(dir_end + 5);
+                    step.detail = relative.substr(prefix.size(), dir_end - prefix.size());
+                    if (step.category == "compile") {
+                        step.name = std::filesystem::path(step.name).replace_extension().generic_string();
+                    }
+                } else {
+                    step.name = std::filesystem::relative(path, std::filesystem::current_path(), ec).generic_string();
+                    if (ec || step.name.empty()) step.name = path.generic_string();
+                }
+                return step;
+            }
+
+            // Minimal JSON helpers for Clang's -ftime-trace output
+            std::string read_json_string(const std::string& text, size_t pos) {
+                std::string value;
+                for (size_t i = pos; i < text.size() && text[i] != '"'; ++i) {
+                    if (text[i] == '\\' && i + 1 < text.size()) {
+                        char c = text[++i];
+                        switch (c) {
+                            case 'n': value += '\n'; break;
+                            case 't': value += '\t'; break;
+                            case 'u': value += '?'; i += 4; break;
+                            default: value += c; break;
+                        }
+                    } else {
+                        value += text[i];
+                    }
+                }
+                return value;
+            }
+
+            std::string json_string_field(const std::string& object, const std::string& key) {
+                const std::string pattern = "\"" + key + "\":";
+                size_t pos = object.find(pattern);
+                if (pos == std::string::npos) return "";
+                pos = object.find('"', pos + pattern.size());
+                return pos == std::string::npos ? "" : read_json_string(object, pos + 1);
+            }
+
+            long long json_number_field(const std::string& object, const std::string& key) {
+                const std::string pattern = "\"" + key + "\":";
+                size_t pos = object.find(pattern);
+                return pos == std::string::npos ? 0 : std::atoll(object.c_str() + pos + pattern.size());
+            }
+
+            // Split the traceEvents array into its top-level objects
+            std::vector<std::string> split_trace_events(const std::string& json) {
+                std::vector<std::string> events;
+                size_t pos = json.find("\"traceEvents\"");
+                if (pos == std::string::npos || (pos = json.find('[', pos)) == std::string::npos) return events;
+                int depth = 0;
+                bool in_string = false;
+                size_t start = 0;
+                for (size_t i = pos + 1; i < json.size(); ++i) {
+                    char c = json[i];
+                    if (in_string) {
+                        if (c == '\\') ++i;
+                        else if (c == '"') in_string = false;
+                    } else if (c == '"') {
+                        in_string = true;
+                    } else if (c == '{') {
+                        if (depth++ == 0) start = i;
+                    } else if (c == '}') {
+                        if (--depth == 0) events.push_back(json.substr(start, i - start + 1));
+                    } else if (c == ']' && depth == 0) {
+                        break;
+                    }
+                }
+                return events;
+            }
+
+            std::string json_escape(const std::string& text) {
+                std::string escaped;
+                for (char c : text) {
+                    if (c == '"' || c == '\\') {
+                        escaped += '\\';
+                        escaped += c;
+                    } else if (static_cast<unsigned char>(c) < 0x20) {
+                        escaped += ' ';
+                    } else {
+                        escaped += c;
+                    }
+                }
+                return escaped;
+            }
+
+            std::string format_seconds(long long us) {
+                std::ostringstream out;
+                out << std::fixed << std::setprecision(2) << std::setw(8) << us / 1e6 << " s";
+                return out.str();
+            }
+        }
+
+        long long wall_clock_us() {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        int run_timed_command(const std::vector<std::string>& args) {
+            if (args.size() < 3 || args[1] != "--") {
+                std::cerr << "Usage: ctc __time-compile <log> -- <command...>\n";
+                return 1;
+            }
+            std::vector<std::string> command(args.begin() + 2, args.end());
+            std::string output;
+            for (size_t i = 0; i < command.size(); ++i) {
+                if (command[i] == "-o" && i + 1 < command.size()) {
+                    output = command[i + 1];
+                } else if (command[i].size() > 2 && command[i].compare(0, 2, "-o") == 0) {
+                    output = command[i].substr(2);
+                }
+            }
+
+            const long long start = wall_clock_us();
+            // The compiler writes to the build's terminal directly, so its diagnostics keep their colors
+            ProcessOptions process;
+            process.stdout_mode = OutputMode::inherit;
+            process.stderr_mode = OutputMode::inherit;
+            const ProcessResult result = run_process(command, process);
+            if (!result.started) {
+                std::cerr << "ctc __time-compile: " << result.error << "\n";
+            }
+            const int status = result.status();
+            const long long end = wall_clock_us();
+
+            if (!output.empty()) {
+                std::error_code ec;
+                std::ostringstream entry;
+                entry << start << "\t" << end << "\t" << std::filesystem::absolute(output, ec).generic_string() << "\n";
+                const std::string line = entry.str();
+#ifdef _WIN32
+                std::ofstream log(args[0], std::ios::app | std::ios::binary);
+                log << line;
+#else
+                // Parallel jobs append to the same log; O_APPEND keeps each short line intact
+                int fd = open(args[0].c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+                if (fd >= 0) {
+                    if (write(fd, line.data(), line.size()) < 0) {
+                        std::perror("ctc __time-compile");
+                    }
+                    close(fd);
+                }
+#endif
+            }
+            return status;
+        }
+
+        std::filesystem::path timing_log_path(const std::filesystem::path& build_dir) {
+            return std::filesystem::absolute(build_dir / "ctc_step_times.log");
+        }
+
+        std::filesystem::path write_timing_project_include(const std::filesystem::path& build_dir, bool enabled,
+                                                           bool use_ninja_log, bool* changed) {
+            const std::filesystem::path path = std::filesystem::absolute(build_dir / "ctc_timings.cmake");
+            std::ostringstream content;
+            content << "# Generated by ctc run --timings (loaded through CMAKE_PROJECT_INCLUDE)\n";
+            if (!enabled) {
+                content << "# Timing is off for the last run\n";
+            } else if (!use_ninja_log) {
+                std::error_code ec;
+                std::filesystem::path self = std::filesystem::read_symlink("/proc/self/exe", ec);
+                if (!ec) {
+                    const std::string launcher = "\"" + self.generic_string() + "\" __time-compile \"" +
+                                                 timing_log_path(build_dir).generic_string() + "\" --";
+                    content << "set_property(GLOBAL PROPERTY RULE_LAUNCH_COMPILE [[" << launcher << "]])\n";
+                    content << "set_property(GLOBAL PROPERTY RULE_LAUNCH_LINK [[" << launcher << "]])\n";
+                }
+            }
+            if (enabled) {
+                content << "if(CMAKE_CXX_COMPILER_ID MATCHES \"Clang\")\n";
+                content << "    add_compile_options(-ftime-trace)\n";
+                content << "endif()\n";
+            }
+            if (!write_file(path, content.str(), changed)) {
+                return {};
+            }
+            return path;
+        }
+
+        std::set<std::string> read_ninja_log_entries(const std::filesystem::path& build_dir) {
+            std::set<std::string> entries;
+            std::istringstream in(read_file(build_dir / ".ninja_log"));
+            std::string line;
+            while (std::getline(in, line)) {
+                if (!line.empty() && line[0] != '#') entries.insert(line);
+            }
+            return entries;
+        }
+        
+        std::vector<TimingEvent> read_step_timings(const std::filesystem::path& build_dir, bool use_ninja_log,
+                                                   const std::set<std::string>& ninja_log_before, long long build_start_us) {
+            std::vector<TimingEvent> steps;
+            if (use_ninja_log) {
+                // .ninja_log v5: <start ms>\t<end ms>\t<mtime>\t<output>\t<hash>, relative to ninja's start.
+                // ninja may recompact the log (rewriting and reordering it) at startup, so this build's steps
+                // are the lines that were not there before; a rerun step differs at least in its times.
+                for (const auto& line : read_ninja_log_entries(build_dir)) {
+                    if (ninja_log_before.count(line)) continue;
+                    std::istringstream fields(line);
+                    long long start_ms = 0, end_ms = 0;
+                    std::string mtime, output;
+                    if (!(fields >> start_ms >> end_ms >> mtime >> output)) continue;
+                    steps.push_back(make_step(build_dir, output, build_start_us + start_ms * 1000, build_start_us + end_ms * 1000));
+                }
+            } else {
+                std::istringstream in(read_file(timing_log_path(build_dir)));
+                std::string line;
+                while (std::getline(in, line)) {
+                    std::istringstream fields(line);
+                    long long start_us = 0, end_us = 0;
+                    std::string output;
+                    fields >> start_us >> end_us;
+                    fields.ignore();
+                    if (!fields || !std::getline(fields, output)) continue;
+                    steps.push_back(make_step(build_dir, output, start_us, end_us));
+                }
+            }
+            std::sort(steps.begin(), steps.end(), [](const TimingEvent& a, const TimingEvent& b) {
+                return a.start_us < b.start_us;
+            });
+            return steps;
+        }
+
+        std::vector<TemplateCost> collect_template_costs(const std::vector<TimingEvent>& steps) {
+            std::map<std::string, TemplateCost> costs;
+            for (const auto& step : steps) {
+                if (step.category != "compile") continue;
+                // Clang writes the trace next to the object: foo.cpp.o -> foo.cpp.json
+                std::filesystem::path trace = step.output;
+                trace.replace_extension(".json");
+#ifndef _WIN32
+                // Steps served from a compiler cache leave the previous (stale) trace in place
+                struct stat info;
+                if (stat(trace.c_str(), &info) != 0 ||
+                    static_cast<long long>(info.st_mtime) * 1000000 < step.start_us - 1000000) {
+                    continue;
+                }
+#endif
+                for (const auto& event : split_trace_events(read_file(trace))) {
+                    const std::string name = json_string_field(event, "name");
+                    if (name != "InstantiateClass" && name != "InstantiateFunction") continue;
+                    const std::string detail = json_string_field(event, "detail");
+                    TemplateCost& cost = costs[detail];
+                    cost.name = detail;
+                    cost.total_us += json_number_field(event, "dur");
+                    ++cost.count;
+                }
+            }
+
+            std::vector<TemplateCost> sorted;
+            for (auto& entry : costs) sorted.push_back(std::move(entry.second));
+            std::sort(sorted.begin(), sorted.end(), [](const TemplateCost& a, const TemplateCost& b) {
+                return a.total_us > b.total_us;
+            });
+            return sorted;
+        }
+
+        void print_timing_report(const std::vector<TimingEvent>& phases, const std::vector<TimingEvent>& steps,
+                                 const std::vector<TemplateCost>& templates, size_t top) {
+            std::cout << "\nBuild timings:\n";
+            // Phases of concurrent builds overlap, so the total is the wall time they span
+            size_t name_width = 12;
+            long long first_start = 0, last_end = 0;
+            for (const auto& phase : phases) {
+                name_width = std::max(name_width, phase.name.size() + 2);
+                first_start = first_start == 0 ? phase.start_us : std::min(first_start, phase.start_us);
+                last_end = std::max(last_end, phase.start_us + phase.duration_us);
+            }
+            for (const auto& phase : phases) {
+                std::cout << "  " << std::left << std::setw(static_cast<int>(name_width)) << phase.name << std::right << format_seconds(phase.duration_us) << "\n";
+            }
+            std::cout << "  " << std::left << std::setw(static_cast<int>(name_width)) << "total" << std::right << format_seconds(last_end - first_start) << "\n";
+
+            if (!steps.empty()) {
+                std::vector<TimingEvent> slowest = steps;
+                std::sort(slowest.begin(), slowest.end(), [](const TimingEvent& a, const TimingEvent& b) {
+                    return a.duration_us > b.duration_us;
+                });
+                long long step_total = 0;
+                for (const auto& step : steps) step_total += step.duration_us;
+                std::cout << "\nSlowest compile/link steps (" << std::min(top, slowest.size()) << " of " << steps.size()
+                          << ", " << std::fixed << std::setprecision(2) << step_total / 1e6 << " s in total):\n";
+                for (size_t i = 0; i < slowest.size() && i < top; ++i) {
+                    const std::string& target = slowest[i].detail;
+                    std::cout << format_seconds(slowest[i].duration_us) << "  " << std::left << std::setw(8) << slowest[i].category
+                              << std::right << slowest[i].name << (target.empty() ? "" : "  [" + target + "]") << "\n";
+                }
+            } else {
+                std::cout << "\nNo compile or link steps ran (everything was up to date).\n";
+            }
+
+            if (!templates.empty()) {
+                std::cout << "\nMost expensive template instantiations (Clang -ftime-trace, nested time included):\n";
+                for (size_t i = 0; i < templates.size() && i < top; ++i) {
+                    std::string name = templates[i].name;
+                    if (name.size() > 100) name = name.substr(0, 97) + "...";
+                    std::cout << format_seconds(templates[i].total_us) << "  x" << std::left << std::setw(6) << templates[i].count
+                              << std::right << name << "\n";
+                }
+            }
+        }
+
+        bool write_chrome_trace(const std::filesystem::path& path, const std::vector<TimingEvent>& phases,
+                                const std::vector<TimingEvent>& steps) {
+            long long origin = 0;
+            for (const auto& event : phases) {
+                if (origin == 0 || event.start_us < origin) origin = event.start_us;
+            }
+
+            std::ostringstream json;
+            json << "{\"traceEvents\":[\n";
+            json << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"ctc phases\"}}";
+            for (const auto& phase : phases) {
+                json << ",\n{\"name\":\"" << json_escape(phase.name) << "\",\"cat\":\"phase\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":"
+                     << phase.start_us - origin << ",\"dur\":" << phase.duration_us << "}";
+            }
+
+            // Pack overlapping steps into lanes so parallel jobs show up as separate rows
+            std::vector<long long> lane_end;
+            for (const auto& step : steps) {
+                size_t lane = 0;
+                while (lane < lane_end.size() && lane_end[lane] > step.start_us) ++lane;
+                if (lane == lane_end.size()) {
+                    lane_end.push_back(0);
+                    json << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << lane + 1
+                         << ",\"args\":{\"name\":\"job " << lane + 1 << "\"}}";
+                }
+                lane_end[lane] = step.start_us + step.duration_us;
+                json << ",\n{\"name\":\"" << json_escape(step.name) << "\",\"cat\":\"" << step.category
+                     << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << lane + 1 << ",\"ts\":" << step.start_us - origin
+                     << ",\"dur\":" << step.duration_us << ",\"args\":{\"target\":\"" << json_escape(step.detail) << "\"}}";
+            }
+            json << "\n]}\n";
+            return write_file(path, json.str());
+        }
+    }
+}
@@ -0,0 +1,119 @@
+#include "watch_utils.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace ctc {
+    namespace utils {
+        
+        FileWatcher::FileWatcher() {
+#ifdef __linux__
+            fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (fd_ < 0) {
+                error_ = std::string("inotify_init1 failed: ") + std::strerror(errno);
+            }
+#else
+            error_ = "file watching needs inotify (Linux)";
+#endif
+        }
+        
+        FileWatcher::~FileWatcher() {
+#ifdef __linux__
+            if (fd_ >= 0) {
+                close(fd_);
+            }
+#endif
+        }
+        
+        bool FileWatcher::add_directory(const std::filesystem::path& dir, bool recursive) {
+#ifdef __linux__
+            std::error_code ec;
+            if (fd_ < 0 || !std::filesystem::is_directory(dir, ec)) {
+                return false;
+            }
+            const uint32_t mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW;
+            const int wd = inotify_add_watch(fd_, dir.c_str(), mask);
+            if (wd < 0) {
+                error_ = "cannot watch " + dir.generic_string() + ": " + std::strerror(errno);
+                return false;
+            }
+            directories_[wd] = {dir, recursive};
+            if (recursive) {
+                for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+                    if (entry.is_directory(ec) && !entry.is_symlink(ec)) {
+                        add_directory(entry.path(), true);
+                    }
+                }
+            }
+            return true;
+#else
+            (void)dir;
+            (void)recursive;
+            return false;
+#endif
+        }
+        
+        bool FileWatcher::wait(int timeout_ms, std::vector<FileChange>& changes) {
+#ifdef __linux__
+            if (fd_ < 0) {
+                return false;
+            }
+            struct pollfd pfd = {fd_, POLLIN, 0};
+            const int ready = poll(&pfd, 1, timeout_ms);
+            if (ready < 0) {
+                return errno == EINTR;
+            }
+            if (ready == 0) {
+                return true;
+            }
+            
+            alignas(struct inotify_event) char buffer[64 * 1024];
+            while (true) {
+                const ssize_t length = read(fd_, buffer, sizeof(buffer));
+                if (length < 0) {
+                    return errno == EAGAIN || errno == EINTR;
+                }
+                for (ssize_t offset = 0; offset < length;) {
+                    const auto* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+                    offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+                    
+                    if (event->mask & IN_Q_OVERFLOW) {
+                        FileChange change;
+                        change.overflow = true;
+                        changes.push_back(change);
+                        continue;
+                    }
+                    if (event->mask & IN_IGNORED) {
+                        directories_.erase(event->wd); // the directory was deleted or moved away
+                        continue;
+                    }
+                    auto watched = directories_.find(event->wd);
+                    if (watched == directories_.end() || event->len == 0) {
+                        continue;
+                    }
+                    const std::filesystem::path path = watched->second.path / event->name;
+                    FileChange change;
+                    change.path = path.generic_string();
+                    change.is_directory = (event->mask & IN_ISDIR) != 0;
+                    change.structural = (event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) != 0;
+                    changes.push_back(change);
+                    
+                    // New subdirectories of a recursive watch are watched as well
+                    if (change.is_directory && watched->second.recursive && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                        add_directory(path, true);
+                    }
+                }
+            }
+#else
+            (void)timeout_ms;
+            (void)changes;
+            return false;
+#endif
+        }
+    }
+}